@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <plonk/plonk.h>
+
+struct BatchOptions {
+	std::string camera_path;
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t frames = 300;
+	std::string output;
+	CaptureFormat format = CaptureFormat::PNG;
+	bool software = false;
+	uint32_t threads = 0;
+	std::string device;
+};
+
+void print_usage() {
+	std::cout << "Usage: plonk-batch <camera path> [--size WxH] [--frames N] [--output DIR] [--format png|raw]\n"
+			  << "                   [--software] [--threads N] [--device INDEX|NAME]\n";
+}
+
+BatchOptions parse_args(int argc, char **argv) {
+	BatchOptions options;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (arg == "--size" && has_value) {
+			if (sscanf(argv[++i], "%ux%u", &options.width, &options.height) != 2) {
+				throw std::runtime_error("Invalid size, expected WxH");
+			}
+		}
+		else if (arg == "--frames" && has_value) {
+			options.frames = std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--output" && has_value) {
+			options.output = argv[++i];
+		}
+		else if (arg == "--format" && has_value) {
+			options.format = strcmp(argv[++i], "raw") == 0 ? CaptureFormat::RAW : CaptureFormat::PNG;
+		}
+		else if (arg == "--software") {
+			options.software = true;
+		}
+		else if (arg == "--threads" && has_value) {
+			options.threads = std::max(0, atoi(argv[++i]));
+		}
+		else if (arg == "--device" && has_value) {
+			options.device = argv[++i];
+		}
+		else if (arg[0] != '-' && options.camera_path.empty()) {
+			options.camera_path = arg;
+		}
+		else {
+			throw std::runtime_error("Unknown argument: " + arg);
+		}
+	}
+	if (options.camera_path.empty()) {
+		throw std::runtime_error("Missing camera path");
+	}
+	return options;
+}
+
+double percentile(std::vector<double> &sorted, double p) {
+	if (sorted.empty()) {
+		return 0.0;
+	}
+	size_t index = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+	return sorted[index];
+}
+
+void print_latencies(std::vector<double> &latencies) {
+	std::sort(latencies.begin(), latencies.end());
+	printf(
+		"Frame latency: p50 %.2fms, p90 %.2fms, p99 %.2fms, max %.2fms\n", percentile(latencies, 0.5),
+		percentile(latencies, 0.9), percentile(latencies, 0.99), latencies.empty() ? 0.0 : latencies.back()
+	);
+}
+
+float frame_time(BatchOptions &options, CameraPath &path, uint32_t frame) {
+	return options.frames > 1 ? path.duration() * frame / (options.frames - 1) : 0.0;
+}
+
+/**
+ * Render the path on the CPU, e.g. to compare thread counts with `--threads`
+ */
+int run_software(BatchOptions &options, CameraPath &path) {
+	SoftwareRenderer renderer(std::make_shared<JobSystem>(options.threads));
+	Image image(options.width, options.height);
+	Camera camera;
+	if (!options.output.empty()) {
+		std::filesystem::create_directories(options.output);
+	}
+
+	using clock = std::chrono::high_resolution_clock;
+	std::vector<double> latencies;
+	auto started_at = clock::now();
+	for (uint32_t i = 0; i < options.frames; i++) {
+		float time = frame_time(options, path, i);
+		path.apply(time, camera);
+		auto frame_start = clock::now();
+		renderer.draw(camera, time, image);
+		latencies.push_back(std::chrono::duration<double, std::milli>(clock::now() - frame_start).count());
+
+		if (!options.output.empty()) {
+			char filename[32];
+			snprintf(
+				filename, sizeof(filename), "frame_%06u.%s", i, options.format == CaptureFormat::PNG ? "png" : "rgba"
+			);
+			image.save((std::filesystem::path(options.output) / filename).string());
+		}
+	}
+	auto total_time = std::chrono::duration<double>(clock::now() - started_at).count();
+
+	printf(
+		"Rendered %u frames at %ux%u on %u threads\n", options.frames, options.width, options.height,
+		renderer.thread_count()
+	);
+	printf("Total: %.2fs, %.1f fps\n", total_time, options.frames / total_time);
+	print_latencies(latencies);
+	return 0;
+}
+
+/**
+ * Renders a camera path headlessly as fast as the GPU allows.
+ *
+ * Frames are pipelined (see `Context::MAX_FRAMES_IN_FLIGHT`) and readback is handled by `FrameCapture`, so encoding
+ * overlaps with rendering. Latency is measured from the start of recording a frame until its timeline point is seen reached.
+ */
+int main(int argc, char **argv) {
+	TRACE_THREAD_NAME("Main");
+	BatchOptions options;
+	try {
+		options = parse_args(argc, argv);
+	}
+	catch (const std::exception &e) {
+		std::cerr << e.what() << "\n";
+		print_usage();
+		return 1;
+	}
+
+	auto path = CameraPath::load(options.camera_path);
+	if (options.software) {
+		return run_software(options, path);
+	}
+
+	auto ctx = Context::create();
+	ctx->prefer_device(options.device);
+	ctx->init_headless(options.width, options.height);
+
+	Camera camera;
+	Renderer renderer(ctx, std::make_shared<JobSystem>(options.threads));
+	if (!options.output.empty()) {
+		renderer.start_capture(options.output, options.format);
+	}
+
+	using clock = std::chrono::high_resolution_clock;
+	std::deque<clock::time_point> in_flight;
+	std::vector<double> latencies;
+	latencies.reserve(options.frames);
+	uint64_t completed = 0;
+	auto collect_latencies = [&]() {
+		auto now = clock::now();
+		for (auto done = ctx->frames_completed(); completed < done; completed++) {
+			latencies.push_back(std::chrono::duration<double, std::milli>(now - in_flight.front()).count());
+			in_flight.pop_front();
+		}
+	};
+
+	auto started_at = clock::now();
+	for (uint32_t i = 0; i < options.frames; i++) {
+		float time = frame_time(options, path, i);
+		path.apply(time, camera);
+		in_flight.push_back(clock::now());
+		renderer.draw(camera, time);
+		collect_latencies();
+	}
+	ctx->wait_idle();
+	collect_latencies();
+	auto render_time = std::chrono::duration<double>(clock::now() - started_at).count();
+
+	if (!options.output.empty()) {
+		renderer.stop_capture();
+	}
+	auto total_time = std::chrono::duration<double>(clock::now() - started_at).count();
+
+	printf("Rendered %u frames at %ux%u\n", options.frames, options.width, options.height);
+	printf("Render: %.2fs, %.1f fps\n", render_time, options.frames / render_time);
+	if (!options.output.empty()) {
+		printf("Including capture: %.2fs, %.1f fps\n", total_time, options.frames / total_time);
+	}
+	print_latencies(latencies);
+
+	for (auto &scope : renderer.profiler->get_stats()) {
+		printf("GPU %s: %.3fms avg (%.3f - %.3fms)\n", scope.name.c_str(), scope.avg_ms, scope.min_ms, scope.max_ms);
+	}
+	auto arena = ctx->get_frame_arena_stats();
+	printf(
+		"Frame arena: %zu of %zu KiB, %llu overflow blocks in %llu frames\n", arena.peak_bytes / 1024,
+		arena.capacity / 1024, (unsigned long long)arena.overflow_blocks, (unsigned long long)arena.frames
+	);
+	TRACE_WRITE("plonk_batch_trace.json");
+	return 0;
+}
@@ -1,20 +1,51 @@
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <plonk/plonk.h>
 
 int main(int, char **) {
 	std::cout << "Starting Plonk...\n";
+	TRACE_THREAD_NAME("Main");
 
 	auto window = std::make_shared<Window>(1920, 1080);
 	auto ctx = Context::create();
-	ctx->attach_window(window);
+	auto jobs = std::make_shared<JobSystem>();
+	std::unique_ptr<Renderer> renderer;
+	std::unique_ptr<SoftwareRenderer> software_renderer;
+	Image software_image;
+	if (!std::getenv("PLONK_SOFTWARE")) {
+		try {
+			ctx->attach_window(window, jobs);
+			renderer = std::make_unique<Renderer>(ctx, jobs);
+		}
+		catch (const std::runtime_error &e) {
+			std::cout << "Vulkan unavailable (" << e.what() << "), falling back to software rendering\n";
+		}
+	}
+	bool development = ctx->get_profile() == ContextProfile::DEVELOPMENT;
+	if (renderer && development && std::filesystem::is_directory("shaders")) {
+		// Hot reload is a convenience, the renderer works fine without it
+		try {
+			renderer->watch_shaders("shaders");
+		}
+		catch (const std::runtime_error &e) {
+			std::cerr << "Shader hot reload unavailable: " << e.what() << "\n";
+		}
+	}
+	if (!renderer) {
+		software_renderer = std::make_unique<SoftwareRenderer>(jobs);
+	}
 
 	Camera camera;
 	camera.set_position(Point3(0.0, -1.0, -12.0));
-	Renderer renderer(ctx);
 
 	auto speed = 60.0;
+	SceneSdf collision;
+	float camera_radius = 1.0;
 
 	auto last_frame = std::chrono::high_resolution_clock::now();
+	auto started_at = last_frame;
+	auto last_report = last_frame;
 
 	window->on_key_press(Key::SPACE, [&]() {
 		if (window->is_mouse_grabbed()) {
@@ -25,6 +56,64 @@ int main(int, char **) {
 		}
 	});
 
+	window->on_key_press(Key::T, [&]() {
+		if (!renderer) {
+			return;
+		}
+		renderer->shadow_pass->temporal = !renderer->shadow_pass->temporal;
+		std::cout << "Temporal shadows: " << (renderer->shadow_pass->temporal ? "on" : "off") << "\n";
+	});
+
+	window->on_key_press(Key::H, [&]() {
+		if (!renderer) {
+			return;
+		}
+		renderer->shadow_pass->scale = renderer->shadow_pass->scale < 1.0 ? 1.0 : 0.5;
+		std::cout << "Shadow resolution scale: " << renderer->shadow_pass->scale << "\n";
+	});
+
+	window->on_key_press(Key::F1, [&]() {
+		if (!renderer) {
+			return;
+		}
+		if (!renderer->step_heatmap->is_available()) {
+			std::cout << "Step heatmap isn't supported on this device\n";
+			return;
+		}
+		auto mode = ((uint32_t)renderer->step_heatmap->mode + 1) % 3;
+		renderer->step_heatmap->mode = (StepDebugMode)mode;
+		std::cout << "Step heatmap mode: " << mode << "\n";
+	});
+
+	window->on_key_press(Key::F12, [&]() {
+		if (!software_renderer) {
+			return;
+		}
+		// Encode off the main thread, but report back on it alongside the window
+		jobs->run([jobs = jobs.get(), image = software_image, &window]() {
+			image.save_png("screenshot.png");
+			jobs->run_on_main([&window]() { window->set_title("Plonk - saved screenshot.png"); });
+		});
+	});
+
+	window->on_key_press(Key::F2, [&]() {
+		if (!renderer) {
+			return;
+		}
+		if (renderer->capture) {
+			renderer->stop_capture();
+		}
+		else {
+			auto directory = std::getenv("PLONK_CAPTURE_DIR");
+			try {
+				renderer->start_capture(directory ? directory : "capture");
+			}
+			catch (const std::runtime_error &e) {
+				std::cerr << e.what() << "\n";
+			}
+		}
+	});
+
 	Point2 prev_mouse_pos;
 	window->on_mouse_move([&](auto position) {
 		auto d = prev_mouse_pos - position;
@@ -36,10 +125,13 @@ int main(int, char **) {
 	});
 
 	while (window->poll()) {
+		jobs->pump_main();
 		auto now = std::chrono::high_resolution_clock::now();
 		double dt = (now - last_frame).count() / 1000000000.00;
 		last_frame = now;
+		float time = std::chrono::duration<float>(now - started_at).count();
 
+		auto previous_position = camera.position;
 		if (window->is_key_held(Key::W)) {
 			camera.translate(0.0, 0.0, speed * dt);
 		}
@@ -58,10 +150,61 @@ int main(int, char **) {
 		if (window->is_key_held(Key::Q)) {
 			camera.translate(0.0, speed * dt, 0.0);
 		}
-		
-		renderer.draw(camera);
+		// Keep the camera out of the geometry, at the time the last frame showed it
+		collision.time = renderer ? renderer->scene_time() : time;
+		camera.position = collision.sweep_sphere(previous_position, camera.position, camera_radius);
+
+		if (renderer) {
+			renderer->draw(camera);
+		}
+		else {
+			if ((int)software_image.width != window->width() || (int)software_image.height != window->height()) {
+				software_image = Image(window->width(), window->height());
+			}
+			software_renderer->draw(camera, time, software_image);
+			window->present(software_image);
+			if (now - last_report > std::chrono::seconds(1)) {
+				auto elapsed = std::chrono::high_resolution_clock::now() - now;
+				printf("CPU frame: %.1fms\n", std::chrono::duration<double, std::milli>(elapsed).count());
+			}
+		}
+
+		if (now - last_report > std::chrono::seconds(1)) {
+			if (renderer) {
+				for (auto &scope : renderer->profiler->get_stats()) {
+					printf(
+						"GPU %s: %.3fms avg (%.3f - %.3fms)\n", scope.name.c_str(), scope.avg_ms, scope.min_ms,
+						scope.max_ms
+					);
+				}
+				if (renderer->step_heatmap->is_enabled()) {
+					auto steps = renderer->step_heatmap->get_stats();
+					printf(
+						"Primary steps: mean %.1f, p50 %d, p90 %d, p99 %d, max %d\n", steps.primary.mean,
+						steps.primary.p50, steps.primary.p90, steps.primary.p99, steps.primary.max_steps
+					);
+					printf(
+						"Shadow steps: mean %.1f, p50 %d, p90 %d, p99 %d, max %d\n", steps.shadow.mean, steps.shadow.p50,
+						steps.shadow.p90, steps.shadow.p99, steps.shadow.max_steps
+					);
+				}
+				auto arena = ctx->get_frame_arena_stats();
+				printf(
+					"Frame arena: %zu of %zu KiB, %llu overflow blocks in %llu frames\n", arena.peak_bytes / 1024,
+					arena.capacity / 1024, (unsigned long long)arena.overflow_blocks, (unsigned long long)arena.frames
+				);
+			}
+			last_report = now;
+			TRACE_FLUSH();
+		}
+	}
+
+	if (auto profile_path = std::getenv("PLONK_PROFILE"); profile_path && renderer) {
+		renderer->profiler->dump(profile_path);
 	}
 
+	TRACE_WRITE("plonk_trace.json");
+
 	std::cout << "Finished Plonk\n";
 	return 0;
 }
@@ -0,0 +1,27 @@
+#include <cstdio>
+#include <exception>
+#include <plonk/scene_file.h>
+
+/**
+ * Convert a text scene (see `SceneDescription`) into a binary scene file
+ */
+int main(int argc, char **argv) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: plonk-scene <text scene> <output.plsc>\n");
+		return 1;
+	}
+
+	try {
+		auto scene = SceneDescription::load(argv[1]);
+		scene.write(argv[2]);
+		printf(
+			"Wrote %s: %zu primitives, %zu materials, %zu transforms\n", argv[2], scene.primitives.size(),
+			scene.materials.size(), scene.transforms.size()
+		);
+	}
+	catch (const std::exception &e) {
+		fprintf(stderr, "%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
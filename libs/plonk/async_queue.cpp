@@ -0,0 +1,185 @@
+#include "include/plonk/async_queue.h"
+#include "include/plonk/trace.h"
+#include <stdexcept>
+
+static VkImageMemoryBarrier2 image_barrier(const OwnershipTransfer &transfer) {
+	return {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+		.oldLayout = transfer.old_layout,
+		.newLayout = transfer.new_layout,
+		.srcQueueFamilyIndex = transfer.src_family,
+		.dstQueueFamilyIndex = transfer.dst_family,
+		.image = transfer.image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS},
+	};
+}
+
+static VkBufferMemoryBarrier2 buffer_barrier(const OwnershipTransfer &transfer) {
+	return {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+		.srcQueueFamilyIndex = transfer.src_family,
+		.dstQueueFamilyIndex = transfer.dst_family,
+		.buffer = transfer.buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	};
+}
+
+static void record_barrier(
+	const DeviceDispatch &vk, VkCommandBuffer command_buffer, VkImageMemoryBarrier2 *image,
+	VkBufferMemoryBarrier2 *buffer
+) {
+	VkDependencyInfo dependency_info{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.bufferMemoryBarrierCount = buffer ? 1u : 0u,
+		.pBufferMemoryBarriers = buffer,
+		.imageMemoryBarrierCount = image ? 1u : 0u,
+		.pImageMemoryBarriers = image,
+	};
+	vk.CmdPipelineBarrier2(command_buffer, &dependency_info);
+}
+
+void OwnershipTransfer::release(
+	const DeviceDispatch &vk, VkCommandBuffer command_buffer, VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access
+) const {
+	if (src_family == dst_family) {
+		// The timeline semaphore the acquiring submission waits on already makes the writes available
+		return;
+	}
+	// Destination stages and accesses are ignored by a release, they belong to the acquire
+	if (image) {
+		auto barrier = image_barrier(*this);
+		barrier.srcStageMask = src_stages;
+		barrier.srcAccessMask = src_access;
+		record_barrier(vk, command_buffer, &barrier, nullptr);
+	}
+	else {
+		auto barrier = buffer_barrier(*this);
+		barrier.srcStageMask = src_stages;
+		barrier.srcAccessMask = src_access;
+		record_barrier(vk, command_buffer, nullptr, &barrier);
+	}
+}
+
+void OwnershipTransfer::acquire(
+	const DeviceDispatch &vk, VkCommandBuffer command_buffer, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access
+) const {
+	bool same_family = src_family == dst_family;
+	if (image) {
+		if (same_family && old_layout == new_layout) {
+			return;
+		}
+		auto barrier = image_barrier(*this);
+		if (same_family) {
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			// The layout change must wait for whatever the semaphore wait covered
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		}
+		barrier.dstStageMask = dst_stages;
+		barrier.dstAccessMask = dst_access;
+		record_barrier(vk, command_buffer, &barrier, nullptr);
+	}
+	else if (!same_family) {
+		auto barrier = buffer_barrier(*this);
+		barrier.dstStageMask = dst_stages;
+		barrier.dstAccessMask = dst_access;
+		record_barrier(vk, command_buffer, nullptr, &barrier);
+	}
+}
+
+AsyncQueue::AsyncQueue(ContextPtr ctx, QueueLane lane, uint32_t family) : ctx(ctx), lane(lane), family(family) {
+	VkCommandPoolCreateInfo pool_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = family,
+	};
+	if (VK_SUCCESS != vkCreateCommandPool(ctx->device, &pool_info, nullptr, &pool)) {
+		throw std::runtime_error("Failed to create async queue Command Pool");
+	}
+}
+
+AsyncQueue::AsyncQueue(AsyncQueue &&other) noexcept
+	: ctx(std::move(other.ctx)), lane(other.lane), family(other.family), pool(other.pool),
+	  in_flight(std::move(other.in_flight)), free_buffers(std::move(other.free_buffers)) {
+	other.pool = VK_NULL_HANDLE;
+}
+
+AsyncQueue::~AsyncQueue() {
+	if (!pool) {
+		return;
+	}
+	std::vector<TimelinePoint> points;
+	for (auto &[buffer, point] : in_flight) {
+		points.push_back(point);
+	}
+	ctx->get_scheduler().wait_all(points);
+	vkDestroyCommandPool(ctx->device, pool, nullptr);
+}
+
+AsyncQueue AsyncQueue::compute(ContextPtr ctx) {
+	return AsyncQueue(ctx, ctx->get_compute_lane(), ctx->get_compute_queue_family_index().value());
+}
+
+AsyncQueue AsyncQueue::transfer(ContextPtr ctx) {
+	return AsyncQueue(ctx, ctx->get_transfer_lane(), ctx->get_transfer_queue_family_index().value());
+}
+
+/**
+ * Record a command buffer with `record` and submit it once `waits` are reached. Returns the point other queues or the
+ * CPU can wait on for its results.
+ */
+TimelinePoint AsyncQueue::submit(
+	std::function<void(VkCommandBuffer)> record, std::vector<std::pair<TimelinePoint, VkPipelineStageFlags2>> waits
+) {
+	TRACE_FUNCTION();
+	// Pools aren't thread safe, so recording holds the lock too
+	std::lock_guard<std::mutex> lock(mutex);
+	auto command_buffer = next_buffer();
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
+	if (VK_SUCCESS != ctx->vk.BeginCommandBuffer(command_buffer, &begin_info)) {
+		throw std::runtime_error("Failed to start async command recording");
+	}
+	record(command_buffer);
+	ctx->vk.EndCommandBuffer(command_buffer);
+
+	auto point = ctx->get_scheduler().submit(
+		lane,
+		{
+			.command_buffers = {command_buffer},
+			.waits = std::move(waits),
+		}
+	);
+	in_flight.push_back({command_buffer, point});
+	return point;
+}
+
+VkCommandBuffer AsyncQueue::next_buffer() {
+	auto &scheduler = ctx->get_scheduler();
+	// Submissions on one queue finish in order, so only the oldest needs checking
+	while (!in_flight.empty() && scheduler.is_complete(in_flight.front().second)) {
+		free_buffers.push_back(in_flight.front().first);
+		in_flight.pop_front();
+	}
+	if (!free_buffers.empty()) {
+		auto command_buffer = free_buffers.back();
+		free_buffers.pop_back();
+		ctx->vk.ResetCommandBuffer(command_buffer, 0);
+		return command_buffer;
+	}
+
+	VkCommandBufferAllocateInfo alloc_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1,
+	};
+	VkCommandBuffer command_buffer;
+	if (VK_SUCCESS != vkAllocateCommandBuffers(ctx->device, &alloc_info, &command_buffer)) {
+		throw std::runtime_error("Failed to allocate async command buffer");
+	}
+	return command_buffer;
+}
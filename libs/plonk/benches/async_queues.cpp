@@ -0,0 +1,87 @@
+#include "bench.h"
+#include <plonk/async_queue.h>
+#include <plonk/context.h>
+#include <vector>
+
+// Large enough that each copy keeps a queue busy for a while
+static const VkDeviceSize BUFFER_SIZE = 64 << 20;
+static const int COPIES = 4;
+
+struct Buffer {
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+};
+
+/**
+ * Measures how much of a stand-in frame's work can overlap with uploads and compute on the async queues.
+ *
+ * Each iteration copies a buffer repeatedly on the graphics queue (the frame), uploads a buffer on the transfer queue
+ * and hands it to graphics with an ownership transfer, and fills another on the compute queue. Run first with
+ * everything on the graphics lane, then with each on its own queue. On devices without dedicated families the two
+ * runs share queues and should match.
+ */
+int main(int, char **) {
+	auto ctx = Context::create();
+	ctx->init_headless(64, 64);
+	auto &scheduler = ctx->get_scheduler();
+	printf(
+		"Async compute: %s, async transfer: %s\n", ctx->has_async_compute() ? "yes" : "no",
+		ctx->has_async_transfer() ? "yes" : "no"
+	);
+
+	std::vector<Buffer> buffers(6);
+	for (auto &buffer : buffers) {
+		ctx->create_buffer(
+			BUFFER_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer.buffer, buffer.memory
+		);
+	}
+	auto &frame_src = buffers[0], &frame_dst = buffers[1], &staging = buffers[2], &uploaded = buffers[3],
+		 &computed = buffers[4], &consumed = buffers[5];
+	VkBufferCopy region{.srcOffset = 0, .dstOffset = 0, .size = BUFFER_SIZE};
+
+	AsyncQueue graphics(ctx, ctx->get_graphics_lane(), ctx->get_graphics_queue_family_index().value());
+	auto transfer = AsyncQueue::transfer(ctx);
+	auto compute = AsyncQueue::compute(ctx);
+
+	auto run = [&](AsyncQueue &upload_queue, AsyncQueue &compute_queue) {
+		OwnershipTransfer handover{
+			.src_family = upload_queue.get_family(),
+			.dst_family = graphics.get_family(),
+			.buffer = uploaded.buffer,
+		};
+		auto upload = upload_queue.submit([&](VkCommandBuffer cmd) {
+			ctx->vk.CmdCopyBuffer(cmd, staging.buffer, uploaded.buffer, 1, &region);
+			handover.release(ctx->vk, cmd, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+		});
+		auto fill = compute_queue.submit([&](VkCommandBuffer cmd) {
+			ctx->vk.CmdFillBuffer(cmd, computed.buffer, 0, BUFFER_SIZE, 0x3f800000);
+		});
+		auto frame = graphics.submit([&](VkCommandBuffer cmd) {
+			for (int i = 0; i < COPIES; i++) {
+				ctx->vk.CmdCopyBuffer(cmd, frame_src.buffer, frame_dst.buffer, 1, &region);
+			}
+		});
+		// What a frame consuming the upload would record, after the copies it didn't need to wait for. It writes its own
+		// buffer, as nothing orders it against the frame's copies.
+		auto consume = graphics.submit(
+			[&](VkCommandBuffer cmd) {
+				handover.acquire(ctx->vk, cmd, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
+				ctx->vk.CmdCopyBuffer(cmd, uploaded.buffer, consumed.buffer, 1, &region);
+			},
+			{{upload, VK_PIPELINE_STAGE_2_COPY_BIT}}
+		);
+		scheduler.wait_all({fill, frame, consume});
+	};
+
+	double serial_ns = bench("serial, graphics queue only", 50, [&](size_t) { run(graphics, graphics); });
+	double async_ns = bench("overlapped, async queues", 50, [&](size_t) { run(transfer, compute); });
+	printf("%-40s %12.2fx\n", "  speedup", serial_ns / async_ns);
+
+	scheduler.wait_idle();
+	for (auto &buffer : buffers) {
+		vkDestroyBuffer(ctx->device, buffer.buffer, nullptr);
+		vkFreeMemory(ctx->device, buffer.memory, nullptr);
+	}
+	return 0;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+// Keeps the optimiser from discarding a benchmarked result
+template <typename T>
+inline void do_not_optimize(const T &value) {
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/**
+ * Time `iterations` calls of `fn` and print the mean cost of one
+ */
+inline double bench(const char *name, size_t iterations, std::function<void(size_t)> fn) {
+	// Warm up caches and branch predictors
+	for (size_t i = 0; i < iterations / 10 + 1; i++) {
+		fn(i);
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0; i < iterations; i++) {
+		fn(i);
+	}
+	auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start);
+	double ns = elapsed.count() / iterations;
+	printf("%-40s %12.1f ns/op %12zu ops\n", name, ns, iterations);
+	return ns;
+}
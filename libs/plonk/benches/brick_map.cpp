@@ -0,0 +1,57 @@
+#include "bench.h"
+#include <plonk/brick_map.h>
+#include <plonk/job_system.h>
+#include <plonk/scene_sdf.h>
+#include <vector>
+
+static const float VOXEL_SIZE = 0.125;
+
+/**
+ * Baking and sampling the renderer's brick map of the static box, against evaluating the box directly
+ */
+int main(int, char **) {
+	auto [min, max] = SceneSdf::static_bounds();
+	JobSystem jobs;
+
+	bench("bake, 1 thread", 20, [&](size_t) {
+		BrickMap map(min, max, VOXEL_SIZE, SceneSdf::static_distances);
+		map.bake();
+		do_not_optimize(map.brick_capacity());
+	});
+	bench("bake, job system", 20, [&](size_t) {
+		BrickMap map(min, max, VOXEL_SIZE, SceneSdf::static_distances);
+		map.bake(&jobs);
+		do_not_optimize(map.brick_capacity());
+	});
+
+	BrickMap map(min, max, VOXEL_SIZE, SceneSdf::static_distances);
+	map.bake(&jobs);
+	auto stats = map.get_stats();
+	printf(
+		"%u cells, %u bricks, %.1f MiB of bricks\n", stats.cells, stats.bricks, stats.atlas_bytes / (1024.0 * 1024.0)
+	);
+
+	// An edit the size of a unit cube at one of the box's corners
+	bench("rebake, 1 unit cube", 1000, [&](size_t) {
+		map.rebake(Point3(3.5, 8.5, 15.5), Point3(4.5, 9.5, 16.5), &jobs);
+		do_not_optimize(map.take_changes().bricks.size());
+	});
+
+	const size_t count = 4096;
+	std::vector<Point3> points;
+	for (size_t i = 0; i < count; i++) {
+		points.push_back(Point3((i % 16) * 0.6f - 4.5f, (i / 16 % 16) * 0.6f + 0.5f, (i / 256) * 0.6f + 7.5f));
+	}
+	std::vector<float> x(count), y(count), z(count), out(count);
+	for (size_t i = 0; i < count; i++) {
+		x[i] = points[i].coords[0];
+		y[i] = points[i].coords[1];
+		z[i] = points[i].coords[2];
+	}
+	bench("BrickMap::distance", 1000000, [&](size_t i) { do_not_optimize(map.distance(points[i % count])); });
+	bench("static_distances, 4096 points", 1000, [&](size_t) {
+		SceneSdf::static_distances(x.data(), y.data(), z.data(), out.data(), count);
+		do_not_optimize(out[0]);
+	});
+	return 0;
+}
@@ -0,0 +1,77 @@
+#include "bench.h"
+#include <plonk/context.h>
+
+static const uint32_t COMMANDS = 256;
+
+/**
+ * Compares recording through the loader's trampolines with recording through the context's dispatch table.
+ *
+ * Each iteration re-records one command buffer with a run of small fills and barriers. Nothing is submitted, so only
+ * the CPU cost of recording is measured. Runs with the production profile, as the validation layer would dwarf the
+ * difference.
+ */
+int main(int, char **) {
+	auto ctx = Context::create();
+	ctx->set_profile(ContextProfile::PRODUCTION);
+	ctx->init_headless(64, 64);
+
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	ctx->create_buffer(4096, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, memory);
+
+	VkCommandPoolCreateInfo pool_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = ctx->get_graphics_queue_family_index().value(),
+	};
+	VkCommandPool pool;
+	vkCreateCommandPool(ctx->device, &pool_info, nullptr, &pool);
+	VkCommandBufferAllocateInfo alloc_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1,
+	};
+	VkCommandBuffer command_buffer;
+	vkAllocateCommandBuffers(ctx->device, &alloc_info, &command_buffer);
+
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
+	VkMemoryBarrier2 barrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+		.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+	};
+	VkDependencyInfo dependency_info{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers = &barrier,
+	};
+
+	auto record = [&](const DeviceDispatch &vk) {
+		return [&](size_t) {
+			vk.ResetCommandBuffer(command_buffer, 0);
+			vk.BeginCommandBuffer(command_buffer, &begin_info);
+			for (uint32_t i = 0; i < COMMANDS; i++) {
+				vk.CmdFillBuffer(command_buffer, buffer, 0, 256, i);
+				vk.CmdPipelineBarrier2(command_buffer, &dependency_info);
+			}
+			vk.EndCommandBuffer(command_buffer);
+		};
+	};
+
+	auto loader = DeviceDispatch::loader();
+	double loader_ns = bench("loader trampolines", 2000, record(loader));
+	double direct_ns = bench("dispatch table", 2000, record(ctx->vk));
+	printf("%-40s %12.2fx\n", "  speedup", loader_ns / direct_ns);
+	printf("%-40s %12.2f ns\n", "  saved per call", (loader_ns - direct_ns) / (COMMANDS * 2 + 3));
+
+	vkDestroyCommandPool(ctx->device, pool, nullptr);
+	vkDestroyBuffer(ctx->device, buffer, nullptr);
+	vkFreeMemory(ctx->device, memory, nullptr);
+	return 0;
+}
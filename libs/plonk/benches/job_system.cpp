@@ -0,0 +1,70 @@
+#include "bench.h"
+#include <plonk/job_system.h>
+#include <plonk/software_renderer.h>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Enough arithmetic per item that scheduling overhead shouldn't dominate
+static float busy_work(size_t i) {
+	float x = i * 0.001f;
+	for (int j = 0; j < 200; j++) {
+		x = std::sin(x) * 0.5f + 0.25f;
+	}
+	return x;
+}
+
+/**
+ * Measures per-job overhead, then how parallel_for and the software renderer scale from 1 thread up to every core
+ */
+int main(int, char **) {
+	uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<uint32_t> thread_counts;
+	for (uint32_t t = 1; t < max_threads; t *= 2) {
+		thread_counts.push_back(t);
+	}
+	thread_counts.push_back(max_threads);
+
+	{
+		JobSystem jobs(max_threads);
+		bench("run + wait, 1000 empty jobs", 1000, [&](size_t) {
+			JobCounter counter;
+			for (int i = 0; i < 1000; i++) {
+				jobs.run([]() {}, &counter);
+			}
+			jobs.wait(counter);
+		});
+		bench("parallel_for, 1000 empty chunks", 1000, [&](size_t) {
+			jobs.parallel_for(0, 1000, 1, [](size_t, size_t) {});
+		});
+	}
+
+	std::vector<float> results(1 << 16);
+	double single_ns = 0.0;
+	for (auto threads : thread_counts) {
+		JobSystem jobs(threads);
+		auto name = "parallel_for, 65536 items, " + std::to_string(threads) + " threads";
+		double ns = bench(name.c_str(), 20, [&](size_t) {
+			jobs.parallel_for(0, results.size(), 256, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					results[i] = busy_work(i);
+				}
+			});
+		});
+		single_ns = threads == 1 ? ns : single_ns;
+		printf("%-40s %12.2fx\n", "  speedup", single_ns / ns);
+	}
+
+	Image image(640, 360);
+	Camera camera;
+	camera.set_position(Point3(0.0, -1.0, -12.0));
+	for (auto threads : thread_counts) {
+		SoftwareRenderer renderer(std::make_shared<JobSystem>(threads));
+		auto name = "software 640x360, " + std::to_string(threads) + " threads";
+		double ns = bench(name.c_str(), 10, [&](size_t i) { renderer.draw(camera, i * 0.016f, image); });
+		single_ns = threads == 1 ? ns : single_ns;
+		printf("%-40s %12.2fx\n", "  speedup", single_ns / ns);
+	}
+	return 0;
+}
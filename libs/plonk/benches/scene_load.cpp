@@ -0,0 +1,85 @@
+#include "bench.h"
+#include <plonk/scene_file.h>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const size_t PRIMITIVE_COUNT = 1000000;
+static const size_t MATERIAL_COUNT = 1000;
+static const size_t TRANSFORM_COUNT = 100000;
+// Parsing is far slower, so the text scene is a tenth of the size
+static const size_t TEXT_PRIMITIVE_COUNT = 100000;
+
+static SceneDescription build() {
+	SceneDescription scene;
+	for (size_t i = 0; i < MATERIAL_COUNT; i++) {
+		scene.materials.push_back({.color = {i / (float)MATERIAL_COUNT, 0.5, 0.5, 1.0}});
+	}
+	for (size_t i = 0; i < TRANSFORM_COUNT; i++) {
+		SceneTransform transform{};
+		transform.world_to_local[0] = transform.world_to_local[5] = transform.world_to_local[10] = 1.0;
+		transform.world_to_local[12] = -(float)i;
+		transform.world_to_local[15] = 1.0;
+		scene.transforms.push_back(transform);
+	}
+	for (size_t i = 0; i < PRIMITIVE_COUNT; i++) {
+		scene.primitives.push_back({
+			.type = i % 2 ? PrimitiveType::BOX : PrimitiveType::SPHERE,
+			.material = (uint32_t)(i % MATERIAL_COUNT),
+			.transform = (uint32_t)(i % TRANSFORM_COUNT),
+			.blend = 0.5,
+			.size = {1.0, 2.0, 3.0, 0.0},
+		});
+	}
+	return scene;
+}
+
+static std::string build_text() {
+	std::ostringstream text;
+	for (size_t i = 0; i < MATERIAL_COUNT; i++) {
+		text << "material m" << i << " " << i / (float)MATERIAL_COUNT << " 0.5 0.5\n";
+	}
+	for (size_t i = 0; i < TRANSFORM_COUNT / 10; i++) {
+		text << "transform t" << i << " - " << i << " 0 0  0 0.5 0  1 1 1\n";
+	}
+	for (size_t i = 0; i < TEXT_PRIMITIVE_COUNT; i++) {
+		text << (i % 2 ? "box m" : "sphere m") << i % MATERIAL_COUNT << " t" << i % (TRANSFORM_COUNT / 10) << " 0.5 1"
+			 << (i % 2 ? " 2 3\n" : "\n");
+	}
+	return text.str();
+}
+
+/**
+ * Loading a 1M primitive binary scene (about 37 MiB) against parsing a text one, with the file in the page cache
+ */
+int main(int, char **) {
+	auto path = (std::filesystem::temp_directory_path() / "plonk_bench_scene.plsc").string();
+	build().write(path);
+	printf("Scene file: %.1f MiB\n", std::filesystem::file_size(path) / (1024.0 * 1024.0));
+
+	bench("open + validate, 1M primitives", 1000, [&](size_t) {
+		SceneFile file(path);
+		do_not_optimize(file.primitives().size());
+	});
+
+	// The copy an upload would make from the mapping, into host memory here rather than a staging buffer
+	std::vector<uint8_t> staging(std::filesystem::file_size(path));
+	bench("open + copy out, 1M primitives", 50, [&](size_t) {
+		SceneFile file(path);
+		std::memcpy(staging.data(), file.data(), file.size());
+		do_not_optimize(staging[staging.size() - 1]);
+	});
+
+	bench("write, 1M primitives", 5, [&](size_t) { build().write(path); });
+
+	auto text = build_text();
+	bench("parse text, 100k primitives", 5, [&](size_t) {
+		std::istringstream input(text);
+		auto scene = SceneDescription::parse(input);
+		do_not_optimize(scene.primitives.size());
+	});
+
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,37 @@
+#include "bench.h"
+#include <plonk/scene_sdf.h>
+#include <vector>
+
+int main(int, char **) {
+	SceneSdf scene;
+	scene.time = 0.3;
+
+	const size_t count = 4096;
+	std::vector<float> x(count), y(count), z(count), out(count);
+	for (size_t i = 0; i < count; i++) {
+		x[i] = (i % 64) - 32.0f;
+		y[i] = ((i / 64) % 64) * 0.25f - 3.0f;
+		z[i] = 12.0f + (i % 7);
+	}
+
+	bench("distance", 1000000, [&](size_t i) {
+		do_not_optimize(scene.distance(Point3(x[i % count], y[i % count], z[i % count])));
+	});
+	bench("distances, 4096 points", 1000, [&](size_t) {
+		scene.distances(x.data(), y.data(), z.data(), out.data(), count);
+	});
+
+	// Typical per-frame camera moves: one unit towards the scene from around the start position
+	bench("sweep_sphere, clear path", 1000000, [&](size_t i) {
+		Point3 from(x[i % count] * 0.1f, -1.0, -12.0);
+		do_not_optimize(scene.sweep_sphere(from, from + Vector3(0.0, 0.0, 1.0), 1.0));
+	});
+	bench("sweep_sphere, into the box", 1000000, [&](size_t i) {
+		Point3 from(0.0, -1.0 - (i % 16) * 0.01f, 12.0);
+		do_not_optimize(scene.sweep_sphere(from, from + Vector3(0.0, 1.0, 0.0), 1.0));
+	});
+	bench("raycast", 100000, [&](size_t i) {
+		do_not_optimize(scene.raycast(Point3(x[i % count] * 0.1f, -1.0, -12.0), Vector3(0.0, 0.2, 1.0)));
+	});
+	return 0;
+}
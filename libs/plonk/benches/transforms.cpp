@@ -0,0 +1,89 @@
+#include "bench.h"
+#include <plonk/transforms.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const size_t NODE_COUNT = 100000;
+
+// Eight children per node, so 100k nodes are six levels deep
+static std::vector<TransformHandle> build(TransformHierarchy &transforms) {
+	std::vector<TransformHandle> nodes;
+	nodes.reserve(NODE_COUNT);
+	for (size_t i = 0; i < NODE_COUNT; i++) {
+		Transform local;
+		local.translation = Vector3(i % 5, 1.0, 0.0);
+		local.rotation = Vector3(0.0, i * 0.01f, 0.0);
+		nodes.push_back(transforms.add(local, i == 0 ? TransformHandle{} : nodes[(i - 1) / 8]));
+	}
+	transforms.update();
+	return nodes;
+}
+
+/**
+ * World matrix updates and packing for 100k nodes, with everything, a few roots' subtrees, or nothing changed
+ */
+int main(int, char **) {
+	uint32_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+	TransformHierarchy transforms;
+	auto nodes = build(transforms);
+	std::vector<Matrix4> packed(NODE_COUNT);
+
+	auto spin = [&](TransformHandle node, size_t i) {
+		auto local = transforms.get_local(node);
+		local.rotation = Vector3(0.0, i * 0.01f, 0.0);
+		transforms.set_local(node, local);
+	};
+
+	std::vector<uint32_t> thread_counts{1};
+	if (max_threads > 1) {
+		thread_counts.push_back(max_threads);
+	}
+	for (auto threads : thread_counts) {
+		JobSystem jobs(threads);
+		auto suffix = ", " + std::to_string(threads) + " threads";
+
+		auto name = "update, all changed" + suffix;
+		bench(name.c_str(), 50, [&](size_t i) {
+			spin(nodes[0], i);
+			transforms.update(&jobs);
+		});
+
+		// The first second level node's subtree, about a third of the nodes as the deepest level is only part full
+		name = "update, one subtree changed" + suffix;
+		bench(name.c_str(), 200, [&](size_t i) {
+			spin(nodes[1], i);
+			transforms.update(&jobs);
+		});
+
+		name = "update, 1% of leaves changed" + suffix;
+		bench(name.c_str(), 200, [&](size_t i) {
+			for (size_t leaf = NODE_COUNT - 1; leaf > NODE_COUNT - 1 - NODE_COUNT / 100; leaf--) {
+				spin(nodes[leaf], i);
+			}
+			transforms.update(&jobs);
+		});
+
+		name = "update, nothing changed" + suffix;
+		bench(name.c_str(), 500, [&](size_t) { transforms.update(&jobs); });
+
+		name = "pack, all changed" + suffix;
+		bench(name.c_str(), 50, [&](size_t) {
+			transforms.pack(packed.data(), 0, &jobs);
+			do_not_optimize(packed[NODE_COUNT - 1]);
+		});
+
+		name = "update + pack, one subtree" + suffix;
+		uint64_t version = transforms.pack(packed.data(), 0, &jobs);
+		bench(name.c_str(), 200, [&](size_t i) {
+			spin(nodes[1], i);
+			transforms.update(&jobs);
+			version = transforms.pack(packed.data(), version, &jobs);
+		});
+	}
+
+	bench("build 100k nodes", 5, [&](size_t) {
+		TransformHierarchy built;
+		build(built);
+	});
+}
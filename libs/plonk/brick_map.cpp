@@ -0,0 +1,637 @@
+#include "include/plonk/brick_map.h"
+#include "include/plonk/log.h"
+#include "include/plonk/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+// Cells per job when finding the distance at their centres
+static const size_t CELL_GRAIN = 1024;
+static const float HALF_DIAGONAL = 0.8660254f;
+
+static void for_range(JobSystem *jobs, size_t count, size_t grain, std::function<void(size_t, size_t)> fn) {
+	if (jobs && count > grain) {
+		jobs->parallel_for(0, count, grain, fn);
+	}
+	else {
+		fn(0, count);
+	}
+}
+
+BrickMap::BrickMap(Point3 min, Point3 max, float voxel_size, SdfSampler sdf)
+	: voxel_size(voxel_size), cell_size(voxel_size * (BRICK_SIZE - 1)), sdf(std::move(sdf)) {
+	size_t cell_count = 1;
+	for (int axis = 0; axis < 3; axis++) {
+		origin.coords[axis] = min.coords[axis] - cell_size;
+		float extent = max.coords[axis] - min.coords[axis] + cell_size * 2.0f;
+		dimensions[axis] = std::max(1u, (uint32_t)std::ceil(extent / cell_size));
+		if (dimensions[axis] > MAX_DIMENSION) {
+			throw std::runtime_error("Brick map grid is too large, use a bigger voxel size");
+		}
+		cell_count *= dimensions[axis];
+	}
+	cells.assign(cell_count, {.brick = EMPTY, .distance = 0.0});
+}
+
+/**
+ * Evaluate the whole map
+ */
+void BrickMap::bake(JobSystem *jobs) {
+	bake_cells({0, 0, 0}, dimensions, jobs);
+}
+
+/**
+ * Evaluate again only the cells around an edit whose old and new shapes lie within `min` and `max`. Empty cells
+ * further out keep their old distances, which may overestimate near a shape that was added, so grow the bounds to
+ * cover wherever marching past the edit matters.
+ */
+void BrickMap::rebake(Point3 min, Point3 max, JobSystem *jobs) {
+	std::array<uint32_t, 3> begin, end;
+	for (int axis = 0; axis < 3; axis++) {
+		// A cell further, as the cells whose bricks the surface reaches extend that far past it
+		float from = (min.coords[axis] - origin.coords[axis]) / cell_size - 1.0f;
+		float to = (max.coords[axis] - origin.coords[axis]) / cell_size + 1.0f;
+		begin[axis] = (uint32_t)std::clamp(std::floor(from), 0.0f, (float)dimensions[axis]);
+		end[axis] = (uint32_t)std::clamp(std::floor(to) + 1.0f, 0.0f, (float)dimensions[axis]);
+		if (begin[axis] >= end[axis]) {
+			return;
+		}
+	}
+	bake_cells(begin, end, jobs);
+}
+
+/**
+ * Distance at `p` as the shader samples it: trilinear within bricks, a lower bound in empty cells and outside the map
+ */
+float BrickMap::distance(const Point3 &p) const {
+	float local[3], extent[3], q[3];
+	float outside_length = 0.0, inside = -INFINITY;
+	for (int axis = 0; axis < 3; axis++) {
+		local[axis] = p.coords[axis] - origin.coords[axis];
+		extent[axis] = dimensions[axis] * cell_size;
+		q[axis] = std::abs(local[axis] - extent[axis] * 0.5f) - extent[axis] * 0.5f;
+		outside_length += std::max(q[axis], 0.0f) * std::max(q[axis], 0.0f);
+		inside = std::max(inside, q[axis]);
+	}
+	// All the geometry is inside the map, so nothing's nearer than its bounds
+	float outside = std::sqrt(outside_length) + std::min(inside, 0.0f);
+	if (outside > cell_size) {
+		return outside;
+	}
+
+	uint32_t cell[3];
+	float f[3];
+	for (int axis = 0; axis < 3; axis++) {
+		float coord = std::clamp(local[axis], 0.0f, extent[axis]) / cell_size;
+		cell[axis] = std::min((uint32_t)coord, dimensions[axis] - 1);
+		f[axis] = std::clamp(coord - cell[axis], 0.0f, 1.0f);
+	}
+	auto &entry = cells[cell[0] + (cell[1] + cell[2] * dimensions[1]) * dimensions[0]];
+	float d;
+	if (entry.brick == EMPTY) {
+		// No surface in the cell, so nowhere in it is nearer than the distance at its centre less half its diagonal
+		d = std::copysign(std::abs(entry.distance) - cell_size * HALF_DIAGONAL, entry.distance);
+	}
+	else {
+		d = sample_brick(entry.brick, f[0], f[1], f[2]);
+	}
+	return outside > 0.0 ? std::max(outside, d - outside) : d;
+}
+
+/**
+ * Bricks and cells changed by bakes since the last call, which start afresh
+ */
+BrickMapChanges BrickMap::take_changes() {
+	for (auto brick : changes.bricks) {
+		brick_dirty[brick] = 0;
+	}
+	BrickMapChanges taken = std::move(changes);
+	changes = {};
+	return taken;
+}
+
+BrickMapStats BrickMap::get_stats() const {
+	return {
+		.cells = (uint32_t)cells.size(),
+		.bricks = brick_capacity() - (uint32_t)free_bricks.size(),
+		.allocated_bricks = brick_capacity(),
+		.atlas_bytes = bricks.size() * sizeof(float),
+	};
+}
+
+/**
+ * Where a brick sits in the atlas, in bricks
+ */
+std::array<uint32_t, 3> BrickMap::atlas_position(uint32_t brick) {
+	return {
+		brick % ATLAS_WIDTH_BRICKS,
+		brick / ATLAS_WIDTH_BRICKS % ATLAS_WIDTH_BRICKS,
+		brick / (ATLAS_WIDTH_BRICKS * ATLAS_WIDTH_BRICKS),
+	};
+}
+
+void BrickMap::bake_cells(std::array<uint32_t, 3> begin, std::array<uint32_t, 3> end, JobSystem *jobs) {
+	TRACE_FUNCTION();
+	std::vector<uint32_t> region;
+	region.reserve((size_t)(end[0] - begin[0]) * (end[1] - begin[1]) * (end[2] - begin[2]));
+	for (uint32_t z = begin[2]; z < end[2]; z++) {
+		for (uint32_t y = begin[1]; y < end[1]; y++) {
+			for (uint32_t x = begin[0]; x < end[0]; x++) {
+				region.push_back(x + (y + z * dimensions[1]) * dimensions[0]);
+			}
+		}
+	}
+
+	std::vector<float> centres(region.size());
+	for_range(jobs, region.size(), CELL_GRAIN, [&](size_t first, size_t last) {
+		std::vector<float> x(last - first), y(last - first), z(last - first);
+		for (size_t i = first; i < last; i++) {
+			auto min = cell_min(region[i]);
+			x[i - first] = min.coords[0] + cell_size * 0.5f;
+			y[i - first] = min.coords[1] + cell_size * 0.5f;
+			z[i - first] = min.coords[2] + cell_size * 0.5f;
+		}
+		sdf(x.data(), y.data(), z.data(), &centres[first], last - first);
+	});
+
+	// Bricks are handed out on this thread, so the same scene always packs the same way
+	float reach = cell_size * HALF_DIAGONAL + voxel_size;
+	std::vector<uint32_t> to_bake;
+	for (size_t i = 0; i < region.size(); i++) {
+		auto &cell = cells[region[i]];
+		cell.distance = centres[i];
+		if (std::abs(centres[i]) <= reach) {
+			if (cell.brick == EMPTY) {
+				cell.brick = allocate_brick();
+			}
+			if (!brick_dirty[cell.brick]) {
+				brick_dirty[cell.brick] = 1;
+				changes.bricks.push_back(cell.brick);
+			}
+			to_bake.push_back(region[i]);
+		}
+		else if (cell.brick != EMPTY) {
+			free_bricks.push_back(cell.brick);
+			cell.brick = EMPTY;
+		}
+	}
+
+	for_range(jobs, to_bake.size(), GRAIN, [&](size_t first, size_t last) {
+		float x[BRICK_VOXELS], y[BRICK_VOXELS], z[BRICK_VOXELS];
+		for (size_t i = first; i < last; i++) {
+			auto min = cell_min(to_bake[i]);
+			for (uint32_t k = 0; k < BRICK_SIZE; k++) {
+				for (uint32_t j = 0; j < BRICK_SIZE; j++) {
+					for (uint32_t v = 0; v < BRICK_SIZE; v++) {
+						auto index = v + (j + k * BRICK_SIZE) * BRICK_SIZE;
+						x[index] = min.coords[0] + v * voxel_size;
+						y[index] = min.coords[1] + j * voxel_size;
+						z[index] = min.coords[2] + k * voxel_size;
+					}
+				}
+			}
+			sdf(x, y, z, &bricks[(size_t)cells[to_bake[i]].brick * BRICK_VOXELS], BRICK_VOXELS);
+		}
+	});
+
+	if (!changes.has_cells()) {
+		changes.cell_begin = begin;
+		changes.cell_end = end;
+		return;
+	}
+	for (int axis = 0; axis < 3; axis++) {
+		changes.cell_begin[axis] = std::min(changes.cell_begin[axis], begin[axis]);
+		changes.cell_end[axis] = std::max(changes.cell_end[axis], end[axis]);
+	}
+}
+
+uint32_t BrickMap::allocate_brick() {
+	if (!free_bricks.empty()) {
+		auto brick = free_bricks.back();
+		free_bricks.pop_back();
+		return brick;
+	}
+	auto brick = brick_capacity();
+	bricks.resize(bricks.size() + BRICK_VOXELS);
+	brick_dirty.push_back(0);
+	return brick;
+}
+
+Point3 BrickMap::cell_min(uint32_t cell) const {
+	uint32_t x = cell % dimensions[0];
+	uint32_t y = cell / dimensions[0] % dimensions[1];
+	uint32_t z = cell / (dimensions[0] * dimensions[1]);
+	return Point3(
+		origin.coords[0] + x * cell_size, origin.coords[1] + y * cell_size, origin.coords[2] + z * cell_size
+	);
+}
+
+// Trilinear, with the brick's corners at 0 and 1
+float BrickMap::sample_brick(uint32_t brick, float x, float y, float z) const {
+	const float *data = brick_data(brick);
+	float u[3] = {x * (BRICK_SIZE - 1), y * (BRICK_SIZE - 1), z * (BRICK_SIZE - 1)};
+	uint32_t i[3];
+	float t[3];
+	for (int axis = 0; axis < 3; axis++) {
+		i[axis] = std::min((uint32_t)u[axis], BRICK_SIZE - 2);
+		t[axis] = u[axis] - i[axis];
+	}
+	auto at = [&](uint32_t dx, uint32_t dy, uint32_t dz) {
+		return data[(i[0] + dx) + ((i[1] + dy) + (i[2] + dz) * BRICK_SIZE) * BRICK_SIZE];
+	};
+	auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+	float near = lerp(lerp(at(0, 0, 0), at(1, 0, 0), t[0]), lerp(at(0, 1, 0), at(1, 1, 0), t[0]), t[1]);
+	float far = lerp(lerp(at(0, 0, 1), at(1, 0, 1), t[0]), lerp(at(0, 1, 1), at(1, 1, 1), t[0]), t[1]);
+	return lerp(near, far, t[2]);
+}
+
+// Matches the BrickMapInfo uniform block in shaders/scene.glsl
+struct BrickMapInfo {
+	float origin[4];
+	float cell_size;
+	float padding[3];
+};
+
+// Filtered in the shader, and linear filtering of 32 bit floats is optional
+static const VkFormat ATLAS_FORMAT = VK_FORMAT_R32_SFLOAT;
+
+BrickMapTextures::BrickMapTextures(ContextPtr ctx) : ctx(ctx) {
+	if (!(ctx->optimal_format_features(ATLAS_FORMAT) & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
+		throw std::runtime_error("Device can't linearly filter the brick atlas format");
+	}
+	ctx->create_buffer(
+		sizeof(BrickMapInfo), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, info_buffer, info_memory
+	);
+	create_descriptors();
+}
+
+BrickMapTextures::~BrickMapTextures() {
+	vkDeviceWaitIdle(ctx->device);
+	destroy_texture(cells);
+	destroy_texture(atlas);
+	vkDestroyBuffer(ctx->device, info_buffer, nullptr);
+	vkFreeMemory(ctx->device, info_memory, nullptr);
+	vkDestroyDescriptorPool(ctx->device, descriptor_pool, nullptr);
+	vkDestroyDescriptorSetLayout(ctx->device, descriptor_set_layout, nullptr);
+	vkDestroySampler(ctx->device, cell_sampler, nullptr);
+	vkDestroySampler(ctx->device, atlas_sampler, nullptr);
+}
+
+/**
+ * Copy the bricks and cells that changed since the last upload. Call between frames, before the frame that should see
+ * the changes is recorded.
+ */
+void BrickMapTextures::upload(BrickMap &map) {
+	TRACE_FUNCTION();
+	auto changes = map.take_changes();
+	auto &dimensions = map.get_dimensions();
+	VkExtent3D cell_extent{dimensions[0], dimensions[1], dimensions[2]};
+	bool new_cells = cells.extent.width != cell_extent.width || cells.extent.height != cell_extent.height ||
+		cells.extent.depth != cell_extent.depth;
+	bool new_atlas = !atlas.image || map.brick_capacity() > atlas_capacity;
+	if (!new_cells && !new_atlas && changes.bricks.empty() && !changes.has_cells()) {
+		return;
+	}
+
+	if (new_cells || new_atlas) {
+		// The descriptor set gets rewritten, which mustn't happen while a frame that uses it is in flight
+		vkDeviceWaitIdle(ctx->device);
+	}
+	if (new_cells) {
+		destroy_texture(cells);
+		create_texture(cells, VK_FORMAT_R32G32_UINT, cell_extent);
+		changes.cell_begin = {0, 0, 0};
+		changes.cell_end = dimensions;
+
+		BrickMapInfo info{
+			.origin = {map.get_origin().coords[0], map.get_origin().coords[1], map.get_origin().coords[2], 0.0},
+			.cell_size = map.get_cell_size(),
+		};
+		void *mapped;
+		vkMapMemory(ctx->device, info_memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+		std::memcpy(mapped, &info, sizeof(info));
+		vkUnmapMemory(ctx->device, info_memory);
+	}
+	if (new_atlas) {
+		const uint32_t bricks_per_layer = BrickMap::ATLAS_WIDTH_BRICKS * BrickMap::ATLAS_WIDTH_BRICKS;
+		const uint32_t max_layers = BrickMap::MAX_DIMENSION / BrickMap::BRICK_SIZE;
+		// Grow ahead, so edits that add a few bricks don't recreate it every time
+		uint32_t wanted = map.brick_capacity() + map.brick_capacity() / 2;
+		uint32_t layers = std::clamp((wanted + bricks_per_layer - 1) / bricks_per_layer, 1u, max_layers);
+		if (map.brick_capacity() > layers * bricks_per_layer) {
+			throw std::runtime_error("Brick map has more bricks than its atlas can hold, use a bigger voxel size");
+		}
+		destroy_texture(atlas);
+		uint32_t width = BrickMap::ATLAS_WIDTH_BRICKS * BrickMap::BRICK_SIZE;
+		create_texture(atlas, ATLAS_FORMAT, {width, width, layers * BrickMap::BRICK_SIZE});
+		atlas_capacity = layers * bricks_per_layer;
+		LOG_DEBUG("Created %ux%ux%u brick atlas", width, width, layers * BrickMap::BRICK_SIZE);
+
+		// Every brick moves into the new texture
+		changes.bricks.resize(map.brick_capacity());
+		for (uint32_t brick = 0; brick < map.brick_capacity(); brick++) {
+			changes.bricks[brick] = brick;
+		}
+	}
+
+	std::array<uint32_t, 3> box{0, 0, 0};
+	if (changes.has_cells()) {
+		for (int axis = 0; axis < 3; axis++) {
+			box[axis] = changes.cell_end[axis] - changes.cell_begin[axis];
+		}
+	}
+	VkDeviceSize cell_bytes = (VkDeviceSize)box[0] * box[1] * box[2] * sizeof(BrickCell);
+	VkDeviceSize brick_bytes = BrickMap::BRICK_VOXELS * sizeof(float);
+	VkDeviceSize staging_size = std::max(cell_bytes + changes.bricks.size() * brick_bytes, (VkDeviceSize)1);
+
+	VkBuffer staging;
+	VkDeviceMemory staging_memory;
+	ctx->create_buffer(
+		staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, staging_memory
+	);
+	uint8_t *mapped;
+	vkMapMemory(ctx->device, staging_memory, 0, VK_WHOLE_SIZE, 0, (void **)&mapped);
+
+	// The changed box of cells, a row at a time, then each changed brick whole
+	auto &grid = map.get_cells();
+	size_t offset = 0;
+	for (uint32_t z = 0; z < box[2]; z++) {
+		for (uint32_t y = 0; y < box[1]; y++) {
+			auto first = changes.cell_begin[0] +
+				((changes.cell_begin[1] + y) + (changes.cell_begin[2] + z) * dimensions[1]) * dimensions[0];
+			std::memcpy(mapped + offset, &grid[first], box[0] * sizeof(BrickCell));
+			offset += box[0] * sizeof(BrickCell);
+		}
+	}
+	std::vector<VkBufferImageCopy> brick_regions;
+	brick_regions.reserve(changes.bricks.size());
+	for (auto brick : changes.bricks) {
+		std::memcpy(mapped + offset, map.brick_data(brick), brick_bytes);
+		auto position = BrickMap::atlas_position(brick);
+		brick_regions.push_back({
+			.bufferOffset = offset,
+			.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+			.imageOffset =
+				{
+					(int32_t)(position[0] * BrickMap::BRICK_SIZE),
+					(int32_t)(position[1] * BrickMap::BRICK_SIZE),
+					(int32_t)(position[2] * BrickMap::BRICK_SIZE),
+				},
+			.imageExtent = {BrickMap::BRICK_SIZE, BrickMap::BRICK_SIZE, BrickMap::BRICK_SIZE},
+		});
+		offset += brick_bytes;
+	}
+	vkUnmapMemory(ctx->device, staging_memory);
+
+	VkBufferImageCopy cell_region{
+		.bufferOffset = 0,
+		.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.imageOffset =
+			{(int32_t)changes.cell_begin[0], (int32_t)changes.cell_begin[1], (int32_t)changes.cell_begin[2]},
+		.imageExtent = {box[0], box[1], box[2]},
+	};
+
+	ctx->immediate_submit([&](VkCommandBuffer cmd) {
+		// Fresh textures are transitioned even with nothing to copy, so they're always in a layout shaders can read
+		std::vector<VkImageMemoryBarrier2> barriers;
+		auto transition = [&](Texture &texture, bool fresh, bool copying) {
+			if (!fresh && !copying) {
+				return;
+			}
+			barriers.push_back({
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+				// Earlier frames' reads of the texture finish before it's overwritten
+				.srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+				.srcAccessMask = VK_ACCESS_2_NONE,
+				.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+				.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				.oldLayout = fresh ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = texture.image,
+				.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+			});
+		};
+		transition(cells, new_cells, changes.has_cells());
+		transition(atlas, new_atlas, !brick_regions.empty());
+		VkDependencyInfo to_transfer{
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.imageMemoryBarrierCount = (uint32_t)barriers.size(),
+			.pImageMemoryBarriers = barriers.data(),
+		};
+		ctx->vk.CmdPipelineBarrier2(cmd, &to_transfer);
+
+		if (changes.has_cells()) {
+			ctx->vk.CmdCopyBufferToImage(
+				cmd, staging, cells.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &cell_region
+			);
+		}
+		if (!brick_regions.empty()) {
+			ctx->vk.CmdCopyBufferToImage(
+				cmd, staging, atlas.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, brick_regions.size(),
+				brick_regions.data()
+			);
+		}
+
+		for (auto &barrier : barriers) {
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+		VkDependencyInfo to_sampled{
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.imageMemoryBarrierCount = (uint32_t)barriers.size(),
+			.pImageMemoryBarriers = barriers.data(),
+		};
+		ctx->vk.CmdPipelineBarrier2(cmd, &to_sampled);
+	});
+
+	vkDestroyBuffer(ctx->device, staging, nullptr);
+	vkFreeMemory(ctx->device, staging_memory, nullptr);
+	if (new_cells || new_atlas) {
+		write_descriptors();
+	}
+}
+
+void BrickMapTextures::create_descriptors() {
+	// Cells are fetched by index, the atlas is filtered
+	VkSamplerCreateInfo sampler_info{
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_NEAREST,
+		.minFilter = VK_FILTER_NEAREST,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.maxLod = 0.0f,
+	};
+	if (VK_SUCCESS != vkCreateSampler(ctx->device, &sampler_info, nullptr, &cell_sampler)) {
+		throw std::runtime_error("Failed to create brick cell sampler");
+	}
+	sampler_info.magFilter = VK_FILTER_LINEAR;
+	sampler_info.minFilter = VK_FILTER_LINEAR;
+	if (VK_SUCCESS != vkCreateSampler(ctx->device, &sampler_info, nullptr, &atlas_sampler)) {
+		throw std::runtime_error("Failed to create brick atlas sampler");
+	}
+
+	VkDescriptorSetLayoutBinding bindings[] = {
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		},
+		{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		},
+		{
+			.binding = 2,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		},
+	};
+	VkDescriptorSetLayoutCreateInfo layout_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 3,
+		.pBindings = bindings,
+	};
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(ctx->device, &layout_info, nullptr, &descriptor_set_layout)) {
+		throw std::runtime_error("Failed to create brick map Descriptor Set Layout");
+	}
+
+	VkDescriptorPoolSize pool_sizes[] = {
+		{.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 2},
+		{.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1},
+	};
+	VkDescriptorPoolCreateInfo pool_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = 1,
+		.poolSizeCount = 2,
+		.pPoolSizes = pool_sizes,
+	};
+	if (VK_SUCCESS != vkCreateDescriptorPool(ctx->device, &pool_info, nullptr, &descriptor_pool)) {
+		throw std::runtime_error("Failed to create brick map Descriptor Pool");
+	}
+
+	VkDescriptorSetAllocateInfo alloc_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &descriptor_set_layout,
+	};
+	if (VK_SUCCESS != vkAllocateDescriptorSets(ctx->device, &alloc_info, &descriptor_set)) {
+		throw std::runtime_error("Failed to allocate brick map Descriptor Set");
+	}
+}
+
+void BrickMapTextures::create_texture(Texture &texture, VkFormat format, VkExtent3D extent) {
+	VkImageCreateInfo image_info{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_3D,
+		.format = format,
+		.extent = extent,
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+	};
+	if (VK_SUCCESS != vkCreateImage(ctx->device, &image_info, nullptr, &texture.image)) {
+		throw std::runtime_error("Failed to create brick map Image");
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(ctx->device, texture.image, &requirements);
+	VkMemoryAllocateInfo alloc_info{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = requirements.size,
+		.memoryTypeIndex = ctx->find_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+	};
+	if (VK_SUCCESS != vkAllocateMemory(ctx->device, &alloc_info, nullptr, &texture.memory)) {
+		throw std::runtime_error("Failed to allocate brick map Image memory");
+	}
+	vkBindImageMemory(ctx->device, texture.image, texture.memory, 0);
+
+	VkImageViewCreateInfo view_info{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image = texture.image,
+		.viewType = VK_IMAGE_VIEW_TYPE_3D,
+		.format = format,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+	};
+	if (VK_SUCCESS != vkCreateImageView(ctx->device, &view_info, nullptr, &texture.view)) {
+		throw std::runtime_error("Failed to create brick map Image View");
+	}
+	texture.extent = extent;
+}
+
+void BrickMapTextures::destroy_texture(Texture &texture) {
+	if (texture.view) {
+		vkDestroyImageView(ctx->device, texture.view, nullptr);
+	}
+	if (texture.image) {
+		vkDestroyImage(ctx->device, texture.image, nullptr);
+	}
+	if (texture.memory) {
+		vkFreeMemory(ctx->device, texture.memory, nullptr);
+	}
+	texture = Texture{};
+}
+
+void BrickMapTextures::write_descriptors() {
+	VkDescriptorImageInfo cell_image{
+		.sampler = cell_sampler,
+		.imageView = cells.view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+	VkDescriptorImageInfo atlas_image{
+		.sampler = atlas_sampler,
+		.imageView = atlas.view,
+		.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+	VkDescriptorBufferInfo info{
+		.buffer = info_buffer,
+		.offset = 0,
+		.range = VK_WHOLE_SIZE,
+	};
+	VkWriteDescriptorSet writes[] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptor_set,
+			.dstBinding = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &cell_image,
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptor_set,
+			.dstBinding = 1,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &atlas_image,
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptor_set,
+			.dstBinding = 2,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.pBufferInfo = &info,
+		},
+	};
+	vkUpdateDescriptorSets(ctx->device, 3, writes, 0, nullptr);
+}
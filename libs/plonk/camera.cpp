@@ -1,4 +1,5 @@
 #include "include/plonk/camera.h"
+#include "include/plonk/trace.h"
 #include <iostream>
 
 Camera::Camera() {}
@@ -14,6 +15,7 @@ void Camera::set_direction(Vector3 direction) {
 }
 
 void Camera::rotate(float x, float y) {
+	TRACE_FUNCTION();
 	auto transform = Matrix4::identity();
 	auto look_at = Matrix4::look_at(direction);
 	transform *= look_at;
@@ -0,0 +1,72 @@
+#include "include/plonk/camera_path.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+CameraPath CameraPath::load(const std::string &filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open camera path: " + filename);
+	}
+	return parse(file);
+}
+
+CameraPath CameraPath::parse(std::istream &input) {
+	CameraPath path;
+	std::string line;
+	int line_number = 0;
+	while (std::getline(input, line)) {
+		line_number++;
+		auto start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#') {
+			continue;
+		}
+
+		std::istringstream fields(line);
+		float t, px, py, pz, dx, dy, dz;
+		if (!(fields >> t >> px >> py >> pz >> dx >> dy >> dz)) {
+			throw std::runtime_error("Invalid camera keyframe on line " + std::to_string(line_number));
+		}
+		if (!path.keyframes.empty() && t < path.keyframes.back().time) {
+			throw std::runtime_error("Camera keyframes out of order on line " + std::to_string(line_number));
+		}
+		path.keyframes.push_back({
+			.time = t,
+			.position = Point3(px, py, pz),
+			.direction = Vector3(dx, dy, dz).normalize(),
+		});
+	}
+
+	if (path.keyframes.empty()) {
+		throw std::runtime_error("Camera path has no keyframes");
+	}
+	return path;
+}
+
+float CameraPath::duration() {
+	return keyframes.back().time - keyframes.front().time;
+}
+
+/**
+ * Move the camera to where it should be `time` seconds after the first keyframe
+ */
+void CameraPath::apply(float time, Camera &camera) {
+	time += keyframes.front().time;
+	size_t next = 0;
+	while (next < keyframes.size() && keyframes[next].time <= time) {
+		next++;
+	}
+
+	if (next == 0 || next == keyframes.size()) {
+		auto &key = next == 0 ? keyframes.front() : keyframes.back();
+		camera.set_position(key.position);
+		camera.set_direction(key.direction);
+		return;
+	}
+
+	auto &a = keyframes[next - 1];
+	auto &b = keyframes[next];
+	float f = (time - a.time) / (b.time - a.time);
+	camera.set_position(a.position + (b.position - a.position) * f);
+	camera.set_direction(a.direction * (1.0 - f) + b.direction * f);
+}
@@ -0,0 +1,24 @@
+# Writes the SPIR-V binary INPUT to the header OUTPUT as a constexpr uint32_t array named SYMBOL.
+# Run in script mode: cmake -DINPUT=... -DOUTPUT=... -DSYMBOL=... -P embed_spirv.cmake
+
+file(READ ${INPUT} hex HEX)
+string(LENGTH "${hex}" length)
+math(EXPR remainder "${length} % 8")
+if(length EQUAL 0 OR NOT remainder EQUAL 0)
+	message(FATAL_ERROR "${INPUT} isn't a whole number of SPIR-V words")
+endif()
+
+# SPIR-V is stored little endian, so each group of four bytes is reversed into a word
+string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " words "${hex}")
+# Eight words to a line; CMake's regex has no {n} repetition
+set(word "0x[0-9a-f]+u, ")
+string(REGEX REPLACE "(${word}${word}${word}${word}${word}${word}${word}${word})" "\\1\n\t" words "${words}")
+string(REPLACE " \n" "\n" words "${words}")
+string(STRIP "${words}" words)
+
+file(WRITE ${OUTPUT}
+	"// Generated from ${INPUT}, do not edit\n"
+	"#pragma once\n\n"
+	"#include <cstdint>\n\n"
+	"alignas(16) constexpr uint32_t ${SYMBOL}[] = {\n\t${words}\n};\n"
+)
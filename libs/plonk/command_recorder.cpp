@@ -0,0 +1,144 @@
+#include "include/plonk/command_recorder.h"
+#include "include/plonk/profiler.h"
+#include "include/plonk/trace.h"
+#include <stdexcept>
+
+CommandRecorder::CommandRecorder(ContextPtr ctx, std::shared_ptr<JobSystem> jobs) : ctx(ctx), jobs(jobs) {
+	VkCommandPoolCreateInfo pool_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = ctx->get_graphics_queue_family_index().value(),
+	};
+	for (auto &slot_pools : pools) {
+		// One per job thread, then one for threads outside the system
+		slot_pools = std::vector<ThreadPool>(jobs->thread_count() + 1);
+		for (auto &pool : slot_pools) {
+			if (VK_SUCCESS != vkCreateCommandPool(ctx->device, &pool_info, nullptr, &pool.pool)) {
+				throw std::runtime_error("Failed to create Command Pool");
+			}
+		}
+	}
+}
+
+CommandRecorder::~CommandRecorder() {
+	vkDeviceWaitIdle(ctx->device);
+	for (auto &slot_pools : pools) {
+		for (auto &pool : slot_pools) {
+			// Destroying the pool frees its buffers too
+			vkDestroyCommandPool(ctx->device, pool.pool, nullptr);
+		}
+	}
+}
+
+/**
+ * Recycle every buffer recorded for frame slot `slot`. Call once the slot's last frame has finished.
+ */
+void CommandRecorder::begin_frame(uint32_t slot) {
+	TRACE_FUNCTION();
+	this->slot = slot;
+	for (auto &pool : pools[slot]) {
+		if (pool.used > 0) {
+			ctx->vk.ResetCommandPool(ctx->device, pool.pool, 0);
+			pool.used = 0;
+		}
+	}
+}
+
+/**
+ * Queue a task to record into its own secondary command buffer during the next `execute`.
+ * Tasks must only use the buffer they're given, and must not throw.
+ */
+void CommandRecorder::add(std::function<void(VkCommandBuffer)> task) {
+	tasks.push_back(std::move(task));
+}
+
+/**
+ * Record every queued task in parallel, then execute them in order from `primary`.
+ * `primary` must be inside `render_pass`, begun with `VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS`, or with no
+ * render pass, inside dynamic rendering to a single `color_format` attachment.
+ */
+void CommandRecorder::execute(
+	VkCommandBuffer primary, VkRenderPass render_pass, VkFramebuffer framebuffer, VkFormat color_format
+) {
+	TRACE_FUNCTION();
+	if (tasks.empty()) {
+		return;
+	}
+
+	VkCommandBufferInheritanceRenderingInfo rendering_inheritance{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &color_format,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+	};
+	VkCommandBufferInheritanceInfo inheritance{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = render_pass ? nullptr : &rendering_inheritance,
+		.renderPass = render_pass,
+		.subpass = 0,
+		.framebuffer = framebuffer,
+		// The pass may be inside a profiler scope's statistics query
+		.pipelineStatistics = ctx->get_enabled_features().inheritedQueries ? Profiler::STATISTICS : 0,
+	};
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &inheritance,
+	};
+
+	auto buffers = ctx->get_frame_arena().make_array<VkCommandBuffer>(tasks.size());
+	auto &slot_pools = pools[slot];
+	jobs->parallel_for(0, tasks.size(), 1, [&](size_t begin, size_t end) {
+		TRACE_SCOPE("Record secondary");
+		auto record = [&](ThreadPool &pool) {
+			for (size_t i = begin; i < end; i++) {
+				auto buffer = next_buffer(pool);
+				ctx->vk.BeginCommandBuffer(buffer, &begin_info);
+				tasks[i](buffer);
+				ctx->vk.EndCommandBuffer(buffer);
+				buffers[i] = buffer;
+			}
+		};
+		if (jobs->owns_current_thread()) {
+			// Only this thread touches its pool, so no locking is needed
+			record(slot_pools[jobs->thread_index()]);
+		}
+		else {
+			std::lock_guard lock(outside_mutex);
+			record(slot_pools.back());
+		}
+	});
+
+	ctx->vk.CmdExecuteCommands(primary, tasks.size(), buffers);
+	tasks.clear();
+}
+
+/**
+ * Total secondary buffers allocated so far. Steady once every thread has seen a busy frame.
+ */
+uint32_t CommandRecorder::buffers_allocated() {
+	uint32_t count = 0;
+	for (auto &slot_pools : pools) {
+		for (auto &pool : slot_pools) {
+			count += pool.buffers.size();
+		}
+	}
+	return count;
+}
+
+VkCommandBuffer CommandRecorder::next_buffer(ThreadPool &pool) {
+	if (pool.used == pool.buffers.size()) {
+		VkCommandBufferAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = pool.pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+			.commandBufferCount = 1,
+		};
+		VkCommandBuffer buffer = VK_NULL_HANDLE;
+		if (VK_SUCCESS != vkAllocateCommandBuffers(ctx->device, &alloc_info, &buffer)) {
+			throw std::runtime_error("Failed to allocate secondary Command Buffer");
+		}
+		pool.buffers.push_back(buffer);
+	}
+	return pool.buffers[pool.used++];
+}
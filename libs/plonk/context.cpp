@@ -1,8 +1,12 @@
 #include "include/plonk/context.h"
 #include "include/plonk/frame.h"
+#include "include/plonk/shader_registry.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
-#include <iostream>
 #include <memory>
 #include <optional>
 #include <vector>
@@ -38,7 +42,7 @@ auto load_file(const std::string &filename) -> std::vector<char> {
 Context::Context() {}
 
 void Context::create_command_pool() {
-	printf("Creating command pool\n");
+	LOG_DEBUG("Creating command pool");
 	auto queue_family_index = get_graphics_queue_family_index();
 	if (!queue_family_index.has_value()) {
 		throw std::runtime_error("No queue family index defined");
@@ -62,16 +66,40 @@ VkCommandBuffer Context::create_command_buffer() {
 		.commandBufferCount = 1,
 	};
 
-	if (VK_SUCCESS != vkAllocateCommandBuffers(device, &alloc_info, &command_buffer)) {
+	VkCommandBuffer buffer;
+	if (VK_SUCCESS != vkAllocateCommandBuffers(device, &alloc_info, &buffer)) {
 		throw std::runtime_error("Failed to allocate command buffer");
 	}
 
-	return command_buffer;
+	return buffer;
 }
 
-VkPipeline Context::create_graphics_pipeline(VkGraphicsPipelineCreateInfo *pipeline_info) {
+void Context::create_command_buffers() {
+	for (auto &buffer : command_buffers) {
+		buffer = create_command_buffer();
+	}
+	command_buffer = command_buffers[0];
+}
+
+/**
+ * Create a pipeline, for the swapchain's render pass if none is given. With dynamic rendering and no render pass the
+ * pipeline is described by its attachment format instead, `color_format` or the swapchain's.
+ */
+VkPipeline Context::create_graphics_pipeline(VkGraphicsPipelineCreateInfo *pipeline_info, VkFormat color_format) {
 	VkPipeline pipeline;
-	if (!pipeline_info->renderPass) {
+	if (color_format == VK_FORMAT_UNDEFINED) {
+		color_format = format();
+	}
+	VkPipelineRenderingCreateInfo rendering_info{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &color_format,
+	};
+	if (!pipeline_info->renderPass && dynamic_rendering) {
+		rendering_info.pNext = pipeline_info->pNext;
+		pipeline_info->pNext = &rendering_info;
+	}
+	else if (!pipeline_info->renderPass) {
 		pipeline_info->renderPass = render_pass;
 	}
 	if (VK_SUCCESS != vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, pipeline_info, nullptr, &pipeline)) {
@@ -81,32 +109,287 @@ VkPipeline Context::create_graphics_pipeline(VkGraphicsPipelineCreateInfo *pipel
 	return pipeline;
 }
 
+VkPipeline Context::create_compute_pipeline(VkShaderModule shader, VkPipelineLayout layout) {
+	VkComputePipelineCreateInfo pipeline_info{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage =
+			{
+				.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+				.stage = VK_SHADER_STAGE_COMPUTE_BIT,
+				.module = shader,
+				.pName = "main",
+			},
+		.layout = layout,
+	};
+
+	VkPipeline pipeline;
+	if (VK_SUCCESS != vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline)) {
+		throw std::runtime_error("Failed to create compute Pipeline");
+	}
+
+	return pipeline;
+}
+
+VkPipeline Context::create_fullscreen_pipeline(
+	VkShaderModule vert_shader, VkShaderModule frag_shader, VkPipelineLayout layout, VkRenderPass pass,
+	VkFormat color_format
+) {
+	VkViewport viewport{
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = width(),
+		.height = height(),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f,
+	};
+
+	VkRect2D scissor{
+		.offset = {0, 0},
+		.extent = size(),
+	};
+
+	VkPipelineViewportStateCreateInfo viewport_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.pViewports = &viewport,
+		.scissorCount = 1,
+		.pScissors = &scissor,
+	};
+
+	VkPipelineShaderStageCreateInfo vert_create_info{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+		.stage = VK_SHADER_STAGE_VERTEX_BIT,
+		.module = vert_shader,
+		.pName = "main",
+	};
+
+	VkPipelineShaderStageCreateInfo frag_create_info{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+		.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.module = frag_shader,
+		.pName = "main",
+	};
+
+	VkPipelineShaderStageCreateInfo stages[] = {vert_create_info, frag_create_info};
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+		.primitiveRestartEnable = VK_FALSE,
+	};
+
+	VkPipelineVertexInputStateCreateInfo vertex_input_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.vertexBindingDescriptionCount = 0,
+		.pVertexBindingDescriptions = nullptr,
+		.vertexAttributeDescriptionCount = 0,
+		.pVertexAttributeDescriptions = nullptr,
+	};
+
+	std::vector<VkDynamicState> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+	VkPipelineDynamicStateCreateInfo dynamic_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
+		.pDynamicStates = dynamic_states.data(),
+	};
+
+	VkPipelineRasterizationStateCreateInfo rasterizer_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.depthClampEnable = VK_FALSE,
+		.rasterizerDiscardEnable = VK_FALSE,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		.cullMode = VK_CULL_MODE_NONE,
+		.frontFace = VK_FRONT_FACE_CLOCKWISE,
+		.depthBiasEnable = VK_FALSE,
+		.depthBiasConstantFactor = 0.0f,
+		.depthBiasClamp = 0.0f,
+		.depthBiasSlopeFactor = 0.0f,
+		.lineWidth = 1.0f,
+	};
+
+	VkPipelineMultisampleStateCreateInfo multisample_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+		.sampleShadingEnable = VK_FALSE,
+		.minSampleShading = 1.0f,
+		.pSampleMask = nullptr,
+		.alphaToCoverageEnable = VK_FALSE,
+		.alphaToOneEnable = VK_FALSE,
+	};
+
+	VkPipelineColorBlendAttachmentState color_blend_attachment{
+		.blendEnable = VK_FALSE,
+		.srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+		.colorBlendOp = VK_BLEND_OP_ADD,
+		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+		.alphaBlendOp = VK_BLEND_OP_ADD,
+		.colorWriteMask =
+			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+	};
+
+	VkPipelineColorBlendStateCreateInfo color_blend_state{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.logicOpEnable = VK_FALSE,
+		.logicOp = VK_LOGIC_OP_COPY,
+		.attachmentCount = 1,
+		.pAttachments = &color_blend_attachment,
+		.blendConstants = {0.0, 0.0, 0.0, 0.0},
+	};
+
+	VkGraphicsPipelineCreateInfo pipeline_info{
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.stageCount = 2,
+		.pStages = stages,
+		.pVertexInputState = &vertex_input_state,
+		.pInputAssemblyState = &input_assembly,
+		.pViewportState = &viewport_state,
+		.pRasterizationState = &rasterizer_state,
+		.pMultisampleState = &multisample_state,
+		.pDepthStencilState = nullptr,
+		.pColorBlendState = &color_blend_state,
+		.pDynamicState = &dynamic_state,
+		.layout = layout,
+		.renderPass = pass,
+		.subpass = 0,
+		.basePipelineHandle = VK_NULL_HANDLE,
+		.basePipelineIndex = -1,
+	};
+
+	return create_graphics_pipeline(&pipeline_info, color_format);
+}
+
+uint32_t Context::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties) {
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+		if ((type_filter & (1 << i)) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a suitable memory type");
+}
+
+VkFormatFeatureFlags Context::optimal_format_features(VkFormat format) {
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+	return properties.optimalTilingFeatures;
+}
+
+void Context::create_buffer(
+	VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer,
+	VkDeviceMemory &memory
+) {
+	VkBufferCreateInfo buffer_info{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	};
+	if (VK_SUCCESS != vkCreateBuffer(device, &buffer_info, nullptr, &buffer)) {
+		throw std::runtime_error("Failed to create Buffer");
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, buffer, &requirements);
+	VkMemoryAllocateInfo alloc_info{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = requirements.size,
+		.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits, properties),
+	};
+	if (VK_SUCCESS != vkAllocateMemory(device, &alloc_info, nullptr, &memory)) {
+		throw std::runtime_error("Failed to allocate Buffer memory");
+	}
+	vkBindBufferMemory(device, buffer, memory, 0);
+}
+
+/**
+ * Record and run a one-off command buffer, blocking until the GPU has finished with it
+ */
+void Context::immediate_submit(std::function<void(VkCommandBuffer)> callback) {
+	VkCommandBufferAllocateInfo alloc_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = command_pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1,
+	};
+
+	VkCommandBuffer cmd;
+	if (VK_SUCCESS != vkAllocateCommandBuffers(device, &alloc_info, &cmd)) {
+		throw std::runtime_error("Failed to allocate command buffer");
+	}
+
+	VkCommandBufferBeginInfo begin_info{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
+	vk.BeginCommandBuffer(cmd, &begin_info);
+	callback(cmd);
+	vk.EndCommandBuffer(cmd);
+
+	// Waits for this submission only, rather than the whole queue with any frames in flight
+	scheduler->wait(scheduler->submit(graphics_lane, {.command_buffers = {cmd}}));
+	vkFreeCommandBuffers(device, command_pool, 1, &cmd);
+}
+
+float Context::timestamp_period() {
+	return device_info.timestamp_period;
+}
+
+uint32_t Context::timestamp_valid_bits() {
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+	return families[graphics_queue_family_index.value()].timestampValidBits;
+}
+
 void Context::bind_pipeline(VkPipeline &pipeline) {
-	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vk.CmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 }
 
 /**
- * Load a SPIR-V shader from disk
+ * Load a SPIR-V shader, straight from the copy embedded in the binary at build time
  *
- * @param filename Path to the compiled shader
+ * With a shader directory set (`set_shader_dir` or PLONK_SHADER_DIR) `<dir>/<name>.spv` is loaded from disk instead,
+ * to try out shader changes without rebuilding. Shaders that weren't embedded are loaded from `shaders/`.
+ *
+ * @param name Shader source name without the .glsl extension, e.g. "simple.frag"
  * @return The Vulkan shader module
  */
-auto Context::load_shader(const std::string &filename) -> VkShaderModule {
-	std::cout << "Opening shader: " << filename << "\n";
+auto Context::load_shader(const std::string &name) -> VkShaderModule {
+	auto env_dir = std::getenv("PLONK_SHADER_DIR");
+	auto dir = !shader_dir.empty() ? shader_dir : env_dir ? env_dir : "";
+	if (dir.empty()) {
+		if (auto embedded = find_embedded_shader(name)) {
+			return create_shader_module(embedded->code, embedded->size);
+		}
+		dir = "shaders";
+	}
+
+	auto filename = dir + "/" + name + ".spv";
+	LOG_DEBUG("Opening shader: %s", filename.c_str());
 	auto code = load_file(filename);
+	return create_shader_module(reinterpret_cast<const uint32_t *>(code.data()), code.size());
+}
 
+VkShaderModule Context::create_shader_module(const uint32_t *code, size_t size) {
 	VkShaderModuleCreateInfo create_info{
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-		.codeSize = code.size(),
-		.pCode = reinterpret_cast<const uint32_t *>(code.data()),
+		.codeSize = size,
+		.pCode = code,
 	};
 
 	VkShaderModule shader;
 	if (VK_SUCCESS != vkCreateShaderModule(device, &create_info, nullptr, &shader)) {
 		throw std::runtime_error("Failed to create shader module");
 	}
-
-	std::cout << "Shader loaded:" << filename << "\n";
 	return shader;
 }
 
@@ -114,32 +397,141 @@ void Context::destroy_shader(VkShaderModule shader) {
 	vkDestroyShaderModule(device, shader, nullptr);
 }
 
-void Context::attach_window(std::shared_ptr<Window> window) {
-	std::cout << "Attaching window\n";
+/**
+ * Initialise for rendering to `window`. With `jobs`, the swapchain is set up on a worker while the caller carries on,
+ * e.g. building a Renderer, until `finish_startup`.
+ */
+void Context::attach_window(std::shared_ptr<Window> window, std::shared_ptr<JobSystem> jobs) {
+	LOG_INFO("Attaching window");
 	this->window = window;
+	startup = std::make_unique<StartupTasks>(startup_timer, jobs);
 	init_vulkan();
+	vkGetDeviceQueue(device, present_queue_family_index.value(), 0, &present_queue);
 
-	VkResult result = glfwCreateWindowSurface(instance, window->inner, nullptr, &surface);
-	if (VK_SUCCESS != result) {
-		throw std::runtime_error("Failed to create window surface");
-	}
+	// The format is fixed, so the render pass and pipelines needn't wait for the swapchain itself
+	surface_format = {
+		.format = VK_FORMAT_B8G8R8A8_SRGB,
+		.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+	};
+	extent = {
+		.width = static_cast<uint32_t>(window->width()),
+		.height = static_cast<uint32_t>(window->height()),
+	};
+	startup_timer.time("Render pass", [this]() { create_render_pass(); });
+	startup->run("Swapchain", [this]() {
+		create_swapchain();
+		rebuild_image_views();
+		create_present_semaphores();
+		rebuild_framebuffers();
+	});
+	startup_timer.time("Command buffers", [this]() {
+		create_command_pool();
+		create_command_buffers();
+	});
+}
 
-	present_queue_family_index = find_present_queue();
-	if (!present_queue_family_index.has_value()) {
-		throw std::runtime_error("Couldn't find a valid present queue family");
-	}
-	vkGetDeviceQueue(device, present_queue_family_index.value(), 0, &present_queue);
+/**
+ * Initialise without a window, rendering into offscreen images instead of a swapchain.
+ * Frames are left in `output_layout()` for copying out, and presenting them only submits the work.
+ */
+void Context::init_headless(uint32_t width, uint32_t height) {
+	LOG_INFO("Initialising headless context");
+	headless = true;
+	init_vulkan();
+	StartupScope phase(startup_timer, "Offscreen targets");
 
-	resize_swapchain(window->width(), window->height());
+	surface_format = {
+		.format = VK_FORMAT_B8G8R8A8_SRGB,
+		.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+	};
+	extent = {
+		.width = width,
+		.height = height,
+	};
+	create_offscreen_images();
 	create_render_pass();
 	create_command_pool();
-	create_command_buffer();
+	create_command_buffers();
 	rebuild_image_views();
 	rebuild_framebuffers();
 }
 
+ContextProfile Context::get_profile() {
+	if (profile_override.has_value()) {
+		return profile_override.value();
+	}
+	auto env_profile = std::getenv("PLONK_MODE");
+	return env_profile && std::string(env_profile) == "production" ? ContextProfile::PRODUCTION
+																	: ContextProfile::DEVELOPMENT;
+}
+
+/**
+ * Where independent startup work goes, so it overlaps whatever the window's swapchain setup is doing
+ */
+StartupTasks &Context::get_startup() {
+	if (!startup) {
+		startup = std::make_unique<StartupTasks>(startup_timer);
+	}
+	return *startup;
+}
+
+/**
+ * Wait for the startup work still running and report where the time went. Called by the Renderer once it's built,
+ * and by the first frame otherwise.
+ */
+void Context::finish_startup() {
+	if (!startup) {
+		return;
+	}
+	auto tasks = std::move(startup);
+	tasks->wait();
+	startup_timer.report();
+}
+
+void Context::create_offscreen_images() {
+	// One more than the frames in flight, so a finished image can be read back while the others render
+	uint32_t image_count = MAX_FRAMES_IN_FLIGHT + 1;
+	LOG_DEBUG("Creating %d offscreen images", image_count);
+	swapchain_images.resize(image_count);
+	offscreen_memory.resize(image_count);
+
+	for (uint32_t i = 0; i < image_count; i++) {
+		VkImageCreateInfo image_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = surface_format.format,
+			.extent = {extent.width, extent.height, 1},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		};
+		if (VK_SUCCESS != vkCreateImage(device, &image_info, nullptr, &swapchain_images[i])) {
+			throw std::runtime_error("Failed to create offscreen image");
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(device, swapchain_images[i], &requirements);
+		VkMemoryAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = requirements.size,
+			.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+		};
+		if (VK_SUCCESS != vkAllocateMemory(device, &alloc_info, nullptr, &offscreen_memory[i])) {
+			throw std::runtime_error("Failed to allocate offscreen image memory");
+		}
+		vkBindImageMemory(device, swapchain_images[i], offscreen_memory[i], 0);
+	}
+}
+
 bool Context::needs_resize() {
-	return (extent.width != window->width() || extent.height != window->height());
+	if (!window) {
+		return false;
+	}
+	return swapchain_stale || extent.width != window->width() || extent.height != window->height();
 }
 
 void Context::update_swapchain() {
@@ -152,9 +544,13 @@ void Context::rebuild_swapchain() {
 	if (!window) {
 		throw std::runtime_error("Can't create swapchain without an attached window");
 	}
+	// Frames still in flight may be using the old swapchain
+	vkDeviceWaitIdle(device);
 	resize_swapchain(window->width(), window->height());
 	rebuild_image_views();
+	create_present_semaphores();
 	rebuild_framebuffers();
+	swapchain_stale = false;
 }
 
 auto Context::find_present_queue() -> std::optional<uint32_t> {
@@ -198,15 +594,51 @@ auto Context::find_graphics_queue() -> std::optional<uint32_t> {
 	return 0;
 }
 
+/**
+ * First queue family with all of `wanted` and none of `unwanted`, e.g. a compute family that can't do graphics
+ */
+auto Context::find_queue_family(VkQueueFlags wanted, VkQueueFlags unwanted) -> std::optional<uint32_t> {
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+	for (uint32_t i = 0; i < family_count; i++) {
+		if ((families[i].queueFlags & wanted) == wanted && !(families[i].queueFlags & unwanted)) {
+			return i;
+		}
+	}
+	return std::nullopt;
+}
+
 void Context::init_vulkan() {
-	std::cout << "Initialising Vulkan\n";
+	LOG_DEBUG("Initialising Vulkan");
+	bool development = get_profile() == ContextProfile::DEVELOPMENT;
+	LOG_INFO("%s profile", development ? "Development" : "Production");
+	StartupScope instance_phase(startup_timer, "Instance");
 	uint32_t extension_count = 0;
-	auto extension_names = glfwGetRequiredInstanceExtensions(&extension_count);
-
+	const char **extension_names = nullptr;
+	if (!headless) {
+		extension_names = glfwGetRequiredInstanceExtensions(&extension_count);
+	}
 
-	const std::vector<const char *> validation_layers = {
-		"VK_LAYER_KHRONOS_validation",
-	};
+	// Software drivers on build machines often don't ship the validation layer
+	std::vector<const char *> validation_layers;
+	if (development) {
+		uint32_t layer_count = 0;
+		vkEnumerateInstanceLayerProperties(&layer_count, nullptr);
+		std::vector<VkLayerProperties> layers(layer_count);
+		vkEnumerateInstanceLayerProperties(&layer_count, layers.data());
+		for (const auto &layer : layers) {
+			if (std::string(layer.layerName) == "VK_LAYER_KHRONOS_validation") {
+				validation_layers.push_back("VK_LAYER_KHRONOS_validation");
+			}
+		}
+		if (validation_layers.empty()) {
+			LOG_WARNING("Validation layer not available");
+		}
+	}
 
 	VkApplicationInfo app_info{
 		.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
@@ -229,11 +661,22 @@ void Context::init_vulkan() {
 	if (VK_SUCCESS != vkCreateInstance(&instance_create_info, nullptr, &instance)) {
 		throw std::runtime_error("Failed to create Vulkan instance");
 	}
-	std::cout << "Vulkan instance created\n";
+	LOG_DEBUG("Vulkan instance created");
+	instance_phase.end();
+
+	// Devices that can't present to the window are passed over, so the surface comes first
+	if (!headless) {
+		StartupScope surface_phase(startup_timer, "Surface");
+		if (VK_SUCCESS != glfwCreateWindowSurface(instance, window->inner, nullptr, &surface)) {
+			throw std::runtime_error("Failed to create window surface");
+		}
+	}
+
+	StartupScope device_phase(startup_timer, "Device");
 
 	uint32_t device_count = 0;
 	vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
-	printf("Found %d device(s)\n", device_count);
+	LOG_INFO("Found %d device(s)", device_count);
 
 	if (device_count == 0) {
 		throw std::runtime_error("Couldn't find a GPU");
@@ -241,68 +684,163 @@ void Context::init_vulkan() {
 
 	std::vector<VkPhysicalDevice> devices(device_count);
 	vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
-	physical_device = devices[0];
+	std::vector<DeviceInfo> candidates;
+	for (auto candidate : devices) {
+		candidates.push_back(probe_device(candidate, surface));
+		LOG_INFO("  %s: score %ld", candidates.back().name.c_str(), (long)score_device(candidates.back()));
+	}
+	auto env_preference = std::getenv("PLONK_DEVICE");
+	auto preference = !device_preference.empty() ? device_preference : env_preference ? env_preference : "";
+	auto chosen = select_device(candidates, preference);
+	if (!chosen.has_value()) {
+		throw std::runtime_error(
+			"No GPU supports Vulkan 1.3 with synchronization2 and timeline semaphores, and can present to the window"
+		);
+	}
+	physical_device = devices[chosen.value()];
+	device_info = candidates[chosen.value()];
+	log_device(device_info);
 
 	graphics_queue_family_index = find_graphics_queue();
 	if (!graphics_queue_family_index.has_value()) {
 		throw std::runtime_error("Couldn't find a valid graphics queue family");
 	}
+	if (!headless) {
+		present_queue_family_index = find_present_queue();
+		if (!present_queue_family_index.has_value()) {
+			throw std::runtime_error("Couldn't find a valid present queue family");
+		}
+	}
 
-	std::cout << "Queue family found\n";
+	LOG_DEBUG("Queue family found");
+
+	// Dedicated families run alongside graphics; PLONK_SINGLE_QUEUE puts everything back on the graphics queue
+	compute_queue_family_index = graphics_queue_family_index;
+	transfer_queue_family_index = graphics_queue_family_index;
+	if (!std::getenv("PLONK_SINGLE_QUEUE")) {
+		if (auto family = find_queue_family(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT)) {
+			compute_queue_family_index = family;
+		}
+		if (auto family = find_queue_family(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) {
+			transfer_queue_family_index = family;
+		}
+	}
+	LOG_INFO(
+		"Queue families: graphics %d, compute %d, transfer %d", graphics_queue_family_index.value(),
+		compute_queue_family_index.value(), transfer_queue_family_index.value()
+	);
 
 	float queue_priority = 1.0f;
-	VkDeviceQueueCreateInfo queue_create_info{
-		.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-		.queueFamilyIndex = graphics_queue_family_index.value(),
-		.queueCount = 1,
-		.pQueuePriorities = &queue_priority,
+	std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
+	std::vector<std::optional<uint32_t>> families{
+		graphics_queue_family_index, compute_queue_family_index, transfer_queue_family_index
 	};
+	if (!headless) {
+		families.push_back(present_queue_family_index);
+	}
+	for (auto family : families) {
+		bool seen = std::any_of(queue_create_infos.begin(), queue_create_infos.end(), [&](auto &info) {
+			return info.queueFamilyIndex == family.value();
+		});
+		if (!seen) {
+			queue_create_infos.push_back({
+				.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+				.queueFamilyIndex = family.value(),
+				.queueCount = 1,
+				.pQueuePriorities = &queue_priority,
+			});
+		}
+	}
 
-	const std::vector<const char *> device_extensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-	VkPhysicalDeviceFeatures device_features{};
+	std::vector<const char *> device_extensions;
+	if (!headless) {
+		device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
+	VkPhysicalDeviceFeatures supported_features;
+	vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+	// Pipeline statistics are only for the profiler overlay. Its queries stay active while secondary command buffers
+	// execute, so they're only collected where those can inherit them.
+	bool statistics =
+		development && supported_features.pipelineStatisticsQuery && supported_features.inheritedQueries;
+	enabled_features = {
+		.pipelineStatisticsQuery = statistics,
+		.fragmentStoresAndAtomics = supported_features.fragmentStoresAndAtomics,
+		.inheritedQueries = statistics,
+	};
+	// Core since 1.3: synchronization2 for render graph barriers, and dynamic rendering unless told not to
+	dynamic_rendering = device_info.dynamic_rendering && !std::getenv("PLONK_RENDER_PASS");
+	LOG_INFO("Using %s", dynamic_rendering ? "dynamic rendering" : "render passes");
+
+	VkPhysicalDeviceVulkan13Features vulkan13_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+		.synchronization2 = VK_TRUE,
+		.dynamicRendering = dynamic_rendering,
+	};
+	// Core since 1.2, every submission signals a timeline
+	VkPhysicalDeviceVulkan12Features vulkan12_features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &vulkan13_features,
+		.timelineSemaphore = VK_TRUE,
+	};
 	VkDeviceCreateInfo device_create_info{
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-		.queueCreateInfoCount = 1,
-		.pQueueCreateInfos = &queue_create_info,
+		.pNext = &vulkan12_features,
+		.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size()),
+		.pQueueCreateInfos = queue_create_infos.data(),
 		.enabledLayerCount = static_cast<uint32_t>(validation_layers.size()),
 		.ppEnabledLayerNames = validation_layers.data(),
 		.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size()),
 		.ppEnabledExtensionNames = device_extensions.data(),
-		.pEnabledFeatures = &device_features,
+		.pEnabledFeatures = &enabled_features,
 	};
 
 	if (VK_SUCCESS != vkCreateDevice(physical_device, &device_create_info, nullptr, &device)) {
 		throw std::runtime_error("Failed to create logical device");
 	}
-	std::cout << "Logical device created\n";
+	LOG_DEBUG("Logical device created");
+	vk = DeviceDispatch::load(instance, device, !headless);
 
 	vkGetDeviceQueue(device, graphics_queue_family_index.value(), 0, &graphics_queue);
+	vkGetDeviceQueue(device, compute_queue_family_index.value(), 0, &compute_queue);
+	vkGetDeviceQueue(device, transfer_queue_family_index.value(), 0, &transfer_queue);
 
 	create_sync_objects();
 }
 
 void Context::resize_swapchain(uint32_t width, uint32_t height) {
 	if (swapchain) {
-		std::cout << "Destroying old Swap Chain\n";
+		LOG_DEBUG("Destroying old Swap Chain");
 		vkDestroySwapchainKHR(device, swapchain, nullptr);
 		swapchain = nullptr;
 	}
-	std::cout << "Creating Swap Chain\n";
 	surface_format = {
 		.format = VK_FORMAT_B8G8R8A8_SRGB,
 		.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
 	};
-
 	extent = {
 		.width = width,
 		.height = height,
 	};
+	create_swapchain();
+}
 
+/**
+ * Create the swapchain for the current `surface_format` and `extent`
+ */
+void Context::create_swapchain() {
+	LOG_DEBUG("Creating Swap Chain");
 	VkSurfaceCapabilitiesKHR caps;
-	std::cout << "Checking device capabilities\n";
+	LOG_DEBUG("Checking device capabilities");
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &caps);
 	uint32_t image_count = caps.minImageCount;
-	printf("Swapchain has %d images\n", image_count);
+	LOG_DEBUG("Swapchain has %d images", image_count);
+
+	// Allow copying out of the swapchain for frame capture
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	swapchain_readable = caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	if (swapchain_readable) {
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
 
 	VkSwapchainCreateInfoKHR create_info{
 		.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -312,7 +850,7 @@ void Context::resize_swapchain(uint32_t width, uint32_t height) {
 		.imageColorSpace = surface_format.colorSpace,
 		.imageExtent = extent,
 		.imageArrayLayers = 1,
-		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		.imageUsage = usage,
 		.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
 		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
 		.presentMode = VK_PRESENT_MODE_FIFO_KHR,
@@ -323,23 +861,23 @@ void Context::resize_swapchain(uint32_t width, uint32_t height) {
 	if (VK_SUCCESS != vkCreateSwapchainKHR(device, &create_info, nullptr, &swapchain)) {
 		throw std::runtime_error("Failed to create swapchain");
 	}
-	std::cout << "Created Swap Chain\n";
+	LOG_DEBUG("Created Swap Chain");
 }
 
 void Context::rebuild_image_views() {
 	for (auto view : swapchain_image_views) {
 		vkDestroyImageView(device, view, nullptr);
-		swapchain_image_views.clear();
 	}
+	swapchain_image_views.clear();
 
-	VkSurfaceCapabilitiesKHR caps;
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &caps);
-	uint32_t image_count = caps.minImageCount;
-	printf("Creating %d Swapchain Image Views\n", image_count);
-
-	vkGetSwapchainImagesKHR(device, swapchain, &image_count, nullptr);
-	swapchain_images.resize(image_count);
-	vkGetSwapchainImagesKHR(device, swapchain, &image_count, swapchain_images.data());
+	if (!headless) {
+		uint32_t image_count = 0;
+		vkGetSwapchainImagesKHR(device, swapchain, &image_count, nullptr);
+		swapchain_images.resize(image_count);
+		vkGetSwapchainImagesKHR(device, swapchain, &image_count, swapchain_images.data());
+	}
+	uint32_t image_count = swapchain_images.size();
+	LOG_DEBUG("Creating %d Swapchain Image Views", image_count);
 
 	swapchain_image_views.resize(swapchain_images.size());
 
@@ -373,68 +911,237 @@ void Context::rebuild_image_views() {
 }
 
 Frame Context::aquire_frame() {
-	vkWaitForFences(device, 1, &in_flight_fence, VK_TRUE, UINT64_MAX);
-	vkResetFences(device, 1, &in_flight_fence);
+	TRACE_FUNCTION();
+	finish_startup();
+	current_slot = submitted_frames % MAX_FRAMES_IN_FLIGHT;
+	{
+		TRACE_SCOPE("Wait for frame slot");
+		scheduler->wait(slot_points[current_slot]);
+	}
+	completed_frames = std::max(completed_frames, slot_frames[current_slot]);
+	frame_arenas[current_slot].reset();
+	resources->collect();
+
 	uint32_t index;
-	vkAcquireNextImageKHR(device, get_swapchain(), UINT64_MAX, image_available_semaphore, VK_NULL_HANDLE, &index);
-	Frame frame(as_shared_ptr(), index);
-	vkResetCommandBuffer(command_buffer, 0);
+	if (headless) {
+		index = next_offscreen_image;
+		next_offscreen_image = (next_offscreen_image + 1) % swapchain_images.size();
+	}
+	else {
+		auto acquire = [&]() {
+			return vk.AcquireNextImageKHR(
+				device, get_swapchain(), UINT64_MAX, image_available_semaphores[current_slot], VK_NULL_HANDLE, &index
+			);
+		};
+		VkResult result = acquire();
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			// Nothing was acquired or signalled, so the same semaphore can be used again
+			rebuild_swapchain();
+			result = acquire();
+		}
+		if (result == VK_SUBOPTIMAL_KHR) {
+			// Still usable, so render this frame and rebuild before the next
+			swapchain_stale = true;
+		}
+		else if (result != VK_SUCCESS) {
+			throw std::runtime_error("Failed to acquire swapchain image");
+		}
+	}
+	current_image = index;
+	Frame frame(this, index, current_slot, &frame_arenas[current_slot]);
+	command_buffer = command_buffers[current_slot];
+	vk.ResetCommandBuffer(command_buffer, 0);
 	VkCommandBufferBeginInfo begin_info{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
 		.flags = 0,
 		.pInheritanceInfo = nullptr,
 	};
-	if (VK_SUCCESS != vkBeginCommandBuffer(command_buffer, &begin_info)) {
+	if (VK_SUCCESS != vk.BeginCommandBuffer(command_buffer, &begin_info)) {
 		throw std::runtime_error("Failed to start command recording");
 	}
-	begin_render_pass(index);
 	return frame;
 }
 
-void Context::begin_render_pass(FrameIndex index) {
-	VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-	VkRenderPassBeginInfo render_pass_info{
-		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-		.renderPass = render_pass,
-		.framebuffer = framebuffers[index],
-		.renderArea =
-			{
-				.offset = {0, 0},
-				.extent = size(),
-			},
-		.clearValueCount = 1,
-		.pClearValues = &clear_color,
+RenderTarget Context::get_output_target(FrameIndex index) {
+	return {
+		.image = swapchain_images[index],
+		.view = swapchain_image_views[index],
+		.extent = size(),
+		.final_layout = output_layout(),
+		.load_op = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.clear_value = {{{0.0f, 0.0f, 0.0f, 1.0f}}},
+		.render_pass = render_pass,
+		.framebuffer = get_framebuffer(index),
+	};
+}
+
+void Context::begin_render_pass(FrameIndex index, VkSubpassContents contents) {
+	begin_rendering(command_buffer, get_output_target(index), contents);
+}
+
+void Context::end_render_pass(FrameIndex index) {
+	end_rendering(command_buffer, get_output_target(index));
+}
+
+static void transition_image(
+	const DeviceDispatch &vk, VkCommandBuffer command_buffer, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+	VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages,
+	VkAccessFlags2 dst_access
+) {
+	VkImageMemoryBarrier2 barrier{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+		.srcStageMask = src_stages,
+		.srcAccessMask = src_access,
+		.dstStageMask = dst_stages,
+		.dstAccessMask = dst_access,
+		.oldLayout = old_layout,
+		.newLayout = new_layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+	};
+	VkDependencyInfo dependency_info{
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.imageMemoryBarrierCount = 1,
+		.pImageMemoryBarriers = &barrier,
+	};
+	vk.CmdPipelineBarrier2(command_buffer, &dependency_info);
+}
+
+/**
+ * Start rendering into `target`, with dynamic rendering if it's enabled or its render pass otherwise
+ */
+void Context::begin_rendering(VkCommandBuffer command_buffer, const RenderTarget &target, VkSubpassContents contents) {
+	VkRect2D render_area{
+		.offset = {0, 0},
+		.extent = target.extent,
+	};
+	if (!dynamic_rendering) {
+		VkRenderPassBeginInfo render_pass_info{
+			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+			.renderPass = target.render_pass,
+			.framebuffer = target.framebuffer,
+			.renderArea = render_area,
+			.clearValueCount = 1,
+			.pClearValues = &target.clear_value,
+		};
+		vk.CmdBeginRenderPass(command_buffer, &render_pass_info, contents);
+		return;
+	}
+
+	// Same waits as the render pass dependencies: the acquire semaphore, readback, or sampling by the previous frame
+	transition_image(
+		vk, command_buffer, target.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+			VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+		VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+	);
+	VkRenderingAttachmentInfo color_attachment{
+		.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+		.imageView = target.view,
+		.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.loadOp = target.load_op,
+		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+		.clearValue = target.clear_value,
+	};
+	VkRenderingInfo rendering_info{
+		.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+		.flags = contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+			? (VkRenderingFlags)VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT
+			: 0,
+		.renderArea = render_area,
+		.layerCount = 1,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &color_attachment,
 	};
-	vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+	vk.CmdBeginRendering(command_buffer, &rendering_info);
+}
+
+void Context::end_rendering(VkCommandBuffer command_buffer, const RenderTarget &target) {
+	if (!dynamic_rendering) {
+		vk.CmdEndRenderPass(command_buffer);
+		return;
+	}
+
+	vk.CmdEndRendering(command_buffer);
+	// Presentation waits on a semaphore, anything else is sampled or copied
+	bool presenting = target.final_layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	transition_image(
+		vk, command_buffer, target.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, target.final_layout,
+		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		presenting ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+		presenting ? VK_ACCESS_2_NONE : VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT
+	);
 }
 
 void Context::submit(VkCommandBuffer &command_buffer) {
-	VkSemaphore wait_semaphores[] = {image_available_semaphore};
-	VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	VkSemaphore signal_semaphores[] = {render_finished_semaphore};
-	VkSubmitInfo submit_info{
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = wait_semaphores,
-		.pWaitDstStageMask = wait_stages,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &command_buffer,
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = signal_semaphores,
+	TRACE_FUNCTION();
+	Submission submission{
+		.command_buffers = {command_buffer},
+		.waits = std::move(frame_waits),
 	};
+	frame_waits.clear();
+	// Offscreen images have nothing to wait on, and nothing presents them
+	if (!headless) {
+		submission.binary_waits.push_back(
+			{image_available_semaphores[current_slot], VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT}
+		);
+		submission.binary_signals.push_back(render_finished_semaphores[current_image]);
+	}
+
+	last_frame = scheduler->submit(graphics_lane, submission);
+	slot_points[current_slot] = last_frame;
+	slot_frames[current_slot] = ++submitted_frames;
+}
 
-	if (VK_SUCCESS != vkQueueSubmit(graphics_queue, 1, &submit_info, in_flight_fence)) {
-		throw std::runtime_error("Failed to submit queue");
+/**
+ * Make the next submitted frame wait at `stages` for `point`, e.g. for async work on another queue it consumes
+ */
+void Context::wait_before_frame(TimelinePoint point, VkPipelineStageFlags2 stages) {
+	frame_waits.push_back({point, stages});
+}
+
+/**
+ * Frame arena usage across every slot, e.g. to check frames have stopped outgrowing their arenas
+ */
+FrameArenaStats Context::get_frame_arena_stats() {
+	FrameArenaStats total;
+	for (auto &arena : frame_arenas) {
+		auto stats = arena.get_stats();
+		total.peak_bytes = std::max(total.peak_bytes, stats.peak_bytes);
+		total.capacity += stats.capacity;
+		total.overflow_blocks += stats.overflow_blocks;
+		total.frames += stats.frames;
 	}
+	return total;
+}
+
+/**
+ * Number of submitted frames the GPU has finished, without blocking
+ */
+uint64_t Context::frames_completed() {
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (slot_frames[i] > completed_frames && scheduler->is_complete(slot_points[i])) {
+			completed_frames = slot_frames[i];
+		}
+	}
+	return completed_frames;
+}
+
+void Context::wait_idle() {
+	vkDeviceWaitIdle(device);
+	completed_frames = submitted_frames;
 }
 void Context::present_frame(Frame &frame) {
-	vkCmdEndRenderPass(command_buffer);
-	vkEndCommandBuffer(command_buffer);
+	TRACE_FUNCTION();
+	vk.EndCommandBuffer(command_buffer);
 	submit(command_buffer);
+	if (headless) {
+		return;
+	}
 
-	VkSemaphore wait_semaphores[] = {image_available_semaphore};
-	VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-	VkSemaphore signal_semaphores[] = {render_finished_semaphore};
+	VkSemaphore signal_semaphores[] = {render_finished_semaphores[frame.index]};
 
 	VkSwapchainKHR swapchains[] = {get_swapchain()};
 	VkPresentInfoKHR present_info{
@@ -446,44 +1153,71 @@ void Context::present_frame(Frame &frame) {
 		.pImageIndices = &frame.index,
 		.pResults = nullptr,
 	};
-	vkQueuePresentKHR(present_queue, &present_info);
-	vkDeviceWaitIdle(device);
+	VkResult result = vk.QueuePresentKHR(present_queue, &present_info);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+		swapchain_stale = true;
+	}
+	else if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to present frame");
+	}
 }
 
 void Context::create_sync_objects() {
-	printf("Creating sync objects\n");
+	LOG_DEBUG("Creating sync objects");
 
 	VkSemaphoreCreateInfo semaphore_info{
 		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
 	};
-	VkFenceCreateInfo fence_info{
-		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-		.flags = VK_FENCE_CREATE_SIGNALED_BIT,
-	};
 
-	if (VK_SUCCESS != vkCreateSemaphore(device, &semaphore_info, nullptr, &image_available_semaphore)) {
-		throw std::runtime_error("Failed to create image available semaphore");
-	}
-	if (VK_SUCCESS != vkCreateSemaphore(device, &semaphore_info, nullptr, &render_finished_semaphore)) {
-		throw std::runtime_error("Failed to create render finished semaphore");
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		if (VK_SUCCESS != vkCreateSemaphore(device, &semaphore_info, nullptr, &image_available_semaphores[i])) {
+			throw std::runtime_error("Failed to create image available semaphore");
+		}
 	}
-	if (VK_SUCCESS != vkCreateFence(device, &fence_info, nullptr, &in_flight_fence)) {
-		throw std::runtime_error("Failed to create in-flight fence");
+
+	scheduler = std::make_unique<SubmitScheduler>(device, vk);
+	graphics_lane = scheduler->add_queue(graphics_queue, "graphics");
+	compute_lane = scheduler->add_queue(compute_queue, "compute");
+	transfer_lane = scheduler->add_queue(transfer_queue, "transfer");
+	resources = std::make_unique<ResourceRegistry>(device, *scheduler);
+	// Nothing submitted yet, so these are already reached
+	slot_points.fill({graphics_lane, 0});
+	last_frame = {graphics_lane, 0};
+}
+
+/**
+ * Make sure every swapchain image has a render finished semaphore. Existing ones are kept, as a present may still be
+ * waiting on them.
+ */
+void Context::create_present_semaphores() {
+	VkSemaphoreCreateInfo semaphore_info{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+	};
+	while (render_finished_semaphores.size() < swapchain_images.size()) {
+		VkSemaphore semaphore;
+		if (VK_SUCCESS != vkCreateSemaphore(device, &semaphore_info, nullptr, &semaphore)) {
+			throw std::runtime_error("Failed to create render finished semaphore");
+		}
+		render_finished_semaphores.push_back(semaphore);
 	}
 }
 
 void Context::rebuild_framebuffers() {
 	for (auto framebuffer : framebuffers) {
 		vkDestroyFramebuffer(device, framebuffer, nullptr);
-		framebuffers.clear();
+	}
+	framebuffers.clear();
+	if (dynamic_rendering) {
+		// Attachments are given when rendering begins
+		return;
 	}
 	auto count = swapchain_image_count();
-	printf("Creating %d Framebuffers\n", count);
+	LOG_DEBUG("Creating %d Framebuffers", count);
 
 	framebuffers.resize(count);
 
 	for (int i = 0; i < count; i++) {
-		printf("Framebuffer: %d\n", i);
+		LOG_DEBUG("Framebuffer: %d", i);
 		auto image_view = get_swapchain_image_view(i);
 		if (!image_view) {
 			throw std::runtime_error("Missing image view");
@@ -506,7 +1240,10 @@ void Context::rebuild_framebuffers() {
 }
 
 void Context::create_render_pass() {
-	std::cout << "Creating Render Pass\n";
+	if (dynamic_rendering) {
+		return;
+	}
+	LOG_DEBUG("Creating Render Pass");
 	VkAttachmentDescription color_attachment{
 		.format = format(),
 		.samples = VK_SAMPLE_COUNT_1_BIT,
@@ -515,7 +1252,7 @@ void Context::create_render_pass() {
 		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-		.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		.finalLayout = output_layout(),
 	};
 
 	VkAttachmentReference color_attachment_ref{
@@ -529,35 +1266,70 @@ void Context::create_render_pass() {
 		.pColorAttachments = &color_attachment_ref,
 	};
 
+	// Don't write to the image until the acquire semaphore (or the previous use of the image) has finished with it
+	VkSubpassDependency dependency{
+		.srcSubpass = VK_SUBPASS_EXTERNAL,
+		.dstSubpass = 0,
+		.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		.srcAccessMask = 0,
+		.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+	};
+
 	VkRenderPassCreateInfo render_pass_create_info{
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
 		.attachmentCount = 1,
 		.pAttachments = &color_attachment,
 		.subpassCount = 1,
 		.pSubpasses = &subpass,
+		.dependencyCount = 1,
+		.pDependencies = &dependency,
 	};
 
 	if (VK_SUCCESS != vkCreateRenderPass(device, &render_pass_create_info, nullptr, &render_pass)) {
 		throw std::runtime_error("Failed to create RenderPass");
 	}
-	std::cout << "Render pass created\n";
+	LOG_DEBUG("Render pass created");
 }
 
 Context::~Context() {
-	std::cout << "Destroying Plonk Context\n";
+	LOG_DEBUG("Destroying Plonk Context");
+	startup.reset();
+	if (!device) {
+		// Initialisation failed part way, e.g. no GPU
+		if (instance) {
+			vkDestroyInstance(instance, nullptr);
+		}
+		return;
+	}
+	vkDeviceWaitIdle(device);
+	// Anything its owners didn't remove
+	resources.reset();
 	vkDestroyCommandPool(device, command_pool, nullptr);
 	for (auto framebuffer : framebuffers) {
 		vkDestroyFramebuffer(device, framebuffer, nullptr);
 	}
 	vkDestroyRenderPass(device, render_pass, nullptr);
-	vkDestroySemaphore(device, image_available_semaphore, nullptr);
-	vkDestroySemaphore(device, render_finished_semaphore, nullptr);
-	vkDestroyFence(device, in_flight_fence, nullptr);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+		vkDestroySemaphore(device, image_available_semaphores[i], nullptr);
+	}
+	for (auto semaphore : render_finished_semaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	scheduler.reset();
 	for (auto view : swapchain_image_views) {
 		vkDestroyImageView(device, view, nullptr);
 	}
-	vkDestroySwapchainKHR(device, swapchain, nullptr);
-	vkDestroySurfaceKHR(instance, surface, nullptr);
+	if (headless) {
+		for (uint32_t i = 0; i < swapchain_images.size(); i++) {
+			vkDestroyImage(device, swapchain_images[i], nullptr);
+			vkFreeMemory(device, offscreen_memory[i], nullptr);
+		}
+	}
+	else {
+		vkDestroySwapchainKHR(device, swapchain, nullptr);
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
 	vkDestroyDevice(device, nullptr);
 	vkDestroyInstance(instance, nullptr);
 }
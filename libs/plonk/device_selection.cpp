@@ -0,0 +1,190 @@
+#include "include/plonk/device_selection.h"
+#include "include/plonk/log.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <stdexcept>
+
+static std::string lowercase(std::string text) {
+	std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+	return text;
+}
+
+static const char *type_name(VkPhysicalDeviceType type) {
+	switch (type) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+			return "discrete";
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+			return "integrated";
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+			return "virtual";
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:
+			return "cpu";
+		default:
+			return "other";
+	}
+}
+
+/**
+ * Query what `device` offers. With `surface`, also check it can present there.
+ */
+DeviceInfo probe_device(VkPhysicalDevice device, VkSurfaceKHR surface) {
+	VkPhysicalDeviceVulkan11Properties properties_11{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES,
+	};
+	VkPhysicalDeviceProperties2 properties{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &properties_11,
+	};
+	vkGetPhysicalDeviceProperties2(device, &properties);
+
+	VkPhysicalDeviceVulkan13Features features_13{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+	};
+	VkPhysicalDeviceVulkan12Features features_12{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.pNext = &features_13,
+	};
+	VkPhysicalDeviceFeatures2 features{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = &features_12,
+	};
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	auto &limits = properties.properties.limits;
+	DeviceInfo info{
+		.name = properties.properties.deviceName,
+		.type = properties.properties.deviceType,
+		.api_version = properties.properties.apiVersion,
+		.synchronization2 = features_13.synchronization2 == VK_TRUE,
+		.timeline_semaphore = features_12.timelineSemaphore == VK_TRUE,
+		.dynamic_rendering = features_13.dynamicRendering == VK_TRUE,
+		.max_push_constants_size = limits.maxPushConstantsSize,
+		.subgroup_size = properties_11.subgroupSize,
+		.timestamp_period = limits.timestampPeriod,
+		.max_compute_workgroup_invocations = limits.maxComputeWorkGroupInvocations,
+		.max_image_dimension_2d = limits.maxImageDimension2D,
+	};
+
+	VkPhysicalDeviceMemoryProperties memory;
+	vkGetPhysicalDeviceMemoryProperties(device, &memory);
+	for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+		if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			info.device_local_memory += memory.memoryHeaps[i].size;
+		}
+	}
+
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, families.data());
+	if (surface) {
+		info.present_queue = false;
+	}
+	for (uint32_t i = 0; i < family_count; i++) {
+		auto flags = families[i].queueFlags;
+		info.graphics_queue |= (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		info.dedicated_compute_queue |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+		info.dedicated_transfer_queue |=
+			(flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+		if (surface) {
+			VkBool32 present_support = VK_FALSE;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &present_support);
+			info.present_queue |= present_support == VK_TRUE;
+		}
+	}
+	return info;
+}
+
+/**
+ * How well a device suits the renderer, or -1 if it can't run it at all. Device type dominates, so a discrete GPU
+ * always beats llvmpipe, then async queues, then memory breaks ties between similar devices.
+ */
+int64_t score_device(const DeviceInfo &info) {
+	if (!info.graphics_queue || !info.present_queue || !info.synchronization2 || !info.timeline_semaphore ||
+		info.api_version < VK_API_VERSION_1_3) {
+		return -1;
+	}
+
+	int64_t score = 0;
+	switch (info.type) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+			score += 100000;
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+			score += 50000;
+			break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+			score += 20000;
+			break;
+		default:
+			break;
+	}
+	score += info.dedicated_compute_queue ? 2000 : 0;
+	score += info.dedicated_transfer_queue ? 1000 : 0;
+	score += info.dynamic_rendering ? 500 : 0;
+	// One point per 64MiB, so 8GiB is worth less than a dedicated queue
+	score += std::min<int64_t>(info.device_local_memory >> 26, 999);
+	return score;
+}
+
+/**
+ * Pick the device to use: the one named by `preference` (an index, or part of its name) if it's usable, otherwise
+ * the highest scoring. Returns nothing if no device can run the renderer, and throws if `preference` is an index too
+ * large to be one.
+ */
+std::optional<size_t> select_device(const std::vector<DeviceInfo> &devices, const std::string &preference) {
+	if (!preference.empty()) {
+		bool is_index = std::all_of(preference.begin(), preference.end(), [](unsigned char c) { return std::isdigit(c); });
+		size_t index = 0;
+		if (is_index) {
+			auto end = preference.data() + preference.size();
+			auto [parsed, error] = std::from_chars(preference.data(), end, index);
+			if (error != std::errc() || parsed != end) {
+				throw std::runtime_error("Invalid device index \"" + preference + "\"");
+			}
+		}
+		for (size_t i = 0; i < devices.size(); i++) {
+			bool matches = is_index ? index == i
+									: lowercase(devices[i].name).find(lowercase(preference)) != std::string::npos;
+			if (!matches) {
+				continue;
+			}
+			if (score_device(devices[i]) >= 0) {
+				return i;
+			}
+			LOG_WARNING("Preferred device %s can't run the renderer", devices[i].name.c_str());
+		}
+		LOG_WARNING("No usable device matches \"%s\", choosing automatically", preference.c_str());
+	}
+
+	std::optional<size_t> best;
+	int64_t best_score = -1;
+	for (size_t i = 0; i < devices.size(); i++) {
+		auto score = score_device(devices[i]);
+		if (score > best_score) {
+			best = i;
+			best_score = score;
+		}
+	}
+	return best;
+}
+
+void log_device(const DeviceInfo &info) {
+	LOG_INFO(
+		"Device: %s (%s, Vulkan %d.%d, %.1f GiB device local)", info.name.c_str(), type_name(info.type),
+		VK_API_VERSION_MAJOR(info.api_version), VK_API_VERSION_MINOR(info.api_version),
+		info.device_local_memory / (1024.0 * 1024.0 * 1024.0)
+	);
+	LOG_INFO(
+		"  Queues: async compute %s, async transfer %s", info.dedicated_compute_queue ? "yes" : "no",
+		info.dedicated_transfer_queue ? "yes" : "no"
+	);
+	LOG_INFO(
+		"  Limits: push constants %u bytes, subgroup size %u, timestamp period %.2fns, compute workgroup %u "
+		"invocations, 2D images up to %u",
+		info.max_push_constants_size, info.subgroup_size, info.timestamp_period, info.max_compute_workgroup_invocations,
+		info.max_image_dimension_2d
+	);
+}
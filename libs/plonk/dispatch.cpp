@@ -0,0 +1,40 @@
+#include "include/plonk/dispatch.h"
+#include <stdexcept>
+#include <string>
+
+/**
+ * Load every function for `device` from the driver (or the first layer), rather than the loader
+ */
+DeviceDispatch DeviceDispatch::load(VkInstance instance, VkDevice device, bool swapchain) {
+	// The instance's vkGetDeviceProcAddr skips the loader for the lookups too
+	auto get_device_proc_addr =
+		reinterpret_cast<PFN_vkGetDeviceProcAddr>(vkGetInstanceProcAddr(instance, "vkGetDeviceProcAddr"));
+	if (!get_device_proc_addr) {
+		get_device_proc_addr = vkGetDeviceProcAddr;
+	}
+
+	DeviceDispatch dispatch;
+#define PLONK_DISPATCH_LOAD(name) \
+	dispatch.name = reinterpret_cast<PFN_vk##name>(get_device_proc_addr(device, "vk" #name)); \
+	if (!dispatch.name) { \
+		throw std::runtime_error(std::string("Device is missing vk") + #name); \
+	}
+	PLONK_DEVICE_FUNCTIONS(PLONK_DISPATCH_LOAD)
+	if (swapchain) {
+		PLONK_SWAPCHAIN_FUNCTIONS(PLONK_DISPATCH_LOAD)
+	}
+#undef PLONK_DISPATCH_LOAD
+	return dispatch;
+}
+
+/**
+ * The loader's own exports, which dispatch through its trampolines. Only for comparing against `load`.
+ */
+DeviceDispatch DeviceDispatch::loader() {
+	DeviceDispatch dispatch;
+#define PLONK_DISPATCH_EXPORT(name) dispatch.name = vk##name;
+	PLONK_DEVICE_FUNCTIONS(PLONK_DISPATCH_EXPORT)
+	PLONK_SWAPCHAIN_FUNCTIONS(PLONK_DISPATCH_EXPORT)
+#undef PLONK_DISPATCH_EXPORT
+	return dispatch;
+}
@@ -1,12 +1,16 @@
 #include "include/plonk/frame.h"
 
-Frame::Frame(ContextPtr ctx, FrameIndex index) : ctx(ctx), index(index) {
-}
+Frame::Frame(Context *ctx, FrameIndex index, uint32_t slot, FrameArena *arena)
+	: ctx(ctx), index(index), slot(slot), arena(arena) {}
 
+void Frame::begin_render_pass(VkSubpassContents contents) {
+	ctx->begin_render_pass(index, contents);
+}
 
-Frame::~Frame() {}
+void Frame::end_render_pass() {
+	ctx->end_render_pass(index);
+}
 
 void Frame::present() {
 	ctx->present_frame(*this);
 }
-
@@ -0,0 +1,58 @@
+#include "include/plonk/frame_arena.h"
+#include <algorithm>
+
+FrameArena::FrameArena(size_t capacity) {
+	blocks.reserve(4);
+	add_block(std::max(capacity, (size_t)1));
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment) {
+	auto align = [&](Block &block) {
+		auto base = reinterpret_cast<uintptr_t>(block.data.get());
+		return ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+	};
+	auto start = align(blocks.back());
+	if (start + size > blocks.back().size) {
+		// Whatever's left of the current block is wasted until the reset merges them
+		add_block(std::max(blocks.back().size, size + alignment));
+		frame_overflow_blocks++;
+		stats.overflow_blocks++;
+		start = align(blocks.back());
+	}
+	used += start + size - offset;
+	offset = start + size;
+	return blocks.back().data.get() + start;
+}
+
+/**
+ * Release everything allocated since the last reset. Only call once nothing, including the GPU, still reads it.
+ */
+void FrameArena::reset() {
+	stats.peak_bytes = std::max(stats.peak_bytes, used);
+	stats.frames++;
+	if (blocks.size() > 1) {
+		size_t total = 0;
+		for (auto &block : blocks) {
+			total += block.size;
+		}
+		blocks.clear();
+		add_block(total);
+	}
+	offset = 0;
+	used = 0;
+	frame_overflow_blocks = 0;
+}
+
+FrameArenaStats FrameArena::get_stats() {
+	auto current = stats;
+	current.peak_bytes = std::max(current.peak_bytes, used);
+	for (auto &block : blocks) {
+		current.capacity += block.size;
+	}
+	return current;
+}
+
+void FrameArena::add_block(size_t size) {
+	blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(size), size});
+	offset = 0;
+}
@@ -0,0 +1,278 @@
+#include "include/plonk/frame_capture.h"
+#include "include/plonk/image.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+FrameCapture::FrameCapture(ContextPtr ctx, const std::string &directory, CaptureFormat format, uint32_t worker_count)
+	: ctx(ctx), directory(directory), format(format) {
+	if (!ctx->output_readable()) {
+		throw std::runtime_error("Frame capture unavailable, the surface doesn't allow copying from swapchain images");
+	}
+	std::filesystem::create_directories(directory);
+	for (uint32_t i = 0; i < std::max(worker_count, 1u); i++) {
+		workers.emplace_back(&FrameCapture::run_worker, this);
+	}
+	LOG_INFO("Capturing frames to %s", directory.c_str());
+}
+
+FrameCapture::~FrameCapture() {
+	flush();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	queue_ready.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+	for (auto &slot : slots) {
+		release(slot);
+	}
+	LOG_INFO("Captured %llu frames, dropped %llu", (unsigned long long)written, (unsigned long long)dropped.load());
+}
+
+/**
+ * Hand any readback buffers the GPU has finished with to the encoder workers.
+ * Call once per frame, after the previous frame in its slot has finished.
+ */
+void FrameCapture::begin_frame() {
+	frame++;
+	collect(false);
+}
+
+/**
+ * Record a copy of `image` into the next free readback buffer.
+ * Must be called outside of a render pass, after the image has been rendered. The image is returned to `layout`.
+ */
+void FrameCapture::record(
+	VkCommandBuffer command_buffer, VkImage image, VkImageLayout layout, VkExtent2D extent, VkFormat image_format
+) {
+	TRACE_FUNCTION();
+	if (image_format != VK_FORMAT_B8G8R8A8_SRGB && image_format != VK_FORMAT_B8G8R8A8_UNORM &&
+		image_format != VK_FORMAT_R8G8B8A8_SRGB && image_format != VK_FORMAT_R8G8B8A8_UNORM) {
+		throw std::runtime_error("Unsupported format for frame capture");
+	}
+
+	Slot *slot = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto find_free = [&]() {
+			for (auto &s : slots) {
+				if (s.state == SlotState::FREE) {
+					slot = &s;
+					return true;
+				}
+			}
+			return false;
+		};
+		if (!find_free()) {
+			if (drop_when_busy) {
+				dropped++;
+				return;
+			}
+			TRACE_SCOPE("Wait for capture slot");
+			slot_freed.wait(lock, find_free);
+		}
+		slot->state = SlotState::RECORDED;
+	}
+
+	VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4;
+	if (slot->capacity < size) {
+		release(*slot);
+		allocate(*slot, size);
+	}
+	slot->recorded_frame = frame;
+	slot->sequence = sequence++;
+	slot->extent = extent;
+	slot->format = image_format;
+
+	VkImageMemoryBarrier to_transfer{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.oldLayout = layout,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+	};
+	ctx->vk.CmdPipelineBarrier(
+		command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+		nullptr, 1, &to_transfer
+	);
+
+	VkBufferImageCopy region{
+		.bufferOffset = 0,
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+		.imageOffset = {0, 0, 0},
+		.imageExtent = {extent.width, extent.height, 1},
+	};
+	ctx->vk.CmdCopyImageToBuffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+	VkImageMemoryBarrier to_original{
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+		.dstAccessMask = 0,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		.newLayout = layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+	};
+	VkBufferMemoryBarrier host_barrier{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = slot->buffer,
+		.offset = 0,
+		.size = size,
+	};
+	ctx->vk.CmdPipelineBarrier(
+		command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+		0, 0, nullptr, 1, &host_barrier, 1, &to_original
+	);
+}
+
+/**
+ * Wait for every recorded frame to be written to disk
+ */
+void FrameCapture::flush() {
+	vkDeviceWaitIdle(ctx->device);
+	collect(true);
+	std::unique_lock<std::mutex> lock(mutex);
+	slot_freed.wait(lock, [&]() {
+		for (auto &slot : slots) {
+			if (slot.state != SlotState::FREE) {
+				return false;
+			}
+		}
+		return true;
+	});
+}
+
+uint64_t FrameCapture::frames_written() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return written;
+}
+
+void FrameCapture::collect(bool all) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (uint32_t i = 0; i < RING_SIZE; i++) {
+		auto &slot = slots[i];
+		if (slot.state != SlotState::RECORDED || (!all && frame - slot.recorded_frame < LATENCY)) {
+			continue;
+		}
+		// Memory may not be host coherent
+		VkMappedMemoryRange range{
+			.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+			.memory = slot.memory,
+			.offset = 0,
+			.size = VK_WHOLE_SIZE,
+		};
+		vkInvalidateMappedMemoryRanges(ctx->device, 1, &range);
+		slot.state = SlotState::ENCODING;
+		queue.push_back(i);
+	}
+	queue_ready.notify_all();
+}
+
+void FrameCapture::allocate(Slot &slot, VkDeviceSize size) {
+	// Cached memory is much faster for the CPU to read back, but isn't available everywhere
+	try {
+		ctx->create_buffer(
+			size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, slot.buffer, slot.memory
+		);
+	}
+	catch (const std::runtime_error &) {
+		if (slot.buffer) {
+			vkDestroyBuffer(ctx->device, slot.buffer, nullptr);
+		}
+		ctx->create_buffer(
+			size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot.buffer, slot.memory
+		);
+	}
+	vkMapMemory(ctx->device, slot.memory, 0, size, 0, (void **)&slot.mapped);
+	slot.capacity = size;
+}
+
+void FrameCapture::release(Slot &slot) {
+	if (!slot.buffer) {
+		return;
+	}
+	vkUnmapMemory(ctx->device, slot.memory);
+	vkDestroyBuffer(ctx->device, slot.buffer, nullptr);
+	vkFreeMemory(ctx->device, slot.memory, nullptr);
+	slot.buffer = VK_NULL_HANDLE;
+	slot.memory = VK_NULL_HANDLE;
+	slot.mapped = nullptr;
+	slot.capacity = 0;
+}
+
+void FrameCapture::run_worker() {
+	TRACE_THREAD_NAME("Capture");
+	while (true) {
+		uint32_t index;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			queue_ready.wait(lock, [&]() { return stopping || !queue.empty(); });
+			if (queue.empty()) {
+				return;
+			}
+			index = queue.front();
+			queue.pop_front();
+		}
+
+		try {
+			encode(slots[index]);
+		}
+		catch (const std::exception &e) {
+			LOG_ERROR("Failed to write captured frame: %s", e.what());
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slots[index].state = SlotState::FREE;
+			written++;
+		}
+		slot_freed.notify_all();
+	}
+}
+
+void FrameCapture::encode(Slot &slot) {
+	TRACE_FUNCTION();
+	Image image(slot.extent.width, slot.extent.height);
+	bool bgra = slot.format == VK_FORMAT_B8G8R8A8_SRGB || slot.format == VK_FORMAT_B8G8R8A8_UNORM;
+	auto src = slot.mapped;
+	auto dst = image.pixels.data();
+	size_t pixel_count = (size_t)image.width * image.height;
+	for (size_t i = 0; i < pixel_count; i++, src += 4, dst += 4) {
+		dst[0] = bgra ? src[2] : src[0];
+		dst[1] = src[1];
+		dst[2] = bgra ? src[0] : src[2];
+		dst[3] = 255;
+	}
+
+	char filename[32];
+	snprintf(
+		filename, sizeof(filename), "frame_%06llu.%s", (unsigned long long)slot.sequence,
+		format == CaptureFormat::PNG ? "png" : "rgba"
+	);
+	auto path = (std::filesystem::path(directory) / filename).string();
+	if (format == CaptureFormat::PNG) {
+		image.save_png(path);
+	}
+	else {
+		image.save_raw(path);
+	}
+}
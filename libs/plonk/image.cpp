@@ -0,0 +1,138 @@
+#include "include/plonk/image.h"
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+Image::Image(uint32_t width, uint32_t height) : width(width), height(height) {
+	pixels.resize((size_t)width * height * 4);
+}
+
+static void write_u32_be(std::vector<uint8_t> &out, uint32_t value) {
+	out.push_back(value >> 24);
+	out.push_back(value >> 16);
+	out.push_back(value >> 8);
+	out.push_back(value);
+}
+
+static void write_chunk(std::ofstream &file, const char *type, const std::vector<uint8_t> &data) {
+	std::vector<uint8_t> chunk;
+	chunk.reserve(data.size() + 12);
+	write_u32_be(chunk, data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	write_u32_be(chunk, Image::crc32(chunk.data() + 4, chunk.size() - 4));
+	file.write((const char *)chunk.data(), chunk.size());
+}
+
+uint32_t Image::crc32(const uint8_t *data, size_t size, uint32_t crc) {
+	static const auto table = []() {
+		std::array<uint32_t, 256> table;
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++) {
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			}
+			table[i] = c;
+		}
+		return table;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) {
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+uint32_t Image::adler32(const uint8_t *data, size_t size, uint32_t adler) {
+	uint32_t a = adler & 0xffff;
+	uint32_t b = adler >> 16;
+	while (size > 0) {
+		// Largest run that can't overflow before the modulo
+		size_t run = size < 5552 ? size : 5552;
+		size -= run;
+		while (run--) {
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+/**
+ * Writes an 8-bit RGBA PNG.
+ *
+ * The image data is stored in uncompressed deflate blocks. It makes for large files, but encoding is little more than a
+ * memcpy, which keeps capture workers ahead of the renderer. Recompress offline if size matters.
+ */
+void Image::save_png(const std::string &filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open image for writing: " + filename);
+	}
+
+	const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	file.write((const char *)signature, sizeof(signature));
+
+	std::vector<uint8_t> header;
+	write_u32_be(header, width);
+	write_u32_be(header, height);
+	// 8 bits per channel, RGBA, deflate, adaptive filtering, no interlace
+	header.insert(header.end(), {8, 6, 0, 0, 0});
+	write_chunk(file, "IHDR", header);
+
+	// Each scanline is prefixed with its filter type (0, none)
+	size_t stride = (size_t)width * 4;
+	std::vector<uint8_t> raw;
+	raw.reserve((stride + 1) * height);
+	for (uint32_t y = 0; y < height; y++) {
+		raw.push_back(0);
+		auto row = pixels.data() + y * stride;
+		raw.insert(raw.end(), row, row + stride);
+	}
+
+	const size_t max_block = 65535;
+	std::vector<uint8_t> zlib;
+	zlib.reserve(raw.size() + raw.size() / max_block * 5 + 16);
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+	size_t offset = 0;
+	do {
+		size_t len = raw.size() - offset < max_block ? raw.size() - offset : max_block;
+		bool last = offset + len == raw.size();
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(len & 0xff);
+		zlib.push_back(len >> 8);
+		zlib.push_back(~len & 0xff);
+		zlib.push_back((~len >> 8) & 0xff);
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + len);
+		offset += len;
+	} while (offset < raw.size());
+	write_u32_be(zlib, adler32(raw.data(), raw.size()));
+
+	write_chunk(file, "IDAT", zlib);
+	write_chunk(file, "IEND", {});
+}
+
+/**
+ * Writes the tightly packed RGBA pixels with no header,
+ * e.g. for `ffmpeg -f rawvideo -pix_fmt rgba -s WxH`
+ */
+void Image::save_raw(const std::string &filename) const {
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open image for writing: " + filename);
+	}
+	file.write((const char *)pixels.data(), pixels.size());
+}
+
+void Image::save(const std::string &filename) const {
+	if (filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".png") == 0) {
+		save_png(filename);
+	}
+	else {
+		save_raw(filename);
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "context.h"
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**
+ * Moves a buffer or image between queue families, so work on one queue can hand its results to another.
+ *
+ * Record `release` on the queue giving the resource up and `acquire` on the one taking it, in a submission that waits
+ * for the release's timeline point. Images change from `old_layout` to `new_layout` on the way. When both queues are in
+ * the same family no ownership changes hands, and only the acquire records a barrier, for the layout change.
+ */
+struct OwnershipTransfer {
+	uint32_t src_family;
+	uint32_t dst_family;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkImage image = VK_NULL_HANDLE;
+	VkImageLayout old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkImageLayout new_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	void release(
+		const DeviceDispatch &vk, VkCommandBuffer command_buffer, VkPipelineStageFlags2 src_stages,
+		VkAccessFlags2 src_access
+	) const;
+	void acquire(
+		const DeviceDispatch &vk, VkCommandBuffer command_buffer, VkPipelineStageFlags2 dst_stages,
+		VkAccessFlags2 dst_access
+	) const;
+};
+
+/**
+ * Records and submits one-off command buffers to a compute or transfer queue, so uploads, readbacks and compute
+ * passes can overlap the frame on the graphics queue.
+ *
+ * Command buffers are recycled once the timeline point of the submission that used them is reached. `submit` can be
+ * called from any thread, unless the device has no dedicated family and this falls back to the graphics queue, which
+ * the main thread also presents on.
+ */
+class AsyncQueue {
+public:
+	AsyncQueue(ContextPtr ctx, QueueLane lane, uint32_t family);
+	~AsyncQueue();
+	static AsyncQueue compute(ContextPtr ctx);
+	static AsyncQueue transfer(ContextPtr ctx);
+	TimelinePoint submit(
+		std::function<void(VkCommandBuffer)> record,
+		std::vector<std::pair<TimelinePoint, VkPipelineStageFlags2>> waits = {}
+	);
+	QueueLane get_lane() { return lane; };
+	uint32_t get_family() { return family; };
+
+	// Prevent copies
+	AsyncQueue(const AsyncQueue &) = delete;
+	AsyncQueue &operator=(const AsyncQueue &) = delete;
+	AsyncQueue(AsyncQueue &&other) noexcept;
+
+private:
+	ContextPtr ctx;
+	QueueLane lane;
+	uint32_t family;
+	VkCommandPool pool = VK_NULL_HANDLE;
+	std::deque<std::pair<VkCommandBuffer, TimelinePoint>> in_flight;
+	std::vector<VkCommandBuffer> free_buffers;
+	std::mutex mutex;
+
+	VkCommandBuffer next_buffer();
+};
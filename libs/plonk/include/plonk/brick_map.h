@@ -0,0 +1,143 @@
+#pragma once
+
+#include "context.h"
+#include "job_system.h"
+#include "math.h"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Distances to `count` points given as separate x, y and z arrays, as `SceneSdf::distances` takes them. Called from
+// several threads at once when baking with a job system.
+using SdfSampler = std::function<void(const float *x, const float *y, const float *z, float *out, size_t count)>;
+
+/**
+ * One cell of the indirection grid, laid out as a texel of the R32G32_UINT cells texture
+ */
+struct BrickCell {
+	// Index of the cell's brick, or BrickMap::EMPTY
+	uint32_t brick;
+	// Distance at the cell's centre
+	float distance;
+};
+
+struct BrickMapStats {
+	uint32_t cells;
+	uint32_t bricks;
+	uint32_t allocated_bricks;
+	size_t atlas_bytes;
+};
+
+// What's changed since the last `take_changes`, for uploading only that
+struct BrickMapChanges {
+	std::vector<uint32_t> bricks;
+	// Box of cells to upload, [cell_begin, cell_end), empty when cell_begin isn't below cell_end
+	std::array<uint32_t, 3> cell_begin{};
+	std::array<uint32_t, 3> cell_end{};
+
+	bool has_cells() const { return cell_begin[0] < cell_end[0]; };
+};
+
+/**
+ * A distance field baked into a sparse grid of 8³ bricks, for sampling instead of evaluating costly geometry.
+ *
+ * The map's bounds are split into cells of 7 voxels a side. Only cells whose surface is within a voxel of them get a
+ * brick: 8³ distances on a lattice that includes the cell's corners, so trilinear filtering within a brick never needs
+ * its neighbours. Every cell keeps the distance at its centre, so an empty cell still gives a safe distance to march
+ * by. Bricks are stored back to back, and packed into an atlas ATLAS_WIDTH_BRICKS bricks wide and deep for the GPU.
+ *
+ * `rebake` re-evaluates just the cells around an edit, reusing freed bricks, and records which bricks and cells need
+ * uploading again.
+ */
+class BrickMap {
+public:
+	static const uint32_t BRICK_SIZE = 8;
+	static const uint32_t BRICK_VOXELS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+	static const uint32_t EMPTY = UINT32_MAX;
+	static const uint32_t ATLAS_WIDTH_BRICKS = 32;
+	// The smallest maxImageDimension3D Vulkan allows
+	static const uint32_t MAX_DIMENSION = 256;
+
+	// `min` and `max` bound the geometry, the map reaches a cell further so no surface touches its edges
+	BrickMap(Point3 min, Point3 max, float voxel_size, SdfSampler sdf);
+	void bake(JobSystem *jobs = nullptr);
+	void rebake(Point3 min, Point3 max, JobSystem *jobs = nullptr);
+	float distance(const Point3 &p) const;
+	BrickMapChanges take_changes();
+	BrickMapStats get_stats() const;
+
+	const Point3 &get_origin() const { return origin; };
+	float get_cell_size() const { return cell_size; };
+	const std::array<uint32_t, 3> &get_dimensions() const { return dimensions; };
+	const std::vector<BrickCell> &get_cells() const { return cells; };
+	uint32_t brick_capacity() const { return bricks.size() / BRICK_VOXELS; };
+	const float *brick_data(uint32_t brick) const { return &bricks[(size_t)brick * BRICK_VOXELS]; };
+	static std::array<uint32_t, 3> atlas_position(uint32_t brick);
+
+private:
+	// Bricks per job, each is 512 samples
+	static const size_t GRAIN = 8;
+
+	Point3 origin;
+	float voxel_size;
+	float cell_size;
+	std::array<uint32_t, 3> dimensions;
+	SdfSampler sdf;
+	std::vector<BrickCell> cells;
+	std::vector<float> bricks;
+	std::vector<uint32_t> free_bricks;
+	std::vector<uint8_t> brick_dirty;
+	BrickMapChanges changes;
+
+	void bake_cells(std::array<uint32_t, 3> begin, std::array<uint32_t, 3> end, JobSystem *jobs);
+	uint32_t allocate_brick();
+	Point3 cell_min(uint32_t cell) const;
+	float sample_brick(uint32_t brick, float x, float y, float z) const;
+};
+
+/**
+ * A BrickMap on the GPU: the cell grid as an R32G32_UINT 3D texture, the brick atlas as an R32_SFLOAT one, and the
+ * map's origin and cell size in a uniform buffer, bound together as one descriptor set (see brickMapDistance in
+ * shaders/scene.glsl).
+ *
+ * `upload` copies what's changed since the last one, recreating the textures when the grid's size changes or the atlas
+ * runs out of room.
+ */
+class BrickMapTextures {
+public:
+	BrickMapTextures(ContextPtr ctx);
+	~BrickMapTextures();
+	void upload(BrickMap &map);
+	VkDescriptorSetLayout get_descriptor_set_layout() { return descriptor_set_layout; };
+	VkDescriptorSet get_descriptor_set() { return descriptor_set; };
+
+	// Prevent copies
+	BrickMapTextures(const BrickMapTextures &) = delete;
+	BrickMapTextures &operator=(const BrickMapTextures &) = delete;
+
+private:
+	struct Texture {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkExtent3D extent{0, 0, 0};
+	};
+
+	ContextPtr ctx;
+	Texture cells;
+	Texture atlas;
+	uint32_t atlas_capacity = 0;
+	VkBuffer info_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory info_memory = VK_NULL_HANDLE;
+	VkSampler cell_sampler = VK_NULL_HANDLE;
+	VkSampler atlas_sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+
+	void create_descriptors();
+	void create_texture(Texture &texture, VkFormat format, VkExtent3D extent);
+	void destroy_texture(Texture &texture);
+	void write_descriptors();
+};
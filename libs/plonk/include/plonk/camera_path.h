@@ -0,0 +1,28 @@
+#pragma once
+
+#include "camera.h"
+#include <istream>
+#include <string>
+#include <vector>
+
+struct CameraKeyframe {
+	float time;
+	Point3 position;
+	Vector3 direction;
+};
+
+/**
+ * Keyframed camera flight, linearly interpolated between keyframes.
+ *
+ * Path files have one keyframe per line, `time px py pz dx dy dz`, sorted by time. Blank lines and lines starting with
+ * `#` are ignored.
+ */
+class CameraPath {
+public:
+	std::vector<CameraKeyframe> keyframes;
+
+	static CameraPath load(const std::string &filename);
+	static CameraPath parse(std::istream &input);
+	float duration();
+	void apply(float time, Camera &camera);
+};
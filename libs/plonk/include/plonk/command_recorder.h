@@ -0,0 +1,50 @@
+#pragma once
+
+#include "context.h"
+#include "job_system.h"
+#include <array>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Records the contents of a render pass on several threads at once using secondary command buffers.
+ *
+ * Every job thread gets its own command pool for each frame in flight, so recording needs no locking and a whole
+ * frame's buffers are recycled with one pool reset once the frame has finished on the GPU. Threads outside the job
+ * system can end up running recording jobs while they wait on it, and share one extra pool under a lock. Tasks are
+ * recorded in parallel but always executed in the order they were added, so the output doesn't depend on scheduling.
+ */
+class CommandRecorder {
+public:
+	CommandRecorder(ContextPtr ctx, std::shared_ptr<JobSystem> jobs);
+	~CommandRecorder();
+	void begin_frame(uint32_t slot);
+	void add(std::function<void(VkCommandBuffer)> task);
+	void execute(
+		VkCommandBuffer primary, VkRenderPass render_pass, VkFramebuffer framebuffer,
+		VkFormat color_format = VK_FORMAT_UNDEFINED
+	);
+	uint32_t buffers_allocated();
+
+	// Prevent copies
+	CommandRecorder(const CommandRecorder &) = delete;
+	CommandRecorder &operator=(const CommandRecorder &) = delete;
+
+private:
+	struct alignas(64) ThreadPool {
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers;
+		uint32_t used = 0;
+	};
+
+	ContextPtr ctx;
+	std::shared_ptr<JobSystem> jobs;
+	std::array<std::vector<ThreadPool>, Context::MAX_FRAMES_IN_FLIGHT> pools;
+	std::vector<std::function<void(VkCommandBuffer)>> tasks;
+	uint32_t slot = 0;
+	std::mutex outside_mutex;
+
+	VkCommandBuffer next_buffer(ThreadPool &pool);
+};
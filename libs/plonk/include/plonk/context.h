@@ -1,6 +1,14 @@
 #pragma once
 
+#include "device_selection.h"
+#include "dispatch.h"
+#include "frame_arena.h"
+#include "resource_registry.h"
+#include "startup.h"
+#include "submit_scheduler.h"
 #include "window.h"
+#include <array>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string>
@@ -13,12 +21,44 @@ class Context;
 
 using ContextPtr = std::shared_ptr<Context>;
 
+/**
+ * Development enables the validation layer and debug-only features such as pipeline statistics. Production skips
+ * them for faster startup and frames.
+ */
+enum class ContextProfile {
+	DEVELOPMENT,
+	PRODUCTION,
+};
+
+/**
+ * A single colour attachment to render into. The render pass and framebuffer are only used when dynamic rendering
+ * isn't, and either way the image starts undefined and is left in `final_layout`.
+ */
+struct RenderTarget {
+	VkImage image = VK_NULL_HANDLE;
+	VkImageView view = VK_NULL_HANDLE;
+	VkExtent2D extent{0, 0};
+	VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	VkClearValue clear_value{};
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+};
+
 class Context : public std::enable_shared_from_this<Context> {
 public:
-	VkDevice device;
+	static const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+	VkDevice device = VK_NULL_HANDLE;
+	// Use for anything called every frame
+	DeviceDispatch vk;
 	VkQueue graphics_queue;
 	VkQueue present_queue;
+	// The graphics queue again when the device has no dedicated queue family for the work
+	VkQueue compute_queue = VK_NULL_HANDLE;
+	VkQueue transfer_queue = VK_NULL_HANDLE;
 	// FIXME make private
+	// Command buffer for the frame currently being recorded
 	VkCommandBuffer command_buffer = VK_NULL_HANDLE;
 
 	~Context();
@@ -28,8 +68,19 @@ public:
 	ContextPtr as_shared_ptr() {
 		return shared_from_this();
 	}
-	void attach_window(std::shared_ptr<Window> window);
-	VkShaderModule load_shader(const std::string &filename);
+	void prefer_device(const std::string &name_or_index) { device_preference = name_or_index; };
+	void set_profile(ContextProfile profile) { profile_override = profile; };
+	ContextProfile get_profile();
+	void attach_window(std::shared_ptr<Window> window, std::shared_ptr<JobSystem> jobs = nullptr);
+	void init_headless(uint32_t width, uint32_t height);
+	StartupTasks &get_startup();
+	StartupTimer &get_startup_timer() { return startup_timer; };
+	void finish_startup();
+	bool is_headless() { return headless; };
+	bool uses_dynamic_rendering() { return dynamic_rendering; };
+	VkShaderModule load_shader(const std::string &name);
+	void set_shader_dir(const std::string &dir) { shader_dir = dir; };
+	VkShaderModule create_shader_module(const uint32_t *code, size_t size);
 	void destroy_shader(VkShaderModule shader);
 	float width() { return extent.width; };
 	float height() { return extent.height; };
@@ -38,17 +89,65 @@ public:
 	void update_swapchain();
 	bool needs_resize();
 	uint32_t swapchain_image_count() { return swapchain_images.size(); };
+	VkImageLayout output_layout() { return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; };
+	// Whether output images can be copied from, which not every surface allows for its swapchain
+	bool output_readable() { return headless || swapchain_readable; };
+	uint64_t frames_submitted() { return submitted_frames; };
+	uint64_t frames_completed();
+	void wait_idle();
 	Frame aquire_frame();
 	VkSwapchainKHR get_swapchain() { return swapchain; };
 	VkImage get_swapchain_image(int index) { return swapchain_images[index]; };
 	VkImageView get_swapchain_image_view(int index) { return swapchain_image_views[index]; };
+	VkRenderPass get_render_pass() { return render_pass; };
+	VkFramebuffer get_framebuffer(FrameIndex index) { return framebuffers.empty() ? VK_NULL_HANDLE : framebuffers[index]; };
+	RenderTarget get_output_target(FrameIndex index);
+	uint32_t frame_slot() { return current_slot; };
+	// Arena for the frame currently being recorded
+	FrameArena &get_frame_arena() { return frame_arenas[current_slot]; };
+	FrameArenaStats get_frame_arena_stats();
 	std::optional<uint32_t> get_graphics_queue_family_index() { return graphics_queue_family_index; };
 	std::optional<uint32_t> get_present_queue_family_index() { return present_queue_family_index; };
+	std::optional<uint32_t> get_compute_queue_family_index() { return compute_queue_family_index; };
+	std::optional<uint32_t> get_transfer_queue_family_index() { return transfer_queue_family_index; };
+	bool has_async_compute() { return compute_queue != graphics_queue; };
+	bool has_async_transfer() { return transfer_queue != graphics_queue && transfer_queue != compute_queue; };
 	void submit(VkCommandBuffer &command_buffer);
+	SubmitScheduler &get_scheduler() { return *scheduler; };
+	ResourceRegistry &get_resources() { return *resources; };
+	QueueLane get_graphics_lane() { return graphics_lane; };
+	QueueLane get_compute_lane() { return compute_lane; };
+	QueueLane get_transfer_lane() { return transfer_lane; };
+	void wait_before_frame(TimelinePoint point, VkPipelineStageFlags2 stages);
+	TimelinePoint last_frame_point() { return last_frame; };
 	void present();
-	void begin_render_pass(FrameIndex index);
+	void begin_render_pass(FrameIndex index, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+	void end_render_pass(FrameIndex index);
+	void begin_rendering(
+		VkCommandBuffer command_buffer, const RenderTarget &target,
+		VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE
+	);
+	void end_rendering(VkCommandBuffer command_buffer, const RenderTarget &target);
 	void present_frame(Frame &frame);
-	VkPipeline create_graphics_pipeline(VkGraphicsPipelineCreateInfo *pipeline_info);
+	VkPipeline create_graphics_pipeline(
+		VkGraphicsPipelineCreateInfo *pipeline_info, VkFormat color_format = VK_FORMAT_UNDEFINED
+	);
+	VkPipeline create_compute_pipeline(VkShaderModule shader, VkPipelineLayout layout);
+	VkPipeline create_fullscreen_pipeline(
+		VkShaderModule vert_shader, VkShaderModule frag_shader, VkPipelineLayout layout,
+		VkRenderPass pass = VK_NULL_HANDLE, VkFormat color_format = VK_FORMAT_UNDEFINED
+	);
+	uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties);
+	VkFormatFeatureFlags optimal_format_features(VkFormat format);
+	void create_buffer(
+		VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer,
+		VkDeviceMemory &memory
+	);
+	void immediate_submit(std::function<void(VkCommandBuffer)> callback);
+	float timestamp_period();
+	uint32_t timestamp_valid_bits();
+	VkPhysicalDeviceFeatures get_enabled_features() { return enabled_features; };
+	const DeviceInfo &get_device_info() { return device_info; };
 	void bind_pipeline(VkPipeline &pipeline);
 
 	// Prevent copies
@@ -63,31 +162,74 @@ private:
 	Context();
 	VkInstance instance = VK_NULL_HANDLE;
 	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	// Device to use instead of the best scoring one; PLONK_DEVICE sets it too, but this wins
+	std::string device_preference;
+	// PLONK_MODE=production sets it too, but this wins
+	std::optional<ContextProfile> profile_override;
+	DeviceInfo device_info;
+	StartupTimer startup_timer;
+	// Work still running from attach_window, until finish_startup
+	std::unique_ptr<StartupTasks> startup;
+	// Load shaders from here rather than the embedded copies; PLONK_SHADER_DIR sets it too, but this wins
+	std::string shader_dir;
 	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	bool headless = false;
+	bool dynamic_rendering = false;
 	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+	bool swapchain_readable = false;
+	VkPhysicalDeviceFeatures enabled_features{};
 	VkSurfaceFormatKHR surface_format;
 	VkExtent2D extent;
 	std::shared_ptr<Window> window = nullptr;
-	VkSemaphore image_available_semaphore = VK_NULL_HANDLE;
-	VkSemaphore render_finished_semaphore = VK_NULL_HANDLE;
-	VkFence in_flight_fence = VK_NULL_HANDLE;
+	std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> command_buffers{};
+	std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> image_available_semaphores{};
+	// One per swapchain image rather than per slot, as the present waiting on it may still be pending when its slot
+	// comes round again
+	std::vector<VkSemaphore> render_finished_semaphores;
+	std::unique_ptr<SubmitScheduler> scheduler;
+	std::unique_ptr<ResourceRegistry> resources;
+	QueueLane graphics_lane = 0;
+	QueueLane compute_lane = 0;
+	QueueLane transfer_lane = 0;
+	// Graphics timeline point of the frame last submitted from each slot, and work the next frame must wait for
+	std::array<TimelinePoint, MAX_FRAMES_IN_FLIGHT> slot_points{};
+	std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> slot_frames{};
+	// Transient CPU data for each slot's frame, reset once the slot's frame has finished
+	std::array<FrameArena, MAX_FRAMES_IN_FLIGHT> frame_arenas;
+	TimelinePoint last_frame;
+	std::vector<std::pair<TimelinePoint, VkPipelineStageFlags2>> frame_waits;
+	uint64_t submitted_frames = 0;
+	uint64_t completed_frames = 0;
+	uint32_t current_slot = 0;
+	FrameIndex current_image = 0;
+	// Acquire or present reported the swapchain no longer matches the surface
+	bool swapchain_stale = false;
+	uint32_t next_offscreen_image = 0;
 	VkRenderPass render_pass = VK_NULL_HANDLE;
 	std::optional<uint32_t> graphics_queue_family_index;
 	std::optional<uint32_t> present_queue_family_index;
+	std::optional<uint32_t> compute_queue_family_index;
+	std::optional<uint32_t> transfer_queue_family_index;
 	std::vector<VkImage> swapchain_images;
 	std::vector<VkImageView> swapchain_image_views;
+	std::vector<VkDeviceMemory> offscreen_memory;
 	std::vector<VkFramebuffer> framebuffers;
 	VkCommandPool command_pool = VK_NULL_HANDLE;
 
 	void init_vulkan();
 	void rebuild_swapchain();
+	void create_present_semaphores();
 	void resize_swapchain(uint32_t width, uint32_t height);
+	void create_swapchain();
 	void rebuild_image_views();
+	void create_offscreen_images();
 	void create_sync_objects();
 	auto find_graphics_queue() -> std::optional<uint32_t>;
 	auto find_present_queue() -> std::optional<uint32_t>;
+	auto find_queue_family(VkQueueFlags wanted, VkQueueFlags unwanted) -> std::optional<uint32_t>;
 	void rebuild_framebuffers();
 	void create_render_pass();
 	void create_command_pool();
 	VkCommandBuffer create_command_buffer();
+	void create_command_buffers();
 };
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+/**
+ * What a physical device offers, as far as choosing between devices is concerned
+ */
+struct DeviceInfo {
+	std::string name;
+	VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+	uint32_t api_version = 0;
+	VkDeviceSize device_local_memory = 0;
+	bool graphics_queue = false;
+	// Some family can present to the window's surface, always true without one
+	bool present_queue = true;
+	bool dedicated_compute_queue = false;
+	bool dedicated_transfer_queue = false;
+	bool synchronization2 = false;
+	bool timeline_semaphore = false;
+	bool dynamic_rendering = false;
+
+	// Limits that matter for performance, only logged
+	uint32_t max_push_constants_size = 0;
+	uint32_t subgroup_size = 0;
+	float timestamp_period = 0.0;
+	uint32_t max_compute_workgroup_invocations = 0;
+	uint32_t max_image_dimension_2d = 0;
+};
+
+DeviceInfo probe_device(VkPhysicalDevice device, VkSurfaceKHR surface = VK_NULL_HANDLE);
+int64_t score_device(const DeviceInfo &info);
+std::optional<size_t> select_device(const std::vector<DeviceInfo> &devices, const std::string &preference = "");
+void log_device(const DeviceInfo &info);
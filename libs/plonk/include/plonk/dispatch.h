@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+// Device functions called while recording and submitting frames, loaded straight from the driver
+#define PLONK_DEVICE_FUNCTIONS(X) \
+	X(BeginCommandBuffer) \
+	X(EndCommandBuffer) \
+	X(ResetCommandBuffer) \
+	X(ResetCommandPool) \
+	X(CmdBeginRenderPass) \
+	X(CmdEndRenderPass) \
+	X(CmdBeginRendering) \
+	X(CmdEndRendering) \
+	X(CmdExecuteCommands) \
+	X(CmdBindPipeline) \
+	X(CmdBindDescriptorSets) \
+	X(CmdPushConstants) \
+	X(CmdSetViewport) \
+	X(CmdSetScissor) \
+	X(CmdDraw) \
+	X(CmdDispatch) \
+	X(CmdPipelineBarrier) \
+	X(CmdPipelineBarrier2) \
+	X(CmdFillBuffer) \
+	X(CmdCopyBuffer) \
+	X(CmdCopyImageToBuffer) \
+	X(CmdCopyBufferToImage) \
+	X(CmdResetQueryPool) \
+	X(CmdWriteTimestamp) \
+	X(CmdBeginQuery) \
+	X(CmdEndQuery) \
+	X(GetQueryPoolResults) \
+	X(QueueSubmit2) \
+	X(WaitSemaphores) \
+	X(GetSemaphoreCounterValue)
+
+// Only loaded when the device was created with VK_KHR_swapchain
+#define PLONK_SWAPCHAIN_FUNCTIONS(X) \
+	X(AcquireNextImageKHR) \
+	X(QueuePresentKHR)
+
+/**
+ * Function pointers for one device, so hot paths skip the loader's trampoline, which looks up the device's dispatch
+ * table on every call. Called as `ctx->vk.CmdDraw(...)`.
+ */
+struct DeviceDispatch {
+#define PLONK_DISPATCH_MEMBER(name) PFN_vk##name name = nullptr;
+	PLONK_DEVICE_FUNCTIONS(PLONK_DISPATCH_MEMBER)
+	PLONK_SWAPCHAIN_FUNCTIONS(PLONK_DISPATCH_MEMBER)
+#undef PLONK_DISPATCH_MEMBER
+
+	static DeviceDispatch load(VkInstance instance, VkDevice device, bool swapchain);
+	static DeviceDispatch loader();
+};
@@ -1,21 +1,31 @@
 #pragma once
 
 #include "context.h"
-#include <chrono>
+#include "frame_arena.h"
 
 typedef uint32_t FrameIndex;
 
+/**
+ * The frame being recorded, from `Context::aquire_frame` until it's presented. A plain handle that's cheap to copy;
+ * it must not outlive the context or be used after `present`.
+ */
 class Frame {
 public:
+	void begin_render_pass(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+	void end_render_pass();
 	void present();
-	~Frame();
+	FrameIndex get_index() { return index; };
+	uint32_t get_slot() { return slot; };
+	// Reset once this frame's slot comes round again and the GPU has finished with it
+	FrameArena &get_arena() { return *arena; };
 
 private:
-	friend Context;
 	friend class Context;
 
-	ContextPtr ctx;
+	Context *ctx;
 	FrameIndex index;
+	uint32_t slot;
+	FrameArena *arena;
 
-	Frame(ContextPtr ctx, FrameIndex index);
+	Frame(Context *ctx, FrameIndex index, uint32_t slot, FrameArena *arena);
 };
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct FrameArenaStats {
+	// Most bytes any one frame has used
+	size_t peak_bytes = 0;
+	size_t capacity = 0;
+	// Extra blocks taken from the heap because a frame outgrew the arena, over every frame so far. Only counts the
+	// arena's own allocations, not those of containers and callbacks that don't use it.
+	uint64_t overflow_blocks = 0;
+	uint64_t frames = 0;
+};
+
+/**
+ * Linear allocator for CPU data that only lives for one frame, e.g. command lists and barrier arrays.
+ *
+ * Allocating bumps a pointer through the current block and `reset` releases everything at once, so nothing is freed
+ * individually and destructors never run: only trivially destructible types can be made in it. A frame that needs
+ * more than the arena holds gets another block from the heap; the next reset swaps the blocks for a single one big
+ * enough for the whole frame, so once frames stop growing the arena makes no heap allocations.
+ *
+ * Not thread safe. Allocate on the thread recording the frame; workers may fill in what it hands them.
+ */
+class FrameArena {
+public:
+	static const size_t DEFAULT_CAPACITY = 64 * 1024;
+
+	FrameArena(size_t capacity = DEFAULT_CAPACITY);
+	void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	void reset();
+	size_t bytes_used() { return used; };
+	uint32_t overflow_blocks() { return frame_overflow_blocks; };
+	FrameArenaStats get_stats();
+
+	template <typename T, typename... Args>
+	T *make(Args &&...args) {
+		static_assert(std::is_trivially_destructible_v<T>, "Frame arena objects are never destroyed");
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	// `count` value initialised elements
+	template <typename T>
+	T *make_array(size_t count) {
+		static_assert(std::is_trivially_destructible_v<T>, "Frame arena objects are never destroyed");
+		return new (allocate(sizeof(T) * count, alignof(T))) T[count]();
+	}
+
+	// Prevent copies, allocations point into the blocks
+	FrameArena(const FrameArena &) = delete;
+	FrameArena &operator=(const FrameArena &) = delete;
+
+private:
+	struct Block {
+		std::unique_ptr<std::byte[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> blocks;
+	size_t offset = 0;
+	size_t used = 0;
+	uint32_t frame_overflow_blocks = 0;
+	FrameArenaStats stats;
+
+	void add_block(size_t size);
+};
+
+/**
+ * Lets standard containers allocate from a frame arena. Freeing does nothing, so reserve up front where possible
+ * rather than letting a container grow through several buffers.
+ */
+template <typename T>
+struct ArenaAllocator {
+	using value_type = T;
+
+	FrameArena *arena;
+
+	ArenaAllocator(FrameArena &arena) : arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+	T *allocate(size_t count) { return static_cast<T *>(arena->allocate(sizeof(T) * count, alignof(T))); }
+	void deallocate(T *, size_t) {}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U> &other) const {
+		return arena == other.arena;
+	}
+};
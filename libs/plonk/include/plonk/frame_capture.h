@@ -0,0 +1,85 @@
+#pragma once
+
+#include "context.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class CaptureFormat {
+	PNG,
+	RAW,
+};
+
+/**
+ * Records rendered frames to an image sequence without stalling the GPU.
+ *
+ * Each captured frame is copied into one of `RING_SIZE` host-visible readback buffers. The buffer is only mapped once
+ * the frame that filled it is `LATENCY` frames old, and is then handed to a pool of worker threads that convert and
+ * write it to disk. If the workers fall behind, `record` drops frames when `drop_when_busy` is set, or otherwise waits
+ * for a free buffer so no frame of an offline render is lost.
+ */
+class FrameCapture {
+public:
+	static const uint32_t RING_SIZE = 6;
+	static const uint32_t LATENCY = 2;
+
+	bool drop_when_busy = false;
+
+	FrameCapture(ContextPtr ctx, const std::string &directory, CaptureFormat format, uint32_t worker_count = 2);
+	~FrameCapture();
+	void begin_frame();
+	void record(VkCommandBuffer command_buffer, VkImage image, VkImageLayout layout, VkExtent2D extent, VkFormat format);
+	void flush();
+	uint64_t frames_written();
+	uint64_t frames_dropped() { return dropped.load(std::memory_order_relaxed); };
+
+	// Prevent copies
+	FrameCapture(const FrameCapture &) = delete;
+	FrameCapture &operator=(const FrameCapture &) = delete;
+
+private:
+	enum class SlotState {
+		FREE,
+		RECORDED,
+		ENCODING,
+	};
+
+	struct Slot {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize capacity = 0;
+		uint8_t *mapped = nullptr;
+		SlotState state = SlotState::FREE;
+		uint64_t recorded_frame = 0;
+		uint64_t sequence = 0;
+		VkExtent2D extent{0, 0};
+		VkFormat format = VK_FORMAT_UNDEFINED;
+	};
+
+	ContextPtr ctx;
+	std::string directory;
+	CaptureFormat format;
+	uint64_t frame = 0;
+	uint64_t sequence = 0;
+	// Read without the lock, e.g. from a UI thread while frames are recorded
+	std::atomic<uint64_t> dropped = 0;
+	uint64_t written = 0;
+	bool stopping = false;
+	std::array<Slot, RING_SIZE> slots;
+	std::deque<uint32_t> queue;
+	std::mutex mutex;
+	std::condition_variable queue_ready;
+	std::condition_variable slot_freed;
+	std::vector<std::thread> workers;
+
+	void collect(bool all);
+	void allocate(Slot &slot, VkDeviceSize size);
+	void release(Slot &slot);
+	void run_worker();
+	void encode(Slot &slot);
+};
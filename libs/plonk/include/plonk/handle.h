@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * A 32 bit reference to a value in a SlotArray: the low 20 bits index its slot and the high 12 are the slot's
+ * generation when the value was added. Removing a value bumps its slot's generation, so every handle to it goes stale
+ * instead of silently pointing at whatever reuses the slot. After 4096 reuses of one slot a generation comes round
+ * again, which is far more than anything holds on to a handle for.
+ *
+ * `Tag` only keeps handles to different kinds of value from being mixed up. The default handle is never valid.
+ */
+template <typename Tag>
+struct Handle {
+	static const uint32_t INDEX_BITS = 20;
+	static const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+	static const uint32_t MAX_GENERATION = (1u << (32 - INDEX_BITS)) - 1;
+
+	uint32_t value = 0;
+
+	uint32_t index() const { return value & INDEX_MASK; };
+	uint32_t generation() const { return value >> INDEX_BITS; };
+	explicit operator bool() const { return value != 0; };
+	bool operator==(const Handle &other) const = default;
+
+	static Handle make(uint32_t index, uint32_t generation) { return {(generation << INDEX_BITS) | index}; };
+};
+
+/**
+ * Values kept packed in one array, looked up in O(1) through generational handles.
+ *
+ * Removing swaps the last value into the gap, so iterating touches only live values with no holes, and handles stay
+ * valid as the values move. Not thread safe.
+ */
+template <typename T, typename Tag = T>
+class SlotArray {
+public:
+	using HandleType = Handle<Tag>;
+
+	HandleType insert(T value) {
+		uint32_t index;
+		if (free_slots.empty()) {
+			if (slots.size() > HandleType::INDEX_MASK) {
+				throw std::runtime_error("Slot array is full");
+			}
+			index = slots.size();
+			slots.push_back({0, 1});
+		}
+		else {
+			index = free_slots.back();
+			free_slots.pop_back();
+		}
+		slots[index].dense = values.size();
+		values.push_back(std::move(value));
+		owners.push_back(index);
+		return HandleType::make(index, slots[index].generation);
+	}
+
+	// nullptr once the handle is stale
+	T *get(HandleType handle) {
+		if (!contains(handle)) {
+			return nullptr;
+		}
+		return &values[slots[handle.index()].dense];
+	}
+
+	bool contains(HandleType handle) const {
+		return handle.index() < slots.size() && slots[handle.index()].generation == handle.generation();
+	}
+
+	std::optional<T> remove(HandleType handle) {
+		if (!contains(handle)) {
+			return std::nullopt;
+		}
+		auto &slot = slots[handle.index()];
+		std::optional<T> removed = std::move(values[slot.dense]);
+		if (slot.dense != values.size() - 1) {
+			values[slot.dense] = std::move(values.back());
+			owners[slot.dense] = owners.back();
+			slots[owners[slot.dense]].dense = slot.dense;
+		}
+		values.pop_back();
+		owners.pop_back();
+		release(handle.index());
+		return removed;
+	}
+
+	// Invalidate every handle, keeping the memory for reuse
+	void clear() {
+		for (auto index : owners) {
+			release(index);
+		}
+		values.clear();
+		owners.clear();
+	}
+
+	size_t size() const { return values.size(); };
+	bool empty() const { return values.empty(); };
+	auto begin() { return values.begin(); };
+	auto end() { return values.end(); };
+
+private:
+	struct Slot {
+		uint32_t dense;
+		uint32_t generation;
+	};
+
+	std::vector<T> values;
+	// Slot each value belongs to, to fix up its slot when the value moves
+	std::vector<uint32_t> owners;
+	std::vector<Slot> slots;
+	std::vector<uint32_t> free_slots;
+
+	void release(uint32_t index) {
+		auto &generation = slots[index].generation;
+		// Skip 0, so the default handle never comes back to life
+		generation = generation == HandleType::MAX_GENERATION ? 1 : generation + 1;
+		free_slots.push_back(index);
+	}
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * 8-bit RGBA image in CPU memory, rows top to bottom
+ */
+class Image {
+public:
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+
+	Image() {}
+	Image(uint32_t width, uint32_t height);
+
+	uint8_t *row(uint32_t y) { return pixels.data() + (size_t)y * width * 4; };
+	void save(const std::string &filename) const;
+	void save_png(const std::string &filename) const;
+	void save_raw(const std::string &filename) const;
+
+	static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0);
+	static uint32_t adler32(const uint8_t *data, size_t size, uint32_t adler = 1);
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Counts outstanding jobs, so work can wait for (or depend on) a group of jobs finishing
+ */
+class JobCounter {
+public:
+	bool done() const { return pending.load(std::memory_order_acquire) == 0; };
+
+private:
+	friend class JobSystem;
+	std::atomic<int> pending{0};
+};
+
+/**
+ * Work-stealing job scheduler.
+ *
+ * Each thread has its own deque. Jobs are pushed to and popped from the back of the calling thread's deque, so related
+ * work stays on a warm cache, and idle threads steal the oldest jobs from the front of another thread's deque. The
+ * thread that creates the JobSystem is thread 0 and only runs jobs while it waits on a counter, which keeps it free
+ * for GLFW and presentation. Jobs that must run on it (such as GLFW calls) go through `run_on_main` and are executed
+ * by `pump_main`.
+ *
+ * Jobs must not throw.
+ */
+class JobSystem {
+public:
+	JobSystem(uint32_t thread_count = 0);
+	~JobSystem();
+	void run(std::function<void()> job, JobCounter *counter = nullptr);
+	void run_on_main(std::function<void()> job, JobCounter *counter = nullptr);
+	void wait(JobCounter &counter);
+	void parallel_for(size_t begin, size_t end, size_t grain, std::function<void(size_t, size_t)> fn);
+	uint32_t pump_main();
+	uint32_t thread_count() { return queues.size(); };
+	uint32_t thread_index() { return current_index(); };
+	bool is_main_thread() { return std::this_thread::get_id() == main_thread; };
+	// False for threads outside the system, which all share `thread_index` 0 with the main thread
+	bool owns_current_thread();
+
+	// Prevent copies
+	JobSystem(const JobSystem &) = delete;
+	JobSystem &operator=(const JobSystem &) = delete;
+
+private:
+	struct Job {
+		std::function<void()> fn;
+		JobCounter *counter;
+	};
+
+	struct alignas(64) JobQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<JobQueue>> queues;
+	JobQueue main_queue;
+	std::vector<std::thread> workers;
+	std::thread::id main_thread;
+	std::atomic<int> queued{0};
+	std::atomic<int> sleeping{0};
+	std::atomic<bool> stopping{false};
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+
+	uint32_t current_index();
+	bool try_run_one(uint32_t index);
+	bool pop(JobQueue &queue, Job &job, bool back);
+	void execute(Job &job);
+	void run_worker(uint32_t index);
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <tuple>
+#include <type_traits>
+
+/**
+ * Levelled logging that never blocks the calling thread on stdout.
+ *
+ * `LOG_INFO("Created %d images", count)` copies the format string's pointer and the arguments into the calling
+ * thread's ring; a background writer formats and prints them in time order. Strings are copied (and truncated to
+ * `LogString::CAPACITY`), so they needn't outlive the call; as with printf, pass `c_str()` for std::strings. If a
+ * thread's ring is full the message is dropped and counted, rather than waiting.
+ *
+ * Messages below PLONK_LOG_LEVEL compile to nothing; the rest are filtered again at runtime by `Log::set_level`, or
+ * PLONK_LOG=debug|info|warning|error.
+ */
+#define PLONK_LOG_LEVEL_DEBUG 0
+#define PLONK_LOG_LEVEL_INFO 1
+#define PLONK_LOG_LEVEL_WARNING 2
+#define PLONK_LOG_LEVEL_ERROR 3
+#define PLONK_LOG_LEVEL_OFF 4
+
+#ifndef PLONK_LOG_LEVEL
+#define PLONK_LOG_LEVEL PLONK_LOG_LEVEL_DEBUG
+#endif
+
+enum class LogLevel : uint8_t {
+	DEBUG = PLONK_LOG_LEVEL_DEBUG,
+	INFO = PLONK_LOG_LEVEL_INFO,
+	WARNING = PLONK_LOG_LEVEL_WARNING,
+	ERROR = PLONK_LOG_LEVEL_ERROR,
+};
+
+// The dead printf lets the compiler check the format against the arguments
+#define PLONK_LOG(level, ...) \
+	do { \
+		if constexpr ((int)(level) >= PLONK_LOG_LEVEL) { \
+			if (false) { \
+				std::printf(__VA_ARGS__); \
+			} \
+			Log::write(level, __VA_ARGS__); \
+		} \
+	} while (0)
+#define LOG_DEBUG(...) PLONK_LOG(LogLevel::DEBUG, __VA_ARGS__)
+#define LOG_INFO(...) PLONK_LOG(LogLevel::INFO, __VA_ARGS__)
+#define LOG_WARNING(...) PLONK_LOG(LogLevel::WARNING, __VA_ARGS__)
+#define LOG_ERROR(...) PLONK_LOG(LogLevel::ERROR, __VA_ARGS__)
+
+// A string argument copied into the record, as the original may be gone by the time it's formatted
+struct LogString {
+	static const size_t CAPACITY = 96;
+	char text[CAPACITY];
+
+	LogString(const char *source) {
+		source = source ? source : "(null)";
+		auto length = std::min(std::strlen(source), CAPACITY - 1);
+		std::memcpy(text, source, length);
+		text[length] = '\0';
+	}
+};
+
+template <typename T>
+struct LogArg {
+	using Stored = std::decay_t<T>;
+};
+template <>
+struct LogArg<const char *> {
+	using Stored = LogString;
+};
+template <>
+struct LogArg<char *> {
+	using Stored = LogString;
+};
+
+template <typename T>
+inline const T &log_unwrap(const T &value) {
+	return value;
+}
+inline const char *log_unwrap(const LogString &value) {
+	return value.text;
+}
+
+struct LogRecord {
+	static const size_t PAYLOAD_SIZE = 224;
+	using Formatter = int (*)(const LogRecord &record, char *out, size_t size);
+
+	uint64_t time_ns;
+	const char *format;
+	Formatter formatter;
+	LogLevel level;
+	alignas(16) unsigned char payload[PAYLOAD_SIZE];
+};
+
+class Log {
+public:
+	template <typename... Args>
+	static void write(LogLevel level, const char *format, const Args &...args) {
+		using Stored = std::tuple<typename LogArg<std::decay_t<Args>>::Stored...>;
+		static_assert(sizeof(Stored) <= LogRecord::PAYLOAD_SIZE, "Too many log arguments to fit in a record");
+		static_assert(std::is_trivially_destructible_v<Stored>, "Log arguments must be plain values or strings");
+		if (level < get_level()) {
+			return;
+		}
+		auto record = begin_record();
+		if (!record) {
+			return;
+		}
+		record->level = level;
+		record->format = format;
+		record->formatter = &format_record<Stored>;
+		new (record->payload) Stored(args...);
+		commit_record();
+	}
+
+	static void set_level(LogLevel level);
+	static LogLevel get_level();
+	static void flush();
+
+private:
+	static LogRecord *begin_record();
+	static void commit_record();
+
+	template <typename Stored>
+	static int format_record(const LogRecord &record, char *out, size_t size) {
+		if constexpr (std::tuple_size_v<Stored> == 0) {
+			return std::snprintf(out, size, "%s", record.format);
+		}
+		else {
+			auto &args = *std::launder(reinterpret_cast<const Stored *>(record.payload));
+			return std::apply(
+				[&](const auto &...arg) { return std::snprintf(out, size, record.format, log_unwrap(arg)...); }, args
+			);
+		}
+	}
+};
@@ -2,6 +2,11 @@
 
 #include "context.h"
 #include "event.h"
+#include "job_system.h"
 #include "renderer.h"
+#include "scene_sdf.h"
+#include "software_renderer.h"
 #include "window.h"
 #include "camera.h"
+#include "camera_path.h"
+#include "trace.h"
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "context.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct PipelineStatistics {
+	uint64_t vertex_invocations = 0;
+	uint64_t fragment_invocations = 0;
+	uint64_t compute_invocations = 0;
+};
+
+struct ScopeStats {
+	std::string name;
+	double min_ms = 0.0;
+	double avg_ms = 0.0;
+	double max_ms = 0.0;
+	uint64_t samples = 0;
+	PipelineStatistics statistics;
+};
+
+/**
+ * Measures GPU time of named scopes within a frame's command buffer.
+ *
+ * Each frame slot owns its own timestamp and pipeline statistics query pools. Results are read back when the slot
+ * comes around again, `FRAME_COUNT` frames later, so the CPU never waits on the GPU for them.
+ */
+class Profiler {
+public:
+	static const uint32_t FRAME_COUNT = 3;
+	static const uint32_t MAX_SCOPES = 32;
+	static const uint32_t WINDOW = 120;
+	// Collected by outermost scopes, which secondary command buffers executed within them must inherit
+	static const VkQueryPipelineStatisticFlags STATISTICS = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+	Profiler(ContextPtr ctx);
+	~Profiler();
+	void begin_frame(VkCommandBuffer command_buffer);
+	void begin_scope(VkCommandBuffer command_buffer, const std::string &name);
+	void end_scope(VkCommandBuffer command_buffer);
+	std::vector<ScopeStats> get_stats();
+	void write_csv(const std::string &filename);
+	void write_json(const std::string &filename);
+	void dump(const std::string &filename);
+
+	// Prevent copies
+	Profiler(const Profiler &) = delete;
+	Profiler &operator=(const Profiler &) = delete;
+
+private:
+	struct Scope {
+		std::string name;
+		uint32_t depth;
+		int32_t statistics_query;
+	};
+
+	struct FrameSlot {
+		VkQueryPool timestamps = VK_NULL_HANDLE;
+		VkQueryPool statistics = VK_NULL_HANDLE;
+		std::vector<Scope> scopes;
+		uint32_t statistics_count = 0;
+		bool pending = false;
+	};
+
+	struct History {
+		std::vector<double> samples;
+		uint32_t next = 0;
+		uint64_t total = 0;
+		PipelineStatistics statistics;
+	};
+
+	ContextPtr ctx;
+	bool enabled = true;
+	bool statistics_enabled = false;
+	double ms_per_tick = 0.0;
+	// Trace clock time of GPU tick zero, so GPU scopes line up with CPU trace events
+	double gpu_epoch_ns = 0.0;
+	uint64_t timestamp_mask = ~0ull;
+	uint64_t frame = 0;
+	FrameSlot slots[FRAME_COUNT];
+	std::vector<uint32_t> open_scopes;
+	std::vector<std::string> scope_order;
+	std::unordered_map<std::string, History> history;
+
+	FrameSlot &current_slot() { return slots[frame % FRAME_COUNT]; };
+	void calibrate();
+	void collect(FrameSlot &slot);
+};
+
+/**
+ * Profiles the lifetime of the object as a named scope
+ */
+class ProfileScope {
+public:
+	ProfileScope(Profiler &profiler, VkCommandBuffer command_buffer, const std::string &name)
+		: profiler(profiler), command_buffer(command_buffer) {
+		profiler.begin_scope(command_buffer, name);
+	}
+	~ProfileScope() { profiler.end_scope(command_buffer); }
+
+private:
+	Profiler &profiler;
+	VkCommandBuffer command_buffer;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "math.h"
+#include <cstdint>
+
+// Matches the push constant block in shaders/scene.glsl
+struct SimplePushConstants {
+	float screen_size[2];
+	float _pad0[2];
+	Point3 position;
+	float _pad1[1];
+	Point3 direction;
+	float time;
+	Point3 prev_position;
+	float history_weight;
+	Point3 prev_direction;
+	uint32_t frame;
+	uint32_t debug_mode;
+};
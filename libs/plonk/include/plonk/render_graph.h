@@ -0,0 +1,176 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+class Context;
+
+typedef uint32_t RenderResource;
+
+/**
+ * Where an image is in the pipeline: its layout and the stages and accesses that last touched it
+ */
+struct ImageState {
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 access = VK_ACCESS_2_NONE;
+};
+
+/**
+ * How a pass uses an image
+ */
+struct ImageAccess {
+	VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 access = VK_ACCESS_2_NONE;
+	// Layout needed while the pass runs, or UNDEFINED if the pass's render pass transitions it on load
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	// Layout the pass leaves the image in (e.g. its render pass's finalLayout), or UNDEFINED if unchanged
+	VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	bool reads() const;
+	bool writes() const;
+
+	static ImageAccess color_attachment(VkImageLayout final_layout);
+	static ImageAccess sampled(VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+	static ImageAccess storage(VkPipelineStageFlags2 stages);
+	static ImageAccess transfer_read(VkImageLayout layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+};
+
+/**
+ * How a pass uses a buffer. Buffers have no layout, so only the stages and accesses are tracked.
+ */
+struct BufferAccess {
+	VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 access = VK_ACCESS_2_NONE;
+
+	static BufferAccess storage_read(VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+	static BufferAccess storage_write(VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+	static BufferAccess storage(VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+};
+
+struct TransientImageDesc {
+	VkFormat format;
+	VkExtent2D extent;
+	VkImageUsageFlags usage;
+
+	bool operator==(const TransientImageDesc &other) const {
+		return format == other.format && extent.width == other.extent.width &&
+			extent.height == other.extent.height && usage == other.usage;
+	};
+};
+
+struct GraphBarrier {
+	RenderResource resource;
+	ImageState src;
+	ImageState dst;
+};
+
+/**
+ * Frame graph of passes and the images and buffers they use.
+ *
+ * Rebuild it every frame: `reset`, import the persistent images and declare transient ones, add passes in submission
+ * order, then `compile` and `execute`. Compiling culls passes whose results are never used, works out the
+ * synchronization2 barriers each pass needs, and places transient images whose lifetimes don't overlap in the same
+ * memory. Transient memory is kept between frames while the set of transient images stays the same.
+ *
+ * Passes that begin their own render pass should declare the layouts it loads from and leaves images in, so the graph
+ * can track them. Without a context the graph only plans, which is how the tests use it.
+ */
+class RenderGraph {
+public:
+	// Called around every executed pass, e.g. to write profiler timestamps
+	std::function<void(VkCommandBuffer, const std::string &)> on_pass_begin;
+	std::function<void(VkCommandBuffer, const std::string &)> on_pass_end;
+
+	RenderGraph(std::shared_ptr<Context> ctx);
+	~RenderGraph();
+	void reset();
+	RenderResource import_image(
+		const std::string &name, VkImage image, ImageState state, bool exported = false,
+		VkImageView view = VK_NULL_HANDLE
+	);
+	RenderResource import_buffer(const std::string &name, VkBuffer buffer, ImageState state, bool exported = false);
+	RenderResource create_image(const std::string &name, TransientImageDesc desc);
+	void add_pass(
+		const std::string &name, std::vector<std::pair<RenderResource, ImageAccess>> images,
+		std::function<void(VkCommandBuffer)> record, bool side_effects = false
+	);
+	void add_pass(
+		const std::string &name, std::vector<std::pair<RenderResource, ImageAccess>> images,
+		std::vector<std::pair<RenderResource, BufferAccess>> buffers, std::function<void(VkCommandBuffer)> record,
+		bool side_effects = false
+	);
+	void compile();
+	void execute(VkCommandBuffer command_buffer);
+
+	VkImage get_image(RenderResource resource) { return resources[resource].image; };
+	VkBuffer get_buffer(RenderResource resource) { return resources[resource].buffer; };
+	VkImageView get_image_view(RenderResource resource) { return resources[resource].view; };
+	ImageState get_final_state(RenderResource resource) { return resources[resource].final_state; };
+	bool is_pass_live(const std::string &name);
+	std::vector<GraphBarrier> get_barriers(const std::string &name);
+	uint32_t get_alias_slot(RenderResource resource) { return resources[resource].alias_slot; };
+	VkDeviceSize transient_memory_size();
+
+	static std::vector<uint32_t> assign_aliases(
+		const std::vector<std::pair<uint32_t, uint32_t>> &lifetimes, const std::vector<VkMemoryRequirements> &requirements,
+		std::vector<VkMemoryRequirements> &slots
+	);
+
+	// Prevent copies
+	RenderGraph(const RenderGraph &) = delete;
+	RenderGraph &operator=(const RenderGraph &) = delete;
+
+private:
+	struct Resource {
+		std::string name;
+		bool transient = false;
+		bool exported = false;
+		bool is_buffer = false;
+		VkImage image = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		TransientImageDesc desc{};
+		ImageState initial_state;
+		ImageState final_state;
+		uint32_t first_pass = UINT32_MAX;
+		uint32_t last_pass = 0;
+		uint32_t alias_slot = UINT32_MAX;
+	};
+
+	struct Pass {
+		std::string name;
+		// Buffers too, as accesses that never change layout
+		std::vector<std::pair<RenderResource, ImageAccess>> images;
+		std::function<void(VkCommandBuffer)> record;
+		bool side_effects = false;
+		bool live = false;
+		std::vector<GraphBarrier> barriers;
+	};
+
+	struct TransientImage {
+		TransientImageDesc desc;
+		std::pair<uint32_t, uint32_t> lifetime;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		uint32_t alias_slot = 0;
+	};
+
+	std::shared_ptr<Context> ctx;
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<TransientImage> transients;
+	std::vector<VkDeviceMemory> slot_memory;
+	std::vector<VkMemoryRequirements> slots;
+	bool compiled = false;
+
+	void cull_passes();
+	void compute_lifetimes();
+	void allocate_transients();
+	void build_barriers();
+	void release_transients();
+};
@@ -1,28 +1,63 @@
 #pragma once
 
 #include "context.h"
+#include "brick_map.h"
 #include "camera.h"
+#include "command_recorder.h"
+#include "frame_capture.h"
+#include "job_system.h"
+#include "profiler.h"
+#include "push_constants.h"
+#include "render_graph.h"
+#include "shader_reloader.h"
+#include "shadow_pass.h"
+#include "step_heatmap.h"
 #include <chrono>
+#include <memory>
 
 class Renderer {
 public:
-	Renderer(ContextPtr ctx);
+	std::unique_ptr<StepHeatmap> step_heatmap;
+	std::unique_ptr<ShadowPass> shadow_pass;
+	std::unique_ptr<Profiler> profiler;
+	std::unique_ptr<FrameCapture> capture;
+	std::unique_ptr<CommandRecorder> recorder;
+	std::unique_ptr<RenderGraph> graph;
+	// The scene's static geometry. Rebake it after an edit and the next frame uploads the bricks that changed.
+	std::unique_ptr<BrickMap> brick_map;
+	std::unique_ptr<BrickMapTextures> brick_textures;
+
+	// Horizontal bands of the screen, each recorded into its own secondary command buffer
+	static const uint32_t SHADING_BANDS = 4;
+
+	Renderer(ContextPtr ctx, std::shared_ptr<JobSystem> jobs = nullptr);
 	~Renderer();
 	void draw(Camera &camera);
+	void draw(Camera &camera, float time);
+	float scene_time() { return last_time; };
+	void start_capture(const std::string &directory, CaptureFormat format = CaptureFormat::PNG);
+	void stop_capture();
+	void watch_shaders(const std::string &source_dir);
 
 private:
 	ContextPtr ctx;
-	VkShaderModule vert_shader;
-	VkShaderModule frag_shader;
-	VkPipeline pipeline;
-	VkPipelineLayout pipeline_layout;
+	std::shared_ptr<JobSystem> jobs;
+	std::unique_ptr<ShaderReloader> reloader;
+	ShaderHandle vert_shader;
+	ShaderHandle frag_shader;
+	PipelineHandle pipeline;
+	PipelineLayoutHandle pipeline_layout;
 	std::chrono::time_point<std::chrono::high_resolution_clock> started_at;
+	float last_time = 0.0;
 
 	void handle_resize();
+	void build_graph(Frame &frame, SimplePushConstants &constants);
 	void create_render_pass();
-	void create_pipeline();
+	void create_pipeline(VkShaderModule vert, VkShaderModule frag);
 	void create_command_pool();
 	void create_command_buffer();
-	void record_commands(Camera &camera);
+	SimplePushConstants build_push_constants(Camera &camera, float time);
+	void record_shading(SimplePushConstants &constants);
+	void record_commands(VkCommandBuffer command_buffer, const SimplePushConstants &constants, VkRect2D scissor);
 	void present();
 };
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "handle.h"
+#include "submit_scheduler.h"
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+using PipelineHandle = Handle<VkPipeline>;
+using PipelineLayoutHandle = Handle<VkPipelineLayout>;
+using ShaderHandle = Handle<VkShaderModule>;
+
+/**
+ * Owns Vulkan objects on behalf of whatever uses them, which keeps generational handles instead of raw Vulkan handles.
+ *
+ * Looking up a stale handle throws rather than handing back a destroyed object. `replace` swaps the object behind a
+ * handle, e.g. a hot reloaded pipeline, so holders pick the new one up on their next lookup; the old object is kept
+ * until the frames that may use it have finished and `collect` runs. Whatever is left is destroyed by `destroy_all`.
+ *
+ * Adding, replacing and removing may happen on several threads at once, e.g. pipelines compiling during startup.
+ * Lookups take no lock, so they may run alongside each other (e.g. from recording workers) but not alongside changes,
+ * which belong between frames on the render thread.
+ */
+class ResourceRegistry {
+public:
+	ResourceRegistry(VkDevice device, SubmitScheduler &scheduler);
+	~ResourceRegistry();
+
+	template <typename T>
+	Handle<T> add(T object) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return pool<T>().objects.insert(object);
+	}
+
+	template <typename T>
+	T get(Handle<T> handle) {
+		auto object = pool<T>().objects.get(handle);
+		if (!object) {
+			throw std::runtime_error("Stale " + std::string(kind_name<T>()) + " handle");
+		}
+		return *object;
+	}
+
+	template <typename T>
+	bool is_valid(Handle<T> handle) {
+		return pool<T>().objects.contains(handle);
+	}
+
+	// Destroy the object once `in_use_until` is reached, or straight away by default. The handle is stale at once.
+	template <typename T>
+	void remove(Handle<T> handle, TimelinePoint in_use_until = {}) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto &kind = pool<T>();
+		auto removed = kind.objects.remove(handle);
+		if (!removed) {
+			return;
+		}
+		if (in_use_until.value == 0) {
+			destroy(removed.value());
+		}
+		else {
+			kind.retired.push_back({removed.value(), in_use_until});
+		}
+	}
+
+	// Point `handle` at `object`, destroying the one it replaces once `in_use_until` is reached
+	template <typename T>
+	void replace(Handle<T> handle, T object, TimelinePoint in_use_until) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto &kind = pool<T>();
+		auto current = kind.objects.get(handle);
+		if (!current) {
+			throw std::runtime_error("Stale " + std::string(kind_name<T>()) + " handle");
+		}
+		kind.retired.push_back({*current, in_use_until});
+		*current = object;
+	}
+
+	void collect();
+	void destroy_all();
+	size_t size();
+
+	// Prevent copies
+	ResourceRegistry(const ResourceRegistry &) = delete;
+	ResourceRegistry &operator=(const ResourceRegistry &) = delete;
+
+private:
+	template <typename T>
+	struct Pool {
+		SlotArray<T> objects;
+		std::vector<std::pair<T, TimelinePoint>> retired;
+	};
+
+	VkDevice device;
+	SubmitScheduler &scheduler;
+	std::mutex mutex;
+	Pool<VkPipeline> pipelines;
+	Pool<VkPipelineLayout> pipeline_layouts;
+	Pool<VkShaderModule> shaders;
+
+	template <typename T>
+	Pool<T> &pool() {
+		if constexpr (std::is_same_v<T, VkPipeline>) {
+			return pipelines;
+		}
+		else if constexpr (std::is_same_v<T, VkPipelineLayout>) {
+			return pipeline_layouts;
+		}
+		else {
+			static_assert(std::is_same_v<T, VkShaderModule>, "Not a kind of object the registry owns");
+			return shaders;
+		}
+	}
+
+	template <typename T>
+	static const char *kind_name() {
+		if constexpr (std::is_same_v<T, VkPipeline>) {
+			return "pipeline";
+		}
+		else if constexpr (std::is_same_v<T, VkPipelineLayout>) {
+			return "pipeline layout";
+		}
+		else {
+			return "shader";
+		}
+	}
+
+	template <typename T>
+	void collect(Pool<T> &kind, bool all);
+	void destroy(VkPipeline pipeline);
+	void destroy(VkPipelineLayout layout);
+	void destroy(VkShaderModule shader);
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <span>
+#include <string>
+#include <vector>
+
+enum class PrimitiveType : uint32_t {
+	SPHERE = 0,
+	BOX = 1,
+};
+
+/**
+ * One SDF primitive, laid out so a storage buffer can read it as std430 without repacking. Primitives are combined in
+ * file order, each smoothly unioned with everything before it over `blend` units, or a hard union when it's 0.
+ */
+struct ScenePrimitive {
+	static const uint32_t NO_TRANSFORM = UINT32_MAX;
+
+	PrimitiveType type;
+	uint32_t material;
+	// Index into the transform section, or NO_TRANSFORM for a primitive at the origin
+	uint32_t transform;
+	float blend;
+	// Sphere: radius in x. Box: half extents in xyz.
+	float size[4];
+};
+static_assert(sizeof(ScenePrimitive) == 32, "ScenePrimitive must keep its std430 layout");
+
+struct SceneMaterial {
+	// rgb, a is unused padding
+	float color[4];
+};
+static_assert(sizeof(SceneMaterial) == 16, "SceneMaterial must keep its std430 layout");
+
+/**
+ * A column major world to local matrix, the inverse of where the primitive is placed, as distances are evaluated in
+ * the primitive's own space
+ */
+struct SceneTransform {
+	float world_to_local[16];
+};
+static_assert(sizeof(SceneTransform) == 64, "SceneTransform must keep its std430 layout");
+
+struct SceneSection {
+	uint64_t offset;
+	uint32_t count;
+	uint32_t stride;
+};
+
+struct SceneFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t file_size;
+	SceneSection primitives;
+	SceneSection materials;
+	SceneSection transforms;
+};
+static_assert(sizeof(SceneFileHeader) == 64);
+
+/**
+ * A scene as plain arrays, built from a text description and written out as a binary scene file.
+ *
+ * Text scenes have one item per line, referring to earlier items by name. Blank lines and lines starting with `#` are
+ * ignored.
+ *
+ *     material  <name> r g b
+ *     transform <name> <parent|-> tx ty tz rx ry rz sx sy sz
+ *     sphere    <material> <transform|-> <blend> radius
+ *     box       <material> <transform|-> <blend> hx hy hz
+ *
+ * Transforms nest as `Transform` does in a TransformHierarchy. Non-uniform scales distort distances, so keep them
+ * uniform.
+ */
+class SceneDescription {
+public:
+	std::vector<ScenePrimitive> primitives;
+	std::vector<SceneMaterial> materials;
+	std::vector<SceneTransform> transforms;
+
+	static SceneDescription load(const std::string &filename);
+	static SceneDescription parse(std::istream &input);
+	void write(const std::string &filename) const;
+};
+
+/**
+ * A binary scene file mapped into memory, read in place without parsing.
+ *
+ * Files are little endian: a `SceneFileHeader`, then the primitive, material and transform sections. Each section
+ * starts on a SECTION_ALIGNMENT boundary, the largest storage buffer offset alignment Vulkan allows, so the whole file
+ * can be copied into one buffer and each section bound as a range of it. Opening only checks the header and that the
+ * sections fit in the file; primitives' material and transform indices are trusted.
+ *
+ * Nothing renders scene files yet: the renderer still marches the scene in shaders/scene.glsl, mirrored on the CPU by
+ * SceneSdf. This is only the format, its loader and the `plonk-scene` converter.
+ */
+class SceneFile {
+public:
+	static constexpr char MAGIC[4] = {'P', 'L', 'S', 'C'};
+	static const uint32_t VERSION = 1;
+	static const uint64_t SECTION_ALIGNMENT = 256;
+
+	SceneFile(const std::string &filename);
+	~SceneFile();
+
+	const SceneFileHeader &get_header() const { return *(const SceneFileHeader *)mapped; };
+	const uint8_t *data() const { return mapped; };
+	size_t size() const { return length; };
+	std::span<const ScenePrimitive> primitives() const { return section<ScenePrimitive>(get_header().primitives); };
+	std::span<const SceneMaterial> materials() const { return section<SceneMaterial>(get_header().materials); };
+	std::span<const SceneTransform> transforms() const { return section<SceneTransform>(get_header().transforms); };
+
+	// Prevent copies
+	SceneFile(const SceneFile &) = delete;
+	SceneFile &operator=(const SceneFile &) = delete;
+
+private:
+	const uint8_t *mapped = nullptr;
+	size_t length = 0;
+
+	template <typename T>
+	std::span<const T> section(const SceneSection &info) const {
+		return {(const T *)(mapped + info.offset), info.count};
+	}
+
+	void validate(const std::string &filename) const;
+};
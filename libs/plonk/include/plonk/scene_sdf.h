@@ -0,0 +1,46 @@
+#pragma once
+
+#include "simd.h"
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+struct DistanceResultV {
+	FloatV d;
+	Vector3V color;
+};
+
+struct RayHit {
+	float distance;
+	Point3 position;
+	Vector3 normal;
+};
+
+/**
+ * CPU version of the scene in shaders/scene.glsl, evaluated `SIMD_LANES` points at a time.
+ * Keep the two in sync, the constants and formulas here mirror the shader line for line. The one difference is the
+ * box, which the shader samples from a BrickMap baked from `static_distances`, so matches to within a voxel.
+ */
+class SceneSdf {
+public:
+	static const int MAX_STEPS = 256;
+	static constexpr float MAX_DIST = 1024.0;
+	static constexpr float SURFACE_DIST = 0.01;
+
+	float time = 0.0;
+
+	DistanceResultV get_distance(const Vector3V &p) const;
+	DistanceResultV ray_march(const Vector3V &ro, const Vector3V &rd, MaskV active, MaskV &steps) const;
+	Vector3V calc_normal(const Vector3V &p) const;
+	FloatV shadow_visibility(const Vector3V &p, const Vector3V &n, MaskV active) const;
+	Vector3V shade(const Vector3V &ro, const Vector3V &rd, MaskV active) const;
+	static Vector3 light_position() { return Vector3(10.0, -15.0, 2.0); };
+
+	float distance(const Point3 &p) const;
+	Vector3 normal(const Point3 &p) const;
+	void distances(const float *x, const float *y, const float *z, float *out, size_t count) const;
+	static void static_distances(const float *x, const float *y, const float *z, float *out, size_t count);
+	static std::pair<Point3, Point3> static_bounds();
+	std::optional<RayHit> raycast(const Point3 &origin, const Vector3 &direction, float max_distance = MAX_DIST) const;
+	Point3 sweep_sphere(const Point3 &from, const Point3 &to, float radius) const;
+};
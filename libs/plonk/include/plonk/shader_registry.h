@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * SPIR-V compiled from shaders/ and embedded in the binary at build time, see libs/plonk/CMakeLists.txt
+ */
+struct EmbeddedShader {
+	const char *name;
+	const uint32_t *code;
+	// In bytes, as VkShaderModuleCreateInfo wants it
+	size_t size;
+};
+
+// Terminated by an entry with a null name
+extern const EmbeddedShader EMBEDDED_SHADERS[];
+
+const EmbeddedShader *find_embedded_shader(const std::string &name);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "context.h"
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Recompiles shaders when their GLSL changes, and swaps the rebuilt pipelines in between frames.
+ *
+ * A background thread watches the source directory with inotify. When a watched shader's source changes, or any
+ * source without a stage extension such as scene.glsl that shaders include, it runs glslc and builds the new pipeline
+ * on that thread. `apply` then swaps it in at the start of a frame, and the old pipeline keeps rendering until then,
+ * so an edit never stalls a frame. A shader that fails to compile just logs glslc's errors and keeps the old pipeline.
+ *
+ * Pipelines are swapped behind their registry handles, so the old ones are destroyed once the frames that may still
+ * use them have finished.
+ */
+class ShaderReloader {
+public:
+	// Build a pipeline from freshly compiled modules, given in the order they were watched. Runs on the watch thread.
+	using PipelineBuilder = std::function<VkPipeline(const std::vector<VkShaderModule> &)>;
+
+	ShaderReloader(ContextPtr ctx, const std::string &source_dir);
+	~ShaderReloader();
+	void watch(std::vector<std::string> shaders, PipelineBuilder build, PipelineHandle pipeline);
+	uint32_t apply();
+
+	// Prevent copies
+	ShaderReloader(const ShaderReloader &) = delete;
+	ShaderReloader &operator=(const ShaderReloader &) = delete;
+
+private:
+	struct Watched {
+		std::vector<std::string> shaders;
+		PipelineBuilder build;
+		PipelineHandle pipeline;
+	};
+
+	ContextPtr ctx;
+	std::string source_dir;
+	std::string glslc;
+	int inotify_fd = -1;
+	int stop_fd = -1;
+	std::thread watcher;
+	std::mutex mutex;
+	std::vector<Watched> watched;
+	std::vector<std::pair<PipelineHandle, VkPipeline>> ready;
+
+	void run_watcher();
+	void rebuild(Watched &entry);
+	std::vector<uint32_t> compile(const std::string &name);
+};
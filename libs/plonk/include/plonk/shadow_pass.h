@@ -0,0 +1,77 @@
+#pragma once
+
+#include "context.h"
+#include "push_constants.h"
+#include "shader_reloader.h"
+#include <array>
+
+/**
+ * Marches shadow rays into a reduced resolution visibility buffer.
+ *
+ * Each texel stores light visibility and the primary ray distance, so the shading pass can upsample it with depth
+ * awareness. With `temporal` enabled, texels are reprojected from the previous frame and only half of them march a
+ * new shadow ray each frame.
+ */
+class ShadowPass {
+public:
+	float scale = 0.5;
+	bool temporal = false;
+	float history_weight = 0.75;
+
+	// With `startup`, the pipeline compiles there and isn't ready until it's been waited on
+	ShadowPass(
+		ContextPtr ctx, VkDescriptorSetLayout step_set_layout, VkDescriptorSetLayout brick_map_set_layout,
+		StartupTasks *startup = nullptr
+	);
+	~ShadowPass();
+	void resize(VkExtent2D target_size);
+	bool needs_resize(VkExtent2D target_size);
+	VkExtent2D size() { return extent; };
+	void record(
+		VkCommandBuffer command_buffer, SimplePushConstants constants, VkDescriptorSet step_set,
+		VkDescriptorSet brick_map_set
+	);
+	VkDescriptorSetLayout get_descriptor_set_layout() { return descriptor_set_layout; };
+	VkDescriptorSet get_visibility_descriptor_set() { return descriptor_sets[current]; };
+	VkImage get_history_image() { return images[current]; };
+	VkImage get_target_image() { return images[(current + 1) % HISTORY_COUNT]; };
+	void watch_shaders(ShaderReloader &reloader);
+
+	// Prevent copies
+	ShadowPass(const ShadowPass &) = delete;
+	ShadowPass &operator=(const ShadowPass &) = delete;
+
+private:
+	static const uint32_t HISTORY_COUNT = 2;
+	static const VkFormat FORMAT = VK_FORMAT_R16G16_SFLOAT;
+
+	ContextPtr ctx;
+	VkExtent2D extent{0, 0};
+	uint32_t current = 0;
+	uint32_t frame = 0;
+	bool history_valid = false;
+	Point3 prev_position;
+	Point3 prev_direction;
+	ShaderHandle vert_shader;
+	ShaderHandle frag_shader;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	PipelineLayoutHandle pipeline_layout;
+	PipelineHandle pipeline;
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+	std::array<VkImage, HISTORY_COUNT> images{};
+	std::array<VkDeviceMemory, HISTORY_COUNT> memory{};
+	std::array<VkImageView, HISTORY_COUNT> image_views{};
+	std::array<VkFramebuffer, HISTORY_COUNT> framebuffers{};
+	std::array<VkDescriptorSet, HISTORY_COUNT> descriptor_sets{};
+
+	void create_render_pass();
+	void create_descriptors();
+	void create_pipeline(
+		VkShaderModule vert, VkShaderModule frag, VkDescriptorSetLayout step_set_layout,
+		VkDescriptorSetLayout brick_map_set_layout
+	);
+	void create_images();
+	void destroy_images();
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "math.h"
+#include <cmath>
+#include <cstdint>
+
+/**
+ * Portable SIMD packets built on GCC/Clang vector extensions.
+ *
+ * The compiler lowers these to AVX, SSE or NEON depending on the target flags, so build with `-march=native` (or
+ * similar) to get full width registers. Comparisons produce a `MaskV` with every bit of a lane set when true.
+ */
+#ifndef PLONK_SIMD_LANES
+#define PLONK_SIMD_LANES 8
+#endif
+
+const int SIMD_LANES = PLONK_SIMD_LANES;
+
+typedef float FloatV __attribute__((vector_size(SIMD_LANES * sizeof(float))));
+typedef int32_t MaskV __attribute__((vector_size(SIMD_LANES * sizeof(int32_t))));
+
+inline FloatV splat(float value) {
+	return FloatV{} + value;
+}
+
+inline MaskV splat_mask(bool value) {
+	return MaskV{} + (value ? -1 : 0);
+}
+
+inline FloatV select(MaskV mask, FloatV a, FloatV b) {
+	return mask ? a : b;
+}
+
+inline MaskV select(MaskV mask, MaskV a, MaskV b) {
+	return mask ? a : b;
+}
+
+inline FloatV min(FloatV a, FloatV b) {
+	return a < b ? a : b;
+}
+
+inline FloatV max(FloatV a, FloatV b) {
+	return a > b ? a : b;
+}
+
+inline FloatV clamp(FloatV v, float lo, float hi) {
+	return min(max(v, splat(lo)), splat(hi));
+}
+
+inline FloatV abs(FloatV v) {
+	return v < 0.0f ? -v : v;
+}
+
+inline FloatV mix(FloatV a, FloatV b, FloatV t) {
+	return a + (b - a) * t;
+}
+
+inline FloatV sqrt(FloatV v) {
+#if defined(__has_builtin) && __has_builtin(__builtin_elementwise_sqrt)
+	return __builtin_elementwise_sqrt(v);
+#elif defined(__AVX__) && PLONK_SIMD_LANES == 8
+	return __builtin_ia32_sqrtps256(v);
+#else
+	// GCC won't vectorise this, but at least avoids the errno handling of std::sqrt
+	FloatV result;
+	for (int i = 0; i < SIMD_LANES; i++) {
+		result[i] = __builtin_sqrtf(v[i]);
+	}
+	return result;
+#endif
+}
+
+inline bool any(MaskV mask) {
+	for (int i = 0; i < SIMD_LANES; i++) {
+		if (mask[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+inline bool all(MaskV mask) {
+	for (int i = 0; i < SIMD_LANES; i++) {
+		if (!mask[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * `SIMD_LANES` 3D vectors in structure of arrays layout
+ */
+struct Vector3V {
+	FloatV x, y, z;
+
+	Vector3V() : x{}, y{}, z{} {}
+	Vector3V(FloatV x, FloatV y, FloatV z) : x(x), y(y), z(z) {}
+	Vector3V(const Vector3 &v) : x(splat(v.coords[0])), y(splat(v.coords[1])), z(splat(v.coords[2])) {}
+	Vector3V(const Point3 &p) : x(splat(p.coords[0])), y(splat(p.coords[1])), z(splat(p.coords[2])) {}
+
+	Vector3V operator+(const Vector3V &o) const { return {x + o.x, y + o.y, z + o.z}; };
+	Vector3V operator-(const Vector3V &o) const { return {x - o.x, y - o.y, z - o.z}; };
+	Vector3V operator*(FloatV s) const { return {x * s, y * s, z * s}; };
+	Vector3V operator*(float s) const { return {x * s, y * s, z * s}; };
+	FloatV dot(const Vector3V &o) const { return x * o.x + y * o.y + z * o.z; };
+	FloatV length() const { return sqrt(dot(*this)); };
+	Vector3V normalize() const { return *this * (1.0f / length()); };
+	Vector3V abs() const { return {::abs(x), ::abs(y), ::abs(z)}; };
+
+	Vector3 lane(int i) const { return Vector3(x[i], y[i], z[i]); };
+	void set_lane(int i, const Vector3 &v) {
+		x[i] = v.coords[0];
+		y[i] = v.coords[1];
+		z[i] = v.coords[2];
+	};
+};
+
+inline Vector3V select(MaskV mask, const Vector3V &a, const Vector3V &b) {
+	return {select(mask, a.x, b.x), select(mask, a.y, b.y), select(mask, a.z, b.z)};
+}
+
+inline Vector3V mix(const Vector3V &a, const Vector3V &b, FloatV t) {
+	return {mix(a.x, b.x, t), mix(a.y, b.y, t), mix(a.z, b.z, t)};
+}
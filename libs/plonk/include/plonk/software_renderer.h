@@ -0,0 +1,39 @@
+#pragma once
+
+#include "camera.h"
+#include "image.h"
+#include "job_system.h"
+#include "scene_sdf.h"
+#include <memory>
+
+/**
+ * Renders the raymarched scene on the CPU, for machines without a usable Vulkan device.
+ *
+ * Pixels are marched in packets of `SIMD_LANES` along a row. The screen is cut into tiles which are run as jobs on a
+ * `JobSystem`; idle threads steal tiles from busy ones, so uneven tiles (sky vs geometry) don't leave cores idle.
+ */
+class SoftwareRenderer {
+public:
+	static const uint32_t TILE_SIZE = 32;
+
+	SoftwareRenderer(std::shared_ptr<JobSystem> jobs = nullptr);
+	void draw(Camera &camera, float time, Image &target);
+	uint32_t thread_count() { return jobs->thread_count(); };
+
+	// Prevent copies
+	SoftwareRenderer(const SoftwareRenderer &) = delete;
+	SoftwareRenderer &operator=(const SoftwareRenderer &) = delete;
+
+private:
+	struct FrameState {
+		SceneSdf scene;
+		Camera camera;
+		Image *target = nullptr;
+		uint32_t tiles_x = 0;
+	};
+
+	std::shared_ptr<JobSystem> jobs;
+	FrameState state;
+
+	void render_tile(uint32_t tile);
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "job_system.h"
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct StartupPhase {
+	std::string name;
+	// Milliseconds since the timer was created
+	double start_ms;
+	double duration_ms;
+	// Ran on a worker rather than the thread that created the timer
+	bool background;
+};
+
+/**
+ * Records how long each phase of startup takes, on whichever thread it runs, for a breakdown once everything is up
+ */
+class StartupTimer {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	StartupTimer();
+	void record(const std::string &name, Clock::time_point start, Clock::time_point end);
+	void time(const std::string &name, const std::function<void()> &fn);
+	double elapsed_ms();
+	std::vector<StartupPhase> get_phases();
+	void report();
+
+private:
+	Clock::time_point created_at;
+	std::thread::id main_thread;
+	std::mutex mutex;
+	std::vector<StartupPhase> phases;
+};
+
+/**
+ * Times a phase until it goes out of scope, or until `end` for phases that don't fit a block
+ */
+class StartupScope {
+public:
+	StartupScope(StartupTimer &timer, const std::string &name);
+	~StartupScope();
+	void end();
+
+private:
+	StartupTimer &timer;
+	std::string name;
+	StartupTimer::Clock::time_point start;
+	bool ended = false;
+};
+
+/**
+ * Independent startup work, such as pipeline compilation and swapchain setup, run on a JobSystem and timed.
+ *
+ * Without a JobSystem tasks run immediately on the calling thread. Jobs mustn't throw, so the first exception a task
+ * throws is kept and rethrown by `wait`.
+ */
+class StartupTasks {
+public:
+	StartupTasks(StartupTimer &timer, std::shared_ptr<JobSystem> jobs = nullptr);
+	~StartupTasks();
+	void run(const std::string &phase, std::function<void()> task);
+	void wait();
+	void drain();
+
+	// Prevent copies
+	StartupTasks(const StartupTasks &) = delete;
+	StartupTasks &operator=(const StartupTasks &) = delete;
+
+private:
+	StartupTimer &timer;
+	std::shared_ptr<JobSystem> jobs;
+	JobCounter counter;
+	std::mutex mutex;
+	std::exception_ptr error;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "context.h"
+#include <array>
+#include <vector>
+
+enum class StepDebugMode : uint32_t {
+	OFF = 0,
+	PRIMARY = 1,
+	SHADOW = 2,
+};
+
+// Matches StepSummary in shaders/step_histogram.comp.glsl
+struct StepSummary {
+	uint32_t count;
+	uint32_t max_steps;
+	uint32_t p50;
+	uint32_t p90;
+	uint32_t p99;
+	float mean;
+};
+
+struct StepStats {
+	StepSummary primary{};
+	StepSummary shadow{};
+	std::vector<uint32_t> primary_histogram;
+	std::vector<uint32_t> shadow_histogram;
+};
+
+/**
+ * Debug view of how many raymarch steps each pixel costs.
+ *
+ * While enabled, the shading and shadow passes write their per-pixel step counts into a storage buffer, and the
+ * shading pass overlays them as a heatmap. A compute pass then builds a histogram and percentiles on the GPU, which
+ * are read back `FRAME_COUNT` frames later without stalling.
+ */
+class StepHeatmap {
+public:
+	static const uint32_t MAX_STEPS = 256;
+	static const uint32_t BINS = MAX_STEPS + 1;
+	static const uint32_t FRAME_COUNT = 3;
+
+	StepDebugMode mode = StepDebugMode::OFF;
+
+	// With `startup`, the pipelines compile there and aren't ready until it's been waited on
+	StepHeatmap(ContextPtr ctx, StartupTasks *startup = nullptr);
+	~StepHeatmap();
+	void resize(VkExtent2D size);
+	bool needs_resize(VkExtent2D size);
+	void begin_frame(VkCommandBuffer command_buffer);
+	void record_stats(VkCommandBuffer command_buffer, VkExtent2D shadow_size);
+	VkDescriptorSetLayout get_descriptor_set_layout() { return graphics_set_layout; };
+	VkDescriptorSet get_descriptor_set() { return graphics_set; };
+	// Per-pixel step counts the passes write, for declaring in the render graph
+	VkBuffer get_counts_buffer() { return counts_buffer; };
+	StepStats get_stats() { return stats; };
+	// Without fragmentStoresAndAtomics the passes can't write step counts, so there are no stats pipelines
+	bool is_available() const { return available; };
+	bool is_enabled() const { return available && mode != StepDebugMode::OFF; };
+
+	// Prevent copies
+	StepHeatmap(const StepHeatmap &) = delete;
+	StepHeatmap &operator=(const StepHeatmap &) = delete;
+
+private:
+	// Matches the StepStats buffer in shaders/step_histogram.comp.glsl
+	struct GpuStats {
+		StepSummary summaries[2];
+		uint32_t histograms[2][BINS];
+	};
+
+	struct FrameSlot {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		GpuStats *mapped = nullptr;
+		VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+		bool pending = false;
+	};
+
+	ContextPtr ctx;
+	bool available = true;
+	VkExtent2D extent{0, 0};
+	uint64_t frame = 0;
+	StepStats stats;
+	VkBuffer counts_buffer = VK_NULL_HANDLE;
+	VkDeviceMemory counts_memory = VK_NULL_HANDLE;
+	std::array<FrameSlot, FRAME_COUNT> slots;
+	VkShaderModule histogram_shader = VK_NULL_HANDLE;
+	VkShaderModule percentiles_shader = VK_NULL_HANDLE;
+	VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+	VkDescriptorSetLayout graphics_set_layout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout compute_set_layout = VK_NULL_HANDLE;
+	VkDescriptorSet graphics_set = VK_NULL_HANDLE;
+	VkPipelineLayout compute_layout = VK_NULL_HANDLE;
+	VkPipeline histogram_pipeline = VK_NULL_HANDLE;
+	VkPipeline percentiles_pipeline = VK_NULL_HANDLE;
+
+	FrameSlot &current_slot() { return slots[frame % FRAME_COUNT]; };
+	void create_descriptors();
+	void create_pipelines();
+	void collect(FrameSlot &slot);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "dispatch.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+typedef uint32_t QueueLane;
+
+/**
+ * A value on one queue's timeline, reached once the submission that returned it (and every earlier one to the same
+ * queue) has finished
+ */
+struct TimelinePoint {
+	QueueLane lane = 0;
+	uint64_t value = 0;
+};
+
+struct Submission {
+	std::vector<VkCommandBuffer> command_buffers;
+	// Points on any queue's timeline that must be reached before `stages` of this submission run
+	std::vector<std::pair<TimelinePoint, VkPipelineStageFlags2>> waits;
+	// Binary semaphores, for the swapchain's acquire and present which can't use timelines
+	std::vector<std::pair<VkSemaphore, VkPipelineStageFlags2>> binary_waits;
+	std::vector<VkSemaphore> binary_signals;
+};
+
+/**
+ * Submits work to the device's queues, with one timeline semaphore per queue.
+ *
+ * Every submission signals the next value on its queue's timeline and gets back that point, which the CPU can wait
+ * for or poll, and which later submissions on any queue can wait on. That replaces per-frame fences, and lets work on
+ * graphics, compute and transfer queues be chained without extra semaphores.
+ *
+ * Queues are added up front. After that, `submit` and the waits can be called from any thread.
+ */
+class SubmitScheduler {
+public:
+	SubmitScheduler(VkDevice device, const DeviceDispatch &vk);
+	~SubmitScheduler();
+	QueueLane add_queue(VkQueue queue, const std::string &name);
+	TimelinePoint submit(QueueLane lane, const Submission &submission);
+	TimelinePoint last_submitted(QueueLane lane);
+	uint64_t completed_value(QueueLane lane);
+	bool is_complete(TimelinePoint point);
+	bool wait(TimelinePoint point, uint64_t timeout = UINT64_MAX);
+	bool wait_all(const std::vector<TimelinePoint> &points, uint64_t timeout = UINT64_MAX);
+	void wait_idle();
+	VkSemaphore get_semaphore(QueueLane lane) { return lanes[lane]->semaphore; };
+	VkQueue get_queue(QueueLane lane) { return lanes[lane]->queue; };
+	uint32_t lane_count() { return lanes.size(); };
+
+	// Prevent copies
+	SubmitScheduler(const SubmitScheduler &) = delete;
+	SubmitScheduler &operator=(const SubmitScheduler &) = delete;
+
+private:
+	struct Lane {
+		std::string name;
+		VkQueue queue = VK_NULL_HANDLE;
+		VkSemaphore semaphore = VK_NULL_HANDLE;
+		// Guards the queue and `submitted`, so values are signalled in the order they're handed out
+		std::mutex mutex;
+		uint64_t submitted = 0;
+		std::atomic<uint64_t> completed{0};
+	};
+
+	VkDevice device;
+	// Owned by the context, which outlives the scheduler
+	const DeviceDispatch &vk;
+	std::vector<std::unique_ptr<Lane>> lanes;
+};
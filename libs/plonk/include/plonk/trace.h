@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * CPU trace instrumentation, written out as Chrome trace event JSON (chrome://tracing or ui.perfetto.dev).
+ *
+ * Every thread records into its own ring buffer with no locking; `Trace::flush` drains them all into the trace.
+ * The macros compile to nothing unless PLONK_TRACE is defined.
+ */
+#ifdef PLONK_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(_trace_scope_, __LINE__)(name)
+#define TRACE_FUNCTION() TRACE_SCOPE(__func__)
+#define TRACE_THREAD_NAME(name) Trace::set_thread_name(name)
+#define TRACE_FLUSH() Trace::flush()
+#define TRACE_WRITE(filename) Trace::write(filename)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_FUNCTION()
+#define TRACE_THREAD_NAME(name)
+#define TRACE_FLUSH()
+#define TRACE_WRITE(filename)
+#endif
+
+class Trace {
+public:
+	static uint64_t now_ns();
+	static void record(const char *name, uint64_t start_ns, uint64_t duration_ns);
+	static void record_gpu(const std::string &name, uint64_t start_ns, uint64_t duration_ns);
+	static void set_thread_name(const std::string &name);
+	static void flush();
+	static void write(const std::string &filename);
+};
+
+class TraceScope {
+public:
+	TraceScope(const char *name) : name(name), start_ns(Trace::now_ns()) {}
+	~TraceScope() { Trace::record(name, start_ns, Trace::now_ns() - start_ns); }
+
+private:
+	const char *name;
+	uint64_t start_ns;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "context.h"
+#include "handle.h"
+#include "job_system.h"
+#include "math.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+struct TransformTag;
+using TransformHandle = Handle<TransformTag>;
+
+/**
+ * A node's transform relative to its parent: scaled, rotated by Euler angles in radians as `Matrix4::from_rotation`
+ * does, then translated
+ */
+struct Transform {
+	Vector3 translation = Vector3(0.0, 0.0, 0.0);
+	Vector3 rotation = Vector3(0.0, 0.0, 0.0);
+	Vector3 scale = Vector3(1.0, 1.0, 1.0);
+
+	Matrix4 to_matrix() const;
+};
+
+/**
+ * Every object's place in the scene, as a hierarchy of transforms.
+ *
+ * Nodes are stored as parallel arrays (translations, rotations, scales, world matrices, parents), sorted so each depth
+ * of the hierarchy is one contiguous range and every parent comes before its children. `update` then walks the
+ * depths in order, recomputing the world matrices of nodes that changed or whose parent did, with each depth split
+ * across the job system. Adding a node shallower than the deepest one, or removing any, reorders the arrays at the
+ * next update.
+ *
+ * Handles stay valid until their node is removed. A node's index, its position in `world_matrices` and in what
+ * `pack` writes, only holds until the hierarchy's shape next changes.
+ */
+class TransformHierarchy {
+public:
+	static const uint32_t NO_PARENT = UINT32_MAX;
+
+	TransformHandle add(const Transform &local, TransformHandle parent = {});
+	void remove(TransformHandle node);
+	void set_local(TransformHandle node, const Transform &local);
+	Transform get_local(TransformHandle node);
+	const Matrix4 &get_world(TransformHandle node);
+	uint32_t get_index(TransformHandle node);
+	bool contains(TransformHandle node) { return indices.contains(node); };
+	size_t size() { return handles.size(); };
+	uint32_t depth_count() { return level_starts.empty() ? 0 : level_starts.size() - 1; };
+	void update(JobSystem *jobs = nullptr);
+	uint64_t pack(Matrix4 *destination, uint64_t packed_version, JobSystem *jobs = nullptr);
+	const Matrix4 *world_matrices() { return worlds.data(); };
+
+private:
+	// Nodes per job, each is a few dozen flops
+	static const size_t GRAIN = 2048;
+
+	SlotArray<uint32_t, TransformTag> indices;
+	std::vector<TransformHandle> handles;
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> depths;
+	std::vector<Vector3> translations;
+	std::vector<Vector3> rotations;
+	std::vector<Vector3> scales;
+	std::vector<Matrix4> worlds;
+	std::vector<uint8_t> dirty;
+	// Update each node's world matrix last changed in, so `pack` can skip the rest
+	std::vector<uint64_t> changed;
+	// Depth d is nodes [level_starts[d], level_starts[d + 1])
+	std::vector<uint32_t> level_starts;
+	uint64_t version = 0;
+	bool needs_sort = false;
+	bool shape_changed = false;
+
+	uint32_t index_of(TransformHandle node);
+	void reorder(const std::vector<uint32_t> &order);
+	void sort_by_depth();
+	void rebuild_levels();
+};
+
+/**
+ * World matrices as a storage buffer of std430 mat4s, one host visible buffer per frame in flight.
+ *
+ * Each upload only writes the matrices that changed since that frame slot's buffer was last written, straight into
+ * the mapped memory. Matrices are at their nodes' indices.
+ */
+class TransformBuffer {
+public:
+	TransformBuffer(ContextPtr ctx);
+	~TransformBuffer();
+	VkBuffer upload(TransformHierarchy &transforms, JobSystem *jobs = nullptr);
+
+	// Prevent copies
+	TransformBuffer(const TransformBuffer &) = delete;
+	TransformBuffer &operator=(const TransformBuffer &) = delete;
+
+private:
+	struct Slot {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		Matrix4 *mapped = nullptr;
+		size_t capacity = 0;
+		uint64_t version = 0;
+	};
+
+	ContextPtr ctx;
+	std::array<Slot, Context::MAX_FRAMES_IN_FLIGHT> slots;
+
+	void release(Slot &slot);
+};
@@ -3,6 +3,7 @@
 #define GLFW_INCLUDE_VULKAN
 #define GLFW_EXPOSE_NATIVE_X11
 #include "event.h"
+#include "image.h"
 #include "keys.h"
 #include "math.h"
 #include <GLFW/glfw3.h>
@@ -24,10 +25,12 @@ public:
 	void grab_mouse();
 	void release_mouse();
 	bool is_mouse_grabbed();
+	void set_title(const std::string &title);
 	Point2 mouse_position();
 	void on_key_press(Key key, std::function<void(void)> callback);
 	void on_key_release(Key key, std::function<void(void)> callback);
 	void on_mouse_move(std::function<void(Point2)> callback);
+	void present(const Image &image);
 
 private:
 	double mouse_x;
@@ -36,6 +39,7 @@ private:
 	std::unordered_map<Key, std::vector<std::function<void()>>> key_press_callbacks;
 	std::unordered_map<Key, std::vector<std::function<void()>>> key_release_callbacks;
 	std::vector<std::function<void(Point2)>> mouse_move_callbacks;
+	std::vector<uint8_t> present_buffer;
 
 	static void glfw_key_callback(GLFWwindow* inner, int key, int scancode, int action, int mods);
 	static void glfw_mouse_callback(GLFWwindow* inner, double x, double y);
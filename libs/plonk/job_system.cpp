@@ -0,0 +1,200 @@
+#include "include/plonk/job_system.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+static thread_local JobSystem *current_system = nullptr;
+static thread_local uint32_t current_worker = 0;
+
+// Tries before an idle worker goes to sleep
+static const int SPIN_COUNT = 64;
+
+JobSystem::JobSystem(uint32_t thread_count) {
+	if (thread_count == 0) {
+		thread_count = std::max(1u, std::thread::hardware_concurrency());
+	}
+	main_thread = std::this_thread::get_id();
+	for (uint32_t i = 0; i < thread_count; i++) {
+		queues.push_back(std::make_unique<JobQueue>());
+	}
+	for (uint32_t i = 1; i < thread_count; i++) {
+		workers.emplace_back(&JobSystem::run_worker, this, i);
+	}
+	LOG_INFO("Job system using %u threads", thread_count);
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+/**
+ * Queue a job on the calling thread's deque. If `counter` is given it's incremented now and decremented once the job
+ * has run.
+ */
+void JobSystem::run(std::function<void()> job, JobCounter *counter) {
+	if (counter) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	auto &queue = *queues[current_index()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back({std::move(job), counter});
+	}
+	queued.fetch_add(1);
+	if (sleeping.load() > 0) {
+		// Taking the lock orders this with a worker that's about to sleep, so the wake up can't be missed
+		{ std::lock_guard<std::mutex> lock(sleep_mutex); }
+		wake.notify_one();
+	}
+}
+
+/**
+ * Queue a job that may only run on the main thread, at its next `pump_main` or `wait`
+ */
+void JobSystem::run_on_main(std::function<void()> job, JobCounter *counter) {
+	if (counter) {
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+	std::lock_guard<std::mutex> lock(main_queue.mutex);
+	main_queue.jobs.push_back({std::move(job), counter});
+}
+
+/**
+ * Run queued main thread jobs, returning how many ran. Call regularly from the main loop.
+ */
+uint32_t JobSystem::pump_main() {
+	if (!is_main_thread()) {
+		throw std::runtime_error("pump_main called off the main thread");
+	}
+	uint32_t count = 0;
+	Job job;
+	while (pop(main_queue, job, false)) {
+		execute(job);
+		count++;
+	}
+	return count;
+}
+
+/**
+ * Block until every job counted by `counter` has finished, running other jobs in the meantime
+ */
+void JobSystem::wait(JobCounter &counter) {
+	TRACE_FUNCTION();
+	uint32_t index = current_index();
+	while (!counter.done()) {
+		if (try_run_one(index)) {
+			continue;
+		}
+		// Outside threads share index 0 too, but only the main thread may run its jobs
+		if (is_main_thread() && pump_main() > 0) {
+			continue;
+		}
+		std::this_thread::yield();
+	}
+}
+
+/**
+ * Call `fn(chunk_begin, chunk_end)` over [begin, end) in chunks of `grain`, and wait for them all
+ */
+void JobSystem::parallel_for(size_t begin, size_t end, size_t grain, std::function<void(size_t, size_t)> fn) {
+	TRACE_FUNCTION();
+	grain = std::max(grain, (size_t)1);
+	JobCounter counter;
+	for (size_t chunk = begin; chunk < end; chunk += grain) {
+		size_t chunk_end = std::min(chunk + grain, end);
+		run([&fn, chunk, chunk_end]() { fn(chunk, chunk_end); }, &counter);
+	}
+	wait(counter);
+}
+
+bool JobSystem::owns_current_thread() {
+	return current_system == this || is_main_thread();
+}
+
+uint32_t JobSystem::current_index() {
+	// Threads outside the system share the main thread's deque
+	return current_system == this ? current_worker : 0;
+}
+
+/**
+ * Run a job from this thread's own deque, or failing that steal one from another thread
+ */
+bool JobSystem::try_run_one(uint32_t index) {
+	Job job;
+	if (pop(*queues[index], job, true)) {
+		execute(job);
+		return true;
+	}
+
+	uint32_t count = queues.size();
+	for (uint32_t i = 1; i < count; i++) {
+		if (pop(*queues[(index + i) % count], job, false)) {
+			execute(job);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::pop(JobQueue &queue, Job &job, bool back) {
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty()) {
+		return false;
+	}
+	if (back) {
+		job = std::move(queue.jobs.back());
+		queue.jobs.pop_back();
+	}
+	else {
+		job = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+	}
+	if (&queue != &main_queue) {
+		queued.fetch_sub(1);
+	}
+	return true;
+}
+
+void JobSystem::execute(Job &job) {
+	job.fn();
+	if (job.counter) {
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+void JobSystem::run_worker(uint32_t index) {
+	current_system = this;
+	current_worker = index;
+	TRACE_THREAD_NAME(("Worker " + std::to_string(index)).c_str());
+
+	int idle = 0;
+	while (true) {
+		if (try_run_one(index)) {
+			idle = 0;
+			continue;
+		}
+		// Queued jobs are finished before shutting down
+		if (stopping.load()) {
+			return;
+		}
+		if (++idle < SPIN_COUNT) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		sleeping.fetch_add(1);
+		wake.wait(lock, [&]() { return stopping.load() || queued.load() > 0; });
+		sleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
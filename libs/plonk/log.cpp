@@ -0,0 +1,258 @@
+#include "include/plonk/log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Single producer ring. Only the owning thread writes records, and only LogWriter::drain reads them.
+struct LogRing {
+	static const uint64_t CAPACITY = 1 << 9;
+
+	std::atomic<uint64_t> write_index = 0;
+	std::atomic<uint64_t> read_index = 0;
+	std::atomic<uint64_t> dropped = 0;
+	// Set once the owning thread has exited, so the ring can be freed after its last records are printed
+	std::atomic<bool> finished = false;
+	LogRecord records[CAPACITY];
+};
+
+struct LogLine {
+	uint64_t time_ns;
+	LogLevel level;
+	std::string text;
+};
+
+/**
+ * Owns every thread's ring and the thread that prints them
+ */
+class LogWriter {
+public:
+	LogWriter() : thread(&LogWriter::run, this) {}
+	LogRing &add_ring();
+	void wake();
+	void drain();
+
+private:
+	std::mutex registry_mutex;
+	// Rings outlive their threads until drained, so messages from finished threads are still printed
+	std::vector<std::unique_ptr<LogRing>> rings;
+	std::mutex drain_mutex;
+	std::vector<LogLine> lines;
+	std::atomic<uint32_t> pending = 0;
+	std::thread thread;
+
+	void run();
+	bool has_unread();
+};
+
+static auto epoch = std::chrono::steady_clock::now();
+
+static uint64_t now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+static LogLevel level_from_env() {
+	auto env_level = std::getenv("PLONK_LOG");
+	std::string name = env_level ? env_level : "";
+	if (name == "debug") {
+		return LogLevel::DEBUG;
+	}
+	if (name == "warning") {
+		return LogLevel::WARNING;
+	}
+	if (name == "error") {
+		return LogLevel::ERROR;
+	}
+	return LogLevel::INFO;
+}
+
+static std::atomic<LogLevel> &level_setting() {
+	static std::atomic<LogLevel> level{level_from_env()};
+	return level;
+}
+
+static LogWriter &writer() {
+	// Never destroyed, so threads still logging during exit can't touch a dead writer; exit prints what's left instead
+	static LogWriter *instance = []() {
+		auto created = new LogWriter();
+		std::atexit(Log::flush);
+		return created;
+	}();
+	return *instance;
+}
+
+static thread_local LogRing *current_ring = nullptr;
+static thread_local bool ring_retired = false;
+
+// Hands the thread's ring back to the writer when the thread exits
+struct LogRingOwner {
+	~LogRingOwner() {
+		current_ring->finished.store(true, std::memory_order_release);
+		current_ring = nullptr;
+		ring_retired = true;
+		writer().wake();
+	}
+};
+
+// Null once the thread's thread_locals are being destroyed, as anything logged then would outlive the ring
+static LogRing *thread_ring() {
+	if (!current_ring && !ring_retired) {
+		thread_local LogRingOwner owner;
+		current_ring = &writer().add_ring();
+	}
+	return current_ring;
+}
+
+static const char *prefix(LogLevel level) {
+	switch (level) {
+		case LogLevel::DEBUG:
+			return "debug: ";
+		case LogLevel::WARNING:
+			return "warning: ";
+		case LogLevel::ERROR:
+			return "error: ";
+		default:
+			return "";
+	}
+}
+
+LogRing &LogWriter::add_ring() {
+	std::lock_guard lock(registry_mutex);
+	rings.push_back(std::make_unique<LogRing>());
+	return *rings.back();
+}
+
+void LogWriter::wake() {
+	pending.fetch_add(1, std::memory_order_release);
+	pending.notify_one();
+}
+
+void LogWriter::run() {
+	while (true) {
+		auto seen = pending.load(std::memory_order_acquire);
+		drain();
+		// Records committed while draining only wake the writer if they found their ring empty, so look again
+		if (!has_unread()) {
+			pending.wait(seen, std::memory_order_acquire);
+		}
+	}
+}
+
+bool LogWriter::has_unread() {
+	std::lock_guard lock(registry_mutex);
+	for (auto &ring : rings) {
+		// seq_cst, pairing with commit_record: either this sees the record or the committer sees the drained ring
+		if (ring->write_index.load() != ring->read_index.load()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Format and print everything the rings hold, oldest first
+ */
+void LogWriter::drain() {
+	std::lock_guard lock(drain_mutex);
+	std::vector<LogRing *> snapshot;
+	{
+		std::lock_guard registry_lock(registry_mutex);
+		for (auto &ring : rings) {
+			snapshot.push_back(ring.get());
+		}
+	}
+
+	uint64_t dropped = 0;
+	char buffer[1024];
+	std::vector<LogRing *> retired;
+	for (auto ring : snapshot) {
+		// Before the write index, so nothing can be written after the records read here
+		bool finished = ring->finished.load(std::memory_order_acquire);
+		auto end = ring->write_index.load(std::memory_order_acquire);
+		for (auto i = ring->read_index.load(std::memory_order_relaxed); i < end; i++) {
+			auto &record = ring->records[i % LogRing::CAPACITY];
+			auto length = record.formatter(record, buffer, sizeof(buffer));
+			lines.push_back({
+				.time_ns = record.time_ns,
+				.level = record.level,
+				.text = std::string(buffer, std::clamp(length, 0, (int)sizeof(buffer) - 1)),
+			});
+		}
+		// Hands the slots back to the owning thread; seq_cst, see has_unread
+		ring->read_index.store(end);
+		dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+		if (finished) {
+			retired.push_back(ring);
+		}
+	}
+	if (!retired.empty()) {
+		std::lock_guard registry_lock(registry_mutex);
+		std::erase_if(rings, [&](auto &ring) {
+			return std::find(retired.begin(), retired.end(), ring.get()) != retired.end();
+		});
+	}
+	if (lines.empty() && dropped == 0) {
+		return;
+	}
+
+	std::stable_sort(lines.begin(), lines.end(), [](auto &a, auto &b) { return a.time_ns < b.time_ns; });
+	for (auto &line : lines) {
+		std::fputs(prefix(line.level), stdout);
+		std::fwrite(line.text.data(), 1, line.text.size(), stdout);
+		std::fputc('\n', stdout);
+	}
+	if (dropped > 0) {
+		std::fprintf(
+			stdout, "warning: dropped %llu log messages, logged faster than they could be written\n",
+			(unsigned long long)dropped
+		);
+	}
+	std::fflush(stdout);
+	lines.clear();
+}
+
+void Log::set_level(LogLevel level) {
+	level_setting().store(level, std::memory_order_relaxed);
+}
+
+LogLevel Log::get_level() {
+	return level_setting().load(std::memory_order_relaxed);
+}
+
+/**
+ * Print everything logged so far before returning, e.g. before a crash would lose it
+ */
+void Log::flush() {
+	writer().drain();
+}
+
+LogRecord *Log::begin_record() {
+	auto ring_pointer = thread_ring();
+	if (!ring_pointer) {
+		return nullptr;
+	}
+	auto &ring = *ring_pointer;
+	auto index = ring.write_index.load(std::memory_order_relaxed);
+	if (index - ring.read_index.load(std::memory_order_acquire) >= LogRing::CAPACITY) {
+		ring.dropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	auto &record = ring.records[index % LogRing::CAPACITY];
+	record.time_ns = now_ns();
+	return &record;
+}
+
+void Log::commit_record() {
+	auto &ring = *thread_ring();
+	auto index = ring.write_index.load(std::memory_order_relaxed);
+	ring.write_index.store(index + 1);
+	// The writer drains every ring before sleeping, so it only needs waking when this record found the ring empty
+	if (ring.read_index.load() == index) {
+		writer().wake();
+	}
+}
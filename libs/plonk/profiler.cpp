@@ -0,0 +1,279 @@
+#include "include/plonk/profiler.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
+#include <algorithm>
+#include <fstream>
+
+static const uint32_t STATISTICS_COUNT = 3;
+
+Profiler::Profiler(ContextPtr ctx) : ctx(ctx) {
+	ms_per_tick = ctx->timestamp_period() / 1e6;
+	auto valid_bits = ctx->timestamp_valid_bits();
+	if (valid_bits == 0) {
+		LOG_WARNING("Graphics queue doesn't support timestamps, GPU profiling disabled");
+		enabled = false;
+		return;
+	}
+	statistics_enabled = ctx->get_enabled_features().pipelineStatisticsQuery;
+	timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+	for (auto &slot : slots) {
+		VkQueryPoolCreateInfo timestamp_info{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = MAX_SCOPES * 2,
+		};
+		if (VK_SUCCESS != vkCreateQueryPool(ctx->device, &timestamp_info, nullptr, &slot.timestamps)) {
+			throw std::runtime_error("Failed to create timestamp Query Pool");
+		}
+
+		if (statistics_enabled) {
+			VkQueryPoolCreateInfo statistics_info{
+				.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+				.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+				.queryCount = MAX_SCOPES,
+				.pipelineStatistics = STATISTICS,
+			};
+			if (VK_SUCCESS != vkCreateQueryPool(ctx->device, &statistics_info, nullptr, &slot.statistics)) {
+				throw std::runtime_error("Failed to create pipeline statistics Query Pool");
+			}
+		}
+	}
+
+#ifdef PLONK_TRACE
+	// Only traces need GPU times on the CPU clock, and calibrating blocks on a submit
+	calibrate();
+#endif
+}
+
+/**
+ * Estimate the offset between the GPU timestamp clock and the CPU trace clock by writing a single timestamp and
+ * taking the midpoint of the CPU time around the submission. Good to within the submit latency, which is plenty
+ * for lining up scopes in a trace.
+ */
+void Profiler::calibrate() {
+	auto pool = slots[0].timestamps;
+	auto before = Trace::now_ns();
+	ctx->immediate_submit([&](VkCommandBuffer command_buffer) {
+		ctx->vk.CmdResetQueryPool(command_buffer, pool, 0, 1);
+		ctx->vk.CmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, 0);
+	});
+	auto after = Trace::now_ns();
+
+	uint64_t ticks = 0;
+	ctx->vk.GetQueryPoolResults(
+		ctx->device, pool, 0, 1, sizeof(ticks), &ticks, sizeof(ticks), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
+	);
+	gpu_epoch_ns = (before + after) / 2.0 - (ticks & timestamp_mask) * ms_per_tick * 1e6;
+}
+
+/**
+ * Start profiling a new frame. Must be called outside of a render pass.
+ *
+ * Results from the last frame recorded into this slot are collected before its queries are reset.
+ */
+void Profiler::begin_frame(VkCommandBuffer command_buffer) {
+	if (!enabled) {
+		return;
+	}
+	frame++;
+	auto &slot = current_slot();
+	if (slot.pending) {
+		collect(slot);
+	}
+
+	slot.scopes.clear();
+	slot.statistics_count = 0;
+	slot.pending = false;
+	open_scopes.clear();
+	ctx->vk.CmdResetQueryPool(command_buffer, slot.timestamps, 0, MAX_SCOPES * 2);
+	if (statistics_enabled) {
+		ctx->vk.CmdResetQueryPool(command_buffer, slot.statistics, 0, MAX_SCOPES);
+	}
+}
+
+void Profiler::begin_scope(VkCommandBuffer command_buffer, const std::string &name) {
+	if (!enabled) {
+		return;
+	}
+	auto &slot = current_slot();
+	if (slot.scopes.size() >= MAX_SCOPES) {
+		throw std::runtime_error("Too many profiler scopes in one frame");
+	}
+
+	uint32_t index = slot.scopes.size();
+	uint32_t depth = open_scopes.size();
+
+	// Pipeline statistics queries can't nest, so only outermost scopes collect them
+	int32_t statistics_query = -1;
+	if (statistics_enabled && depth == 0) {
+		statistics_query = slot.statistics_count++;
+		ctx->vk.CmdBeginQuery(command_buffer, slot.statistics, statistics_query, 0);
+	}
+
+	slot.scopes.push_back({.name = name, .depth = depth, .statistics_query = statistics_query});
+	open_scopes.push_back(index);
+	ctx->vk.CmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.timestamps, index * 2);
+}
+
+void Profiler::end_scope(VkCommandBuffer command_buffer) {
+	if (!enabled) {
+		return;
+	}
+	if (open_scopes.empty()) {
+		throw std::runtime_error("Profiler scope ended without being started");
+	}
+	auto &slot = current_slot();
+	auto index = open_scopes.back();
+	open_scopes.pop_back();
+
+	auto &scope = slot.scopes[index];
+	ctx->vk.CmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.timestamps, index * 2 + 1);
+	if (scope.statistics_query >= 0) {
+		ctx->vk.CmdEndQuery(command_buffer, slot.statistics, scope.statistics_query);
+	}
+	slot.pending = true;
+}
+
+void Profiler::collect(FrameSlot &slot) {
+	if (slot.scopes.empty()) {
+		return;
+	}
+
+	std::vector<uint64_t> timestamps(slot.scopes.size() * 2);
+	auto result = ctx->vk.GetQueryPoolResults(
+		ctx->device, slot.timestamps, 0, timestamps.size(), timestamps.size() * sizeof(uint64_t), timestamps.data(),
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT
+	);
+	if (VK_SUCCESS != result) {
+		// Still in flight, drop the frame rather than stall
+		return;
+	}
+
+	std::vector<uint64_t> statistics(slot.statistics_count * STATISTICS_COUNT);
+	bool has_statistics = false;
+	if (slot.statistics_count > 0) {
+		result = ctx->vk.GetQueryPoolResults(
+			ctx->device, slot.statistics, 0, slot.statistics_count, statistics.size() * sizeof(uint64_t),
+			statistics.data(), STATISTICS_COUNT * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT
+		);
+		has_statistics = VK_SUCCESS == result;
+	}
+
+	for (uint32_t i = 0; i < slot.scopes.size(); i++) {
+		auto &scope = slot.scopes[i];
+		auto ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestamp_mask;
+
+		if (!history.contains(scope.name)) {
+			scope_order.push_back(scope.name);
+		}
+		auto &entry = history[scope.name];
+		if (entry.samples.size() < WINDOW) {
+			entry.samples.push_back(ticks * ms_per_tick);
+		}
+		else {
+			entry.samples[entry.next] = ticks * ms_per_tick;
+		}
+		entry.next = (entry.next + 1) % WINDOW;
+		entry.total++;
+
+#ifdef PLONK_TRACE
+		auto start_ns = gpu_epoch_ns + (timestamps[i * 2] & timestamp_mask) * ms_per_tick * 1e6;
+		Trace::record_gpu(scope.name, start_ns > 0.0 ? start_ns : 0.0, ticks * ms_per_tick * 1e6);
+#endif
+
+		if (has_statistics && scope.statistics_query >= 0) {
+			auto values = &statistics[scope.statistics_query * STATISTICS_COUNT];
+			entry.statistics = {
+				.vertex_invocations = values[0],
+				.fragment_invocations = values[1],
+				.compute_invocations = values[2],
+			};
+		}
+	}
+}
+
+/**
+ * Rolling min, average and max GPU time of every scope seen so far, over the last `WINDOW` frames
+ */
+std::vector<ScopeStats> Profiler::get_stats() {
+	std::vector<ScopeStats> stats;
+	for (auto &name : scope_order) {
+		auto &entry = history[name];
+		if (entry.samples.empty()) {
+			continue;
+		}
+
+		double sum = 0.0;
+		for (auto sample : entry.samples) {
+			sum += sample;
+		}
+		stats.push_back({
+			.name = name,
+			.min_ms = *std::min_element(entry.samples.begin(), entry.samples.end()),
+			.avg_ms = sum / entry.samples.size(),
+			.max_ms = *std::max_element(entry.samples.begin(), entry.samples.end()),
+			.samples = entry.total,
+			.statistics = entry.statistics,
+		});
+	}
+	return stats;
+}
+
+void Profiler::write_csv(const std::string &filename) {
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open profiler output");
+	}
+
+	file << "scope,min_ms,avg_ms,max_ms,samples,vertex_invocations,fragment_invocations,compute_invocations\n";
+	for (auto &scope : get_stats()) {
+		file << scope.name << "," << scope.min_ms << "," << scope.avg_ms << "," << scope.max_ms << ","
+			 << scope.samples << "," << scope.statistics.vertex_invocations << ","
+			 << scope.statistics.fragment_invocations << "," << scope.statistics.compute_invocations << "\n";
+	}
+}
+
+void Profiler::write_json(const std::string &filename) {
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open profiler output");
+	}
+
+	auto stats = get_stats();
+	file << "{\n\t\"scopes\": [\n";
+	for (size_t i = 0; i < stats.size(); i++) {
+		auto &scope = stats[i];
+		file << "\t\t{\"name\": \"" << scope.name << "\", \"min_ms\": " << scope.min_ms
+			 << ", \"avg_ms\": " << scope.avg_ms << ", \"max_ms\": " << scope.max_ms
+			 << ", \"samples\": " << scope.samples
+			 << ", \"vertex_invocations\": " << scope.statistics.vertex_invocations
+			 << ", \"fragment_invocations\": " << scope.statistics.fragment_invocations
+			 << ", \"compute_invocations\": " << scope.statistics.compute_invocations << "}"
+			 << (i + 1 < stats.size() ? ",\n" : "\n");
+	}
+	file << "\t]\n}\n";
+}
+
+/**
+ * Write the current stats to disk, as JSON if the filename ends in `.json` and CSV otherwise
+ */
+void Profiler::dump(const std::string &filename) {
+	if (filename.ends_with(".json")) {
+		write_json(filename);
+	}
+	else {
+		write_csv(filename);
+	}
+}
+
+Profiler::~Profiler() {
+	for (auto &slot : slots) {
+		if (slot.timestamps) {
+			vkDestroyQueryPool(ctx->device, slot.timestamps, nullptr);
+		}
+		if (slot.statistics) {
+			vkDestroyQueryPool(ctx->device, slot.statistics, nullptr);
+		}
+	}
+}
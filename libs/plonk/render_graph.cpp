@@ -0,0 +1,577 @@
+#include "include/plonk/render_graph.h"
+#include "include/plonk/context.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+static const VkAccessFlags2 WRITE_ACCESS = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+	VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+	VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+bool ImageAccess::reads() const {
+	return (access & ~WRITE_ACCESS) != 0;
+}
+
+bool ImageAccess::writes() const {
+	return (access & WRITE_ACCESS) != 0;
+}
+
+/**
+ * Rendered to by a render pass that discards the old contents and leaves it in `final_layout`
+ */
+ImageAccess ImageAccess::color_attachment(VkImageLayout final_layout) {
+	return {
+		.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+		.access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		.layout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.final_layout = final_layout,
+	};
+}
+
+ImageAccess ImageAccess::sampled(VkPipelineStageFlags2 stages) {
+	return {
+		.stages = stages,
+		.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+		.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+}
+
+ImageAccess ImageAccess::storage(VkPipelineStageFlags2 stages) {
+	return {
+		.stages = stages,
+		.access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		.layout = VK_IMAGE_LAYOUT_GENERAL,
+	};
+}
+
+ImageAccess ImageAccess::transfer_read(VkImageLayout layout) {
+	return {
+		.stages = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+		.access = VK_ACCESS_2_TRANSFER_READ_BIT,
+		.layout = layout,
+	};
+}
+
+BufferAccess BufferAccess::storage_read(VkPipelineStageFlags2 stages) {
+	return {.stages = stages, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT};
+}
+
+BufferAccess BufferAccess::storage_write(VkPipelineStageFlags2 stages) {
+	return {.stages = stages, .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT};
+}
+
+BufferAccess BufferAccess::storage(VkPipelineStageFlags2 stages) {
+	return {.stages = stages, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT};
+}
+
+static VkImageAspectFlags aspect_for(VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+		case VK_FORMAT_D32_SFLOAT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+RenderGraph::RenderGraph(std::shared_ptr<Context> ctx) : ctx(ctx) {}
+
+RenderGraph::~RenderGraph() {
+	release_transients();
+}
+
+/**
+ * Forget every pass and resource, ready to declare the next frame. Transient memory is kept.
+ */
+void RenderGraph::reset() {
+	resources.clear();
+	passes.clear();
+	compiled = false;
+}
+
+/**
+ * Use an image the graph doesn't own, currently in `state`. Passes writing an `exported` image are never culled.
+ */
+RenderResource RenderGraph::import_image(
+	const std::string &name, VkImage image, ImageState state, bool exported, VkImageView view
+) {
+	resources.push_back({
+		.name = name,
+		.exported = exported,
+		.image = image,
+		.view = view,
+		.initial_state = state,
+	});
+	return resources.size() - 1;
+}
+
+/**
+ * Use a buffer the graph doesn't own, last accessed as `state` describes (its layout is ignored)
+ */
+RenderResource RenderGraph::import_buffer(const std::string &name, VkBuffer buffer, ImageState state, bool exported) {
+	resources.push_back({
+		.name = name,
+		.exported = exported,
+		.is_buffer = true,
+		.buffer = buffer,
+		.initial_state = {VK_IMAGE_LAYOUT_UNDEFINED, state.stages, state.access},
+	});
+	return resources.size() - 1;
+}
+
+/**
+ * Declare an image that only lives for this frame. Its contents are undefined when its first pass starts.
+ */
+RenderResource RenderGraph::create_image(const std::string &name, TransientImageDesc desc) {
+	resources.push_back({
+		.name = name,
+		.transient = true,
+		.desc = desc,
+		// Its memory may have been used by anything earlier, including last frame
+		.initial_state = {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_WRITE_BIT},
+	});
+	return resources.size() - 1;
+}
+
+/**
+ * Add a pass that uses `images` as described and records its commands with `record`.
+ * Passes run in the order they're added. Passes with `side_effects` (readback, presentation) are never culled.
+ */
+void RenderGraph::add_pass(
+	const std::string &name, std::vector<std::pair<RenderResource, ImageAccess>> images,
+	std::function<void(VkCommandBuffer)> record, bool side_effects
+) {
+	passes.push_back({
+		.name = name,
+		.images = std::move(images),
+		.record = std::move(record),
+		.side_effects = side_effects,
+	});
+}
+
+/**
+ * Add a pass that uses `buffers` as well as `images`, e.g. storage buffers one pass writes and a later one reads
+ */
+void RenderGraph::add_pass(
+	const std::string &name, std::vector<std::pair<RenderResource, ImageAccess>> images,
+	std::vector<std::pair<RenderResource, BufferAccess>> buffers, std::function<void(VkCommandBuffer)> record,
+	bool side_effects
+) {
+	for (auto &[resource, access] : buffers) {
+		images.push_back({resource, {.stages = access.stages, .access = access.access}});
+	}
+	add_pass(name, std::move(images), std::move(record), side_effects);
+}
+
+void RenderGraph::compile() {
+	TRACE_FUNCTION();
+	cull_passes();
+	compute_lifetimes();
+	allocate_transients();
+	build_barriers();
+	compiled = true;
+}
+
+/**
+ * Record every live pass, each preceded by the barriers it needs
+ */
+void RenderGraph::execute(VkCommandBuffer command_buffer) {
+	TRACE_FUNCTION();
+	if (!compiled) {
+		throw std::runtime_error("Render graph must be compiled before it's executed");
+	}
+
+	size_t most_barriers = 0;
+	for (auto &pass : passes) {
+		most_barriers = std::max(most_barriers, pass.barriers.size());
+	}
+	auto image_barriers = ctx->get_frame_arena().make_array<VkImageMemoryBarrier2>(most_barriers);
+	auto buffer_barriers = ctx->get_frame_arena().make_array<VkBufferMemoryBarrier2>(most_barriers);
+	for (auto &pass : passes) {
+		if (!pass.live) {
+			continue;
+		}
+
+		uint32_t barrier_count = 0;
+		uint32_t buffer_barrier_count = 0;
+		for (auto &barrier : pass.barriers) {
+			auto &resource = resources[barrier.resource];
+			if (resource.is_buffer) {
+				buffer_barriers[buffer_barrier_count++] = {
+					.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+					.srcStageMask = barrier.src.stages,
+					.srcAccessMask = barrier.src.access,
+					.dstStageMask = barrier.dst.stages,
+					.dstAccessMask = barrier.dst.access,
+					.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+					.buffer = resource.buffer,
+					.offset = 0,
+					.size = VK_WHOLE_SIZE,
+				};
+				continue;
+			}
+			auto aspect = resource.transient ? aspect_for(resource.desc.format) : VK_IMAGE_ASPECT_COLOR_BIT;
+			image_barriers[barrier_count++] = {
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+				.srcStageMask = barrier.src.stages,
+				.srcAccessMask = barrier.src.access,
+				.dstStageMask = barrier.dst.stages,
+				.dstAccessMask = barrier.dst.access,
+				.oldLayout = barrier.src.layout,
+				.newLayout = barrier.dst.layout,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = resource.image,
+				.subresourceRange = {aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS},
+			};
+		}
+		if (barrier_count > 0 || buffer_barrier_count > 0) {
+			VkDependencyInfo dependency_info{
+				.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+				.bufferMemoryBarrierCount = buffer_barrier_count,
+				.pBufferMemoryBarriers = buffer_barriers,
+				.imageMemoryBarrierCount = barrier_count,
+				.pImageMemoryBarriers = image_barriers,
+			};
+			ctx->vk.CmdPipelineBarrier2(command_buffer, &dependency_info);
+		}
+
+		if (on_pass_begin) {
+			on_pass_begin(command_buffer, pass.name);
+		}
+		pass.record(command_buffer);
+		if (on_pass_end) {
+			on_pass_end(command_buffer, pass.name);
+		}
+	}
+}
+
+bool RenderGraph::is_pass_live(const std::string &name) {
+	for (auto &pass : passes) {
+		if (pass.name == name) {
+			return pass.live;
+		}
+	}
+	return false;
+}
+
+std::vector<GraphBarrier> RenderGraph::get_barriers(const std::string &name) {
+	for (auto &pass : passes) {
+		if (pass.name == name) {
+			return pass.barriers;
+		}
+	}
+	return {};
+}
+
+VkDeviceSize RenderGraph::transient_memory_size() {
+	VkDeviceSize size = 0;
+	for (auto &slot : slots) {
+		size += slot.size;
+	}
+	return size;
+}
+
+/**
+ * Walk the passes backwards, keeping only those that write something a later live pass reads (or that's exported)
+ */
+void RenderGraph::cull_passes() {
+	std::vector<bool> needed(resources.size());
+	for (size_t i = 0; i < resources.size(); i++) {
+		needed[i] = resources[i].exported;
+	}
+
+	for (auto pass = passes.rbegin(); pass != passes.rend(); pass++) {
+		pass->live = pass->side_effects;
+		for (auto &[resource, access] : pass->images) {
+			pass->live = pass->live || (access.writes() && needed[resource]);
+		}
+		if (!pass->live) {
+			continue;
+		}
+		for (auto &[resource, access] : pass->images) {
+			// Anything written before a pure overwrite is dead, unless this pass reads it too
+			if (access.writes() && !access.reads()) {
+				needed[resource] = resources[resource].exported;
+			}
+			if (access.reads()) {
+				needed[resource] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::compute_lifetimes() {
+	for (uint32_t i = 0; i < passes.size(); i++) {
+		if (!passes[i].live) {
+			continue;
+		}
+		for (auto &[resource, access] : passes[i].images) {
+			auto &r = resources[resource];
+			r.first_pass = std::min(r.first_pass, i);
+			r.last_pass = std::max(r.last_pass, i);
+		}
+	}
+}
+
+/**
+ * Give each transient image memory, sharing it between images that are never alive at the same time.
+ * Nothing is reallocated while the transient images and their lifetimes match the last compile.
+ */
+void RenderGraph::allocate_transients() {
+	std::vector<TransientImage> wanted;
+	std::vector<RenderResource> owners;
+	for (RenderResource i = 0; i < resources.size(); i++) {
+		auto &r = resources[i];
+		if (r.transient && r.first_pass != UINT32_MAX) {
+			wanted.push_back({.desc = r.desc, .lifetime = {r.first_pass, r.last_pass}});
+			owners.push_back(i);
+		}
+	}
+
+	bool unchanged = wanted.size() == transients.size();
+	for (size_t i = 0; unchanged && i < wanted.size(); i++) {
+		unchanged = wanted[i].desc == transients[i].desc && wanted[i].lifetime == transients[i].lifetime;
+	}
+
+	if (!unchanged) {
+		release_transients();
+		transients = std::move(wanted);
+
+		std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+		std::vector<VkMemoryRequirements> requirements;
+		for (auto &transient : transients) {
+			lifetimes.push_back(transient.lifetime);
+			if (!ctx) {
+				// Planning only, so estimate
+				requirements.push_back({
+					.size = (VkDeviceSize)transient.desc.extent.width * transient.desc.extent.height * 4,
+					.alignment = 1,
+					.memoryTypeBits = ~0u,
+				});
+				continue;
+			}
+
+			VkImageCreateInfo image_info{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+				// Aliased memory means the image may be reused with different contents
+				.flags = VK_IMAGE_CREATE_ALIAS_BIT,
+				.imageType = VK_IMAGE_TYPE_2D,
+				.format = transient.desc.format,
+				.extent = {transient.desc.extent.width, transient.desc.extent.height, 1},
+				.mipLevels = 1,
+				.arrayLayers = 1,
+				.samples = VK_SAMPLE_COUNT_1_BIT,
+				.tiling = VK_IMAGE_TILING_OPTIMAL,
+				.usage = transient.desc.usage,
+				.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			};
+			if (VK_SUCCESS != vkCreateImage(ctx->device, &image_info, nullptr, &transient.image)) {
+				throw std::runtime_error("Failed to create transient image");
+			}
+			VkMemoryRequirements image_requirements;
+			vkGetImageMemoryRequirements(ctx->device, transient.image, &image_requirements);
+			requirements.push_back(image_requirements);
+		}
+
+		auto assigned = assign_aliases(lifetimes, requirements, slots);
+		for (size_t i = 0; i < transients.size(); i++) {
+			transients[i].alias_slot = assigned[i];
+		}
+
+		if (ctx) {
+			for (auto &slot : slots) {
+				VkMemoryAllocateInfo alloc_info{
+					.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+					.allocationSize = slot.size,
+					.memoryTypeIndex =
+						ctx->find_memory_type(slot.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+				};
+				VkDeviceMemory memory;
+				if (VK_SUCCESS != vkAllocateMemory(ctx->device, &alloc_info, nullptr, &memory)) {
+					throw std::runtime_error("Failed to allocate transient image memory");
+				}
+				slot_memory.push_back(memory);
+			}
+			for (auto &transient : transients) {
+				vkBindImageMemory(ctx->device, transient.image, slot_memory[transient.alias_slot], 0);
+				VkImageViewCreateInfo view_info{
+					.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+					.image = transient.image,
+					.viewType = VK_IMAGE_VIEW_TYPE_2D,
+					.format = transient.desc.format,
+					.subresourceRange = {aspect_for(transient.desc.format), 0, 1, 0, 1},
+				};
+				if (VK_SUCCESS != vkCreateImageView(ctx->device, &view_info, nullptr, &transient.view)) {
+					throw std::runtime_error("Failed to create transient image view");
+				}
+			}
+
+			VkDeviceSize total = 0;
+			for (auto &requirement : requirements) {
+				total += requirement.size;
+			}
+			LOG_INFO(
+				"Render graph: %zu transient images in %zu allocations, %llu KiB (%llu KiB without aliasing)",
+				transients.size(), slots.size(), (unsigned long long)transient_memory_size() / 1024,
+				(unsigned long long)total / 1024
+			);
+		}
+	}
+
+	for (size_t i = 0; i < transients.size(); i++) {
+		auto &r = resources[owners[i]];
+		r.image = transients[i].image;
+		r.view = transients[i].view;
+		r.alias_slot = transients[i].alias_slot;
+	}
+}
+
+/**
+ * Greedily pack images into as few memory slots as possible, largest first. Images share a slot only if their
+ * [first, last] pass ranges don't overlap and a memory type suits them all. Returns the slot for each image.
+ */
+std::vector<uint32_t> RenderGraph::assign_aliases(
+	const std::vector<std::pair<uint32_t, uint32_t>> &lifetimes, const std::vector<VkMemoryRequirements> &requirements,
+	std::vector<VkMemoryRequirements> &slots
+) {
+	std::vector<uint32_t> order(lifetimes.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return requirements[a].size > requirements[b].size;
+	});
+
+	slots.clear();
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> occupants;
+	std::vector<uint32_t> assigned(lifetimes.size());
+	for (auto i : order) {
+		auto &lifetime = lifetimes[i];
+		auto &requirement = requirements[i];
+		uint32_t slot = 0;
+		for (; slot < slots.size(); slot++) {
+			if (!(slots[slot].memoryTypeBits & requirement.memoryTypeBits)) {
+				continue;
+			}
+			bool overlaps = false;
+			for (auto &other : occupants[slot]) {
+				overlaps = overlaps || (lifetime.first <= other.second && other.first <= lifetime.second);
+			}
+			if (!overlaps) {
+				break;
+			}
+		}
+
+		if (slot == slots.size()) {
+			slots.push_back({.size = 0, .alignment = 1, .memoryTypeBits = requirement.memoryTypeBits});
+			occupants.emplace_back();
+		}
+		slots[slot].size = std::max(slots[slot].size, requirement.size);
+		slots[slot].alignment = std::max(slots[slot].alignment, requirement.alignment);
+		slots[slot].memoryTypeBits &= requirement.memoryTypeBits;
+		occupants[slot].push_back(lifetime);
+		assigned[i] = slot;
+	}
+	return assigned;
+}
+
+/**
+ * Track each image's layout and last accesses through the live passes, recording the barrier needed before each use
+ */
+void RenderGraph::build_barriers() {
+	struct Tracker {
+		VkImageLayout layout;
+		VkPipelineStageFlags2 write_stages;
+		VkAccessFlags2 write_access;
+		// Readers since the last write, which a later write has to wait for
+		VkPipelineStageFlags2 read_stages;
+		// Stages the last write has already been made visible to
+		VkPipelineStageFlags2 visible_stages;
+	};
+
+	std::vector<Tracker> trackers;
+	for (auto &resource : resources) {
+		auto &state = resource.initial_state;
+		bool written = (state.access & WRITE_ACCESS) != 0;
+		trackers.push_back({
+			.layout = state.layout,
+			.write_stages = written ? state.stages : VK_PIPELINE_STAGE_2_NONE,
+			.write_access = state.access & WRITE_ACCESS,
+			.read_stages = written ? VK_PIPELINE_STAGE_2_NONE : state.stages,
+			.visible_stages = VK_PIPELINE_STAGE_2_NONE,
+		});
+	}
+
+	for (auto &pass : passes) {
+		pass.barriers.clear();
+		if (!pass.live) {
+			continue;
+		}
+		for (auto &[resource, access] : pass.images) {
+			auto &t = trackers[resource];
+			auto layout = access.layout == VK_IMAGE_LAYOUT_UNDEFINED ? t.layout : access.layout;
+			bool transition = layout != t.layout;
+
+			if (access.writes() || transition) {
+				// Write after read/write, or a layout change, which acts like a write
+				ImageState src{t.layout, t.write_stages | t.read_stages, t.write_access};
+				if (src.stages != VK_PIPELINE_STAGE_2_NONE || transition) {
+					pass.barriers.push_back({resource, src, {layout, access.stages, access.access}});
+				}
+				t.write_stages = access.stages;
+				t.write_access = access.access & WRITE_ACCESS;
+				t.read_stages = VK_PIPELINE_STAGE_2_NONE;
+				// A layout change is visible to the stages its barrier waits with, but this pass's own writes aren't
+				// visible to anything yet, even later uses at the same stages
+				t.visible_stages = access.writes() ? VK_PIPELINE_STAGE_2_NONE : access.stages;
+			}
+			else if (t.write_stages != VK_PIPELINE_STAGE_2_NONE && (access.stages & ~t.visible_stages)) {
+				// Read after write, by stages that haven't seen it yet
+				pass.barriers.push_back({
+					resource,
+					{t.layout, t.write_stages, t.write_access},
+					{layout, access.stages, access.access},
+				});
+				t.visible_stages |= access.stages;
+			}
+
+			if (access.reads() && !access.writes()) {
+				t.read_stages |= access.stages;
+			}
+			t.layout = access.final_layout == VK_IMAGE_LAYOUT_UNDEFINED ? layout : access.final_layout;
+		}
+	}
+
+	for (size_t i = 0; i < resources.size(); i++) {
+		auto &t = trackers[i];
+		resources[i].final_state = {t.layout, t.write_stages | t.read_stages, t.write_access};
+	}
+}
+
+void RenderGraph::release_transients() {
+	if (!ctx || transients.empty()) {
+		transients.clear();
+		slots.clear();
+		return;
+	}
+	// Earlier frames may still be using them
+	vkDeviceWaitIdle(ctx->device);
+	for (auto &transient : transients) {
+		vkDestroyImageView(ctx->device, transient.view, nullptr);
+		vkDestroyImage(ctx->device, transient.image, nullptr);
+	}
+	for (auto memory : slot_memory) {
+		vkFreeMemory(ctx->device, memory, nullptr);
+	}
+	transients.clear();
+	slot_memory.clear();
+	slots.clear();
+}
@@ -2,45 +2,218 @@
 #include "include/plonk/renderer.h"
 #include "include/plonk/camera.h"
 #include "include/plonk/math.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
+#include "include/plonk/scene_sdf.h"
 #include <GLFW/glfw3.h>
 #include <fstream>
-#include <iostream>
 #include <optional>
 #include <vector>
 
-struct SimplePushConstants {
-	float screen_size[2];
-	float _pad0[2];
-	Point3 position;
-	float _pad1[1];
-	Point3 direction;
-	float time;
-};
-
-Renderer::Renderer(ContextPtr ctx) : ctx(ctx) {
-	std::cout << "Creating Renderer\n";
+// Fine enough that the box's edges and corners stay sharp
+static const float BRICK_VOXEL_SIZE = 0.125;
+
+Renderer::Renderer(ContextPtr ctx, std::shared_ptr<JobSystem> jobs) : ctx(ctx), jobs(jobs) {
+	LOG_DEBUG("Creating Renderer");
+	if (!this->jobs) {
+		this->jobs = std::make_shared<JobSystem>();
+	}
+	recorder = std::make_unique<CommandRecorder>(ctx, this->jobs);
+	graph = std::make_unique<RenderGraph>(ctx);
 	started_at = std::chrono::high_resolution_clock::now();
-	vert_shader = ctx->load_shader("shaders/simple.vert.spv");
-	frag_shader = ctx->load_shader("shaders/simple.frag.spv");
-	create_pipeline();
+
+	// Pipelines compile on workers, alongside each other and the swapchain. Everything else records or submits
+	// through the context's command pool, so stays on this thread.
+	auto &startup = ctx->get_startup();
+	auto &timer = ctx->get_startup_timer();
+	try {
+		timer.time("Brick map", [&]() {
+			auto [min, max] = SceneSdf::static_bounds();
+			brick_map = std::make_unique<BrickMap>(min, max, BRICK_VOXEL_SIZE, SceneSdf::static_distances);
+			brick_map->bake(this->jobs.get());
+			brick_textures = std::make_unique<BrickMapTextures>(ctx);
+			brick_textures->upload(*brick_map);
+			auto stats = brick_map->get_stats();
+			LOG_DEBUG("Baked %u bricks over %u cells", stats.bricks, stats.cells);
+		});
+		timer.time("Step heatmap", [&]() {
+			step_heatmap = std::make_unique<StepHeatmap>(ctx, &startup);
+			step_heatmap->resize(ctx->size());
+		});
+		timer.time("Shadow pass", [&]() {
+			shadow_pass = std::make_unique<ShadowPass>(
+				ctx, step_heatmap->get_descriptor_set_layout(), brick_textures->get_descriptor_set_layout(), &startup
+			);
+			shadow_pass->resize(ctx->size());
+		});
+		startup.run("Shading pipeline", [this]() {
+			auto vert = this->ctx->load_shader("simple.vert");
+			auto frag = this->ctx->load_shader("simple.frag");
+			vert_shader = this->ctx->get_resources().add(vert);
+			frag_shader = this->ctx->get_resources().add(frag);
+			create_pipeline(vert, frag);
+		});
+		timer.time("Profiler", [&]() { profiler = std::make_unique<Profiler>(ctx); });
+	}
+	catch (...) {
+		startup.drain();
+		throw;
+	}
+	ctx->finish_startup();
+
+	graph->on_pass_begin = [this](VkCommandBuffer command_buffer, const std::string &name) {
+		profiler->begin_scope(command_buffer, name);
+	};
+	graph->on_pass_end = [this](VkCommandBuffer command_buffer, const std::string &) {
+		profiler->end_scope(command_buffer);
+	};
 }
 
 void Renderer::draw(Camera &camera) {
+	auto duration = std::chrono::high_resolution_clock::now() - started_at;
+	draw(camera, duration.count() / 1e9);
+}
+
+/**
+ * Draw the scene as it is `time` seconds in, for deterministic offline renders
+ */
+void Renderer::draw(Camera &camera, float time) {
+	TRACE_FUNCTION();
+	last_time = time;
 	handle_resize();
+	if (reloader) {
+		reloader->apply();
+	}
+	// Picks up rebakes since the last frame
+	brick_textures->upload(*brick_map);
 
 	auto frame = ctx->aquire_frame();
-	record_commands(camera);
+	auto &command_buffer = ctx->command_buffer;
+	recorder->begin_frame(ctx->frame_slot());
+	auto constants = build_push_constants(camera, time);
+	if (capture) {
+		capture->begin_frame();
+	}
+
+	profiler->begin_frame(command_buffer);
+	step_heatmap->begin_frame(command_buffer);
+	build_graph(frame, constants);
+	graph->compile();
+	graph->execute(command_buffer);
 	frame.present();
 }
 
+/**
+ * Declare this frame's passes. They record straight away when the graph executes, so capturing locals is fine.
+ */
+void Renderer::build_graph(Frame &frame, SimplePushConstants &constants) {
+	TRACE_FUNCTION();
+	graph->reset();
+
+	// Waited on by the acquire semaphore at colour output
+	auto output = graph->import_image(
+		"output", ctx->get_swapchain_image(frame.get_index()),
+		{VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE}, true
+	);
+	// Both visibility buffers were last sampled by the previous frame
+	ImageState sampled_state{
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_NONE
+	};
+	auto history = graph->import_image("shadow history", shadow_pass->get_history_image(), sampled_state);
+	auto visibility = graph->import_image("shadow visibility", shadow_pass->get_target_image(), sampled_state);
+
+	// The shadow pass writes its step counts and the shading pass reads them for the heatmap, after last frame's stats
+	// pass has read them
+	std::vector<std::pair<RenderResource, BufferAccess>> shadow_buffers, shading_buffers;
+	if (step_heatmap->is_enabled()) {
+		auto step_counts = graph->import_buffer(
+			"step counts", step_heatmap->get_counts_buffer(),
+			{VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE}
+		);
+		shadow_buffers.push_back({step_counts, BufferAccess::storage_write()});
+		shading_buffers.push_back({step_counts, BufferAccess::storage()});
+	}
+
+	graph->add_pass(
+		"shadow",
+		{
+			{history, ImageAccess::sampled()},
+			{visibility, ImageAccess::color_attachment(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)},
+		},
+		shadow_buffers,
+		[&](VkCommandBuffer command_buffer) {
+			shadow_pass->record(
+				command_buffer, constants, step_heatmap->get_descriptor_set(), brick_textures->get_descriptor_set()
+			);
+		}
+	);
+
+	graph->add_pass(
+		"shading",
+		{
+			{visibility, ImageAccess::sampled()},
+			{output, ImageAccess::color_attachment(ctx->output_layout())},
+		},
+		shading_buffers,
+		[&](VkCommandBuffer command_buffer) {
+			frame.begin_render_pass(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			record_shading(constants);
+			recorder->execute(
+				command_buffer, ctx->get_render_pass(), ctx->get_framebuffer(frame.get_index()), ctx->format()
+			);
+			frame.end_render_pass();
+		}
+	);
+
+	// Step counts live in a buffer that StepHeatmap synchronises itself, so this is only kept while it's wanted
+	graph->add_pass(
+		"step stats", {},
+		[&](VkCommandBuffer command_buffer) { step_heatmap->record_stats(command_buffer, shadow_pass->size()); },
+		step_heatmap->is_enabled()
+	);
+
+	if (capture) {
+		graph->add_pass(
+			"capture", {{output, ImageAccess::transfer_read(ctx->output_layout())}},
+			[&](VkCommandBuffer command_buffer) {
+				capture->record(
+					command_buffer, ctx->get_swapchain_image(frame.get_index()), ctx->output_layout(), ctx->size(),
+					ctx->format()
+				);
+			},
+			true
+		);
+	}
+}
+
+void Renderer::start_capture(const std::string &directory, CaptureFormat format) {
+	capture = std::make_unique<FrameCapture>(ctx, directory, format);
+}
+
+/**
+ * Stop capturing, blocking until every captured frame has been written
+ */
+void Renderer::stop_capture() {
+	capture.reset();
+}
+
 void Renderer::handle_resize() {
 	if (ctx->needs_resize()) {
 		ctx->update_swapchain();
 	}
+	if (step_heatmap->needs_resize(ctx->size())) {
+		step_heatmap->resize(ctx->size());
+	}
+	if (shadow_pass->needs_resize(ctx->size())) {
+		shadow_pass->resize(ctx->size());
+	}
 }
 
-void Renderer::create_pipeline() {
-	std::cout << "Creating Pipeline\n";
+/**
+ * Takes the shaders directly, as other pipelines may be registering theirs at the same time during startup
+ */
+void Renderer::create_pipeline(VkShaderModule vert, VkShaderModule frag) {
+	LOG_DEBUG("Creating Pipeline");
 
 	VkPushConstantRange push_constant_range{
 		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -48,151 +221,86 @@ void Renderer::create_pipeline() {
 		.size = sizeof(SimplePushConstants),
 	};
 
+	VkDescriptorSetLayout set_layouts[] = {
+		shadow_pass->get_descriptor_set_layout(),
+		step_heatmap->get_descriptor_set_layout(),
+		brick_textures->get_descriptor_set_layout(),
+	};
 	VkPipelineLayoutCreateInfo pipeline_layout_info{
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-		.setLayoutCount = 0,
-		.pSetLayouts = nullptr,
+		.setLayoutCount = 3,
+		.pSetLayouts = set_layouts,
 		.pushConstantRangeCount = 1,
 		.pPushConstantRanges = &push_constant_range,
 	};
 
-	if (VK_SUCCESS != vkCreatePipelineLayout(ctx->device, &pipeline_layout_info, nullptr, &pipeline_layout)) {
+	VkPipelineLayout layout;
+	if (VK_SUCCESS != vkCreatePipelineLayout(ctx->device, &pipeline_layout_info, nullptr, &layout)) {
 		throw std::runtime_error("Failed to create Pipeline Layout");
 	}
+	auto &resources = ctx->get_resources();
+	pipeline_layout = resources.add(layout);
+	pipeline = resources.add(ctx->create_fullscreen_pipeline(vert, frag, layout));
 
-	VkViewport viewport{
-		.x = 0.0f,
-		.y = 0.0f,
-		.width = ctx->width(),
-		.height = ctx->height(),
-		.minDepth = 0.0f,
-		.maxDepth = 1.0f,
-	};
-
-	VkRect2D scissor{
-		.offset = {0, 0},
-		.extent = ctx->size(),
-	};
-
-	VkPipelineViewportStateCreateInfo viewport_state{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-		.viewportCount = 1,
-		.pViewports = &viewport,
-		.scissorCount = 1,
-		.pScissors = &scissor,
-	};
-
-	VkPipelineShaderStageCreateInfo vert_create_info{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		.stage = VK_SHADER_STAGE_VERTEX_BIT,
-		.module = vert_shader,
-		.pName = "main",
-	};
-
-	VkPipelineShaderStageCreateInfo frag_create_info{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-		.module = frag_shader,
-		.pName = "main",
-	};
-
-	VkPipelineShaderStageCreateInfo stages[] = {vert_create_info, frag_create_info};
-
-	VkPipelineInputAssemblyStateCreateInfo input_assembly{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-		.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-		.primitiveRestartEnable = VK_FALSE,
-	};
-
-	VkPipelineVertexInputStateCreateInfo vertex_input_state{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.vertexBindingDescriptionCount = 0,
-		.pVertexBindingDescriptions = nullptr,
-		.vertexAttributeDescriptionCount = 0,
-		.pVertexAttributeDescriptions = nullptr,
-	};
-
-	std::vector<VkDynamicState> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-
-	VkPipelineDynamicStateCreateInfo dynamic_state{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-		.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
-		.pDynamicStates = dynamic_states.data(),
-	};
-
-	VkPipelineRasterizationStateCreateInfo rasterizer_state{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-		.depthClampEnable = VK_FALSE,
-		.rasterizerDiscardEnable = VK_FALSE,
-		.polygonMode = VK_POLYGON_MODE_FILL,
-		.cullMode = VK_CULL_MODE_NONE,
-		.frontFace = VK_FRONT_FACE_CLOCKWISE,
-		.depthBiasEnable = VK_FALSE,
-		.depthBiasConstantFactor = 0.0f,
-		.depthBiasClamp = 0.0f,
-		.depthBiasSlopeFactor = 0.0f,
-		.lineWidth = 1.0f,
-	};
-
-	VkPipelineMultisampleStateCreateInfo multisample_state{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-		.sampleShadingEnable = VK_FALSE,
-		.minSampleShading = 1.0f,
-		.pSampleMask = nullptr,
-		.alphaToCoverageEnable = VK_FALSE,
-		.alphaToOneEnable = VK_FALSE,
-	};
-
-	VkPipelineColorBlendAttachmentState color_blend_attachment{
-		.blendEnable = VK_FALSE,
-		.srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
-		.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-		.colorBlendOp = VK_BLEND_OP_ADD,
-		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-		.alphaBlendOp = VK_BLEND_OP_ADD,
-		.colorWriteMask =
-			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-	};
+	LOG_DEBUG("Created Pipeline");
+}
 
-	VkPipelineColorBlendStateCreateInfo color_blend_state{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-		.logicOpEnable = VK_FALSE,
-		.logicOp = VK_LOGIC_OP_COPY,
-		.attachmentCount = 1,
-		.pAttachments = &color_blend_attachment,
-		.blendConstants = {0.0, 0.0, 0.0, 0.0},
-	};
+/**
+ * Rebuild pipelines whenever their GLSL in `source_dir` changes, for iterating on shaders without restarting
+ */
+void Renderer::watch_shaders(const std::string &source_dir) {
+	// Only kept once everything's watched, so a failure leaves no half set up reloader behind
+	auto watcher = std::make_unique<ShaderReloader>(ctx, source_dir);
+	// Builds on the watcher thread, which mustn't look handles up while the render thread changes them
+	auto layout = ctx->get_resources().get(pipeline_layout);
+	watcher->watch({"simple.vert", "simple.frag"}, [this, layout](const std::vector<VkShaderModule> &modules) {
+		return ctx->create_fullscreen_pipeline(modules[0], modules[1], layout);
+	}, pipeline);
+	shadow_pass->watch_shaders(*watcher);
+	reloader = std::move(watcher);
+}
 
-	VkGraphicsPipelineCreateInfo pipeline_info{
-		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-		.stageCount = 2,
-		.pStages = stages,
-		.pVertexInputState = &vertex_input_state,
-		.pInputAssemblyState = &input_assembly,
-		.pViewportState = &viewport_state,
-		.pRasterizationState = &rasterizer_state,
-		.pMultisampleState = &multisample_state,
-		.pDepthStencilState = nullptr,
-		.pColorBlendState = &color_blend_state,
-		.pDynamicState = &dynamic_state,
-		.layout = pipeline_layout,
-		.renderPass = nullptr,
-		.subpass = 0,
-		.basePipelineHandle = VK_NULL_HANDLE,
-		.basePipelineIndex = -1,
+SimplePushConstants Renderer::build_push_constants(Camera &camera, float time) {
+	return SimplePushConstants{
+		.screen_size = {ctx->width(), ctx->height()},
+		.position = {camera.position.coords[0], camera.position.coords[1], camera.position.coords[2]},
+		.direction = {camera.direction.coords[0], camera.direction.coords[1], camera.direction.coords[2]},
+		.time = time,
+		.debug_mode = (uint32_t)(step_heatmap->is_enabled() ? step_heatmap->mode : StepDebugMode::OFF),
 	};
+}
 
-	pipeline = ctx->create_graphics_pipeline(&pipeline_info);
-
-	std::cout << "Created Pipeline\n";
+/**
+ * Queue the main pass on the command recorder, split into bands that are recorded in parallel
+ */
+void Renderer::record_shading(SimplePushConstants &constants) {
+	TRACE_FUNCTION();
+	auto extent = ctx->size();
+	for (uint32_t band = 0; band < SHADING_BANDS; band++) {
+		int32_t top = extent.height * band / SHADING_BANDS;
+		int32_t bottom = extent.height * (band + 1) / SHADING_BANDS;
+		VkRect2D scissor{
+			.offset = {0, top},
+			.extent = {extent.width, (uint32_t)(bottom - top)},
+		};
+		recorder->add([this, constants, scissor](VkCommandBuffer command_buffer) {
+			record_commands(command_buffer, constants, scissor);
+		});
+	}
 }
 
-void Renderer::record_commands(Camera &camera) {
-	ctx->bind_pipeline(pipeline);
+void Renderer::record_commands(VkCommandBuffer command_buffer, const SimplePushConstants &constants, VkRect2D scissor) {
+	TRACE_FUNCTION();
+	auto &resources = ctx->get_resources();
+	auto layout = resources.get(pipeline_layout);
+	ctx->vk.CmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resources.get(pipeline));
 
-	auto &command_buffer = ctx->command_buffer;
+	VkDescriptorSet sets[] = {
+		shadow_pass->get_visibility_descriptor_set(),
+		step_heatmap->get_descriptor_set(),
+		brick_textures->get_descriptor_set(),
+	};
+	ctx->vk.CmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 3, sets, 0, nullptr);
 
 	VkViewport viewport{
 		.x = 0.0f,
@@ -202,30 +310,22 @@ void Renderer::record_commands(Camera &camera) {
 		.minDepth = 0.0f,
 		.maxDepth = 1.0f,
 	};
-	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
-
-	VkRect2D scissor{
-		.offset = {0, 0},
-		.extent = ctx->size(),
-	};
-	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+	ctx->vk.CmdSetViewport(command_buffer, 0, 1, &viewport);
+	ctx->vk.CmdSetScissor(command_buffer, 0, 1, &scissor);
 
-	auto now = std::chrono::high_resolution_clock::now();
-	auto duration = now - started_at;
-	float time = duration.count() / 1e9;
-	SimplePushConstants constants{
-		.screen_size = {viewport.width, viewport.height},
-		.position = {camera.position.coords[0], camera.position.coords[1], camera.position.coords[2]},
-		.direction = {camera.direction.coords[0], camera.direction.coords[1], camera.direction.coords[2]},
-		.time = time,
-	};
-	vkCmdPushConstants(command_buffer, pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstants), &constants);
-	vkCmdDraw(command_buffer, 6, 1, 0, 0);
+	ctx->vk.CmdPushConstants(command_buffer, layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstants), &constants);
+	ctx->vk.CmdDraw(command_buffer, 6, 1, 0, 0);
 }
 
 Renderer::~Renderer() {
-	vkDestroyPipeline(ctx->device, pipeline, nullptr);
-	vkDestroyPipelineLayout(ctx->device, pipeline_layout, nullptr);
-	ctx->destroy_shader(vert_shader);
-	ctx->destroy_shader(frag_shader);
+	reloader.reset();
+	capture.reset();
+	recorder.reset();
+	graph.reset();
+	vkDeviceWaitIdle(ctx->device);
+	auto &resources = ctx->get_resources();
+	resources.remove(pipeline);
+	resources.remove(pipeline_layout);
+	resources.remove(vert_shader);
+	resources.remove(frag_shader);
 }
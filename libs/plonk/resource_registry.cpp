@@ -0,0 +1,70 @@
+#include "include/plonk/resource_registry.h"
+#include <algorithm>
+
+ResourceRegistry::ResourceRegistry(VkDevice device, SubmitScheduler &scheduler) : device(device), scheduler(scheduler) {}
+
+ResourceRegistry::~ResourceRegistry() {
+	destroy_all();
+}
+
+/**
+ * Destroy replaced and removed objects whose frames have finished. Call between frames.
+ */
+void ResourceRegistry::collect() {
+	std::lock_guard<std::mutex> lock(mutex);
+	collect(pipelines, false);
+	collect(pipeline_layouts, false);
+	collect(shaders, false);
+}
+
+/**
+ * Destroy every object, live or retired, invalidating every handle. The device must be idle.
+ */
+void ResourceRegistry::destroy_all() {
+	std::lock_guard<std::mutex> lock(mutex);
+	// Pipelines before the layouts they were built with
+	collect(pipelines, true);
+	for (auto pipeline : pipelines.objects) {
+		destroy(pipeline);
+	}
+	pipelines.objects.clear();
+	collect(pipeline_layouts, true);
+	for (auto layout : pipeline_layouts.objects) {
+		destroy(layout);
+	}
+	pipeline_layouts.objects.clear();
+	collect(shaders, true);
+	for (auto shader : shaders.objects) {
+		destroy(shader);
+	}
+	shaders.objects.clear();
+}
+
+size_t ResourceRegistry::size() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pipelines.objects.size() + pipeline_layouts.objects.size() + shaders.objects.size();
+}
+
+template <typename T>
+void ResourceRegistry::collect(Pool<T> &kind, bool all) {
+	auto end = std::remove_if(kind.retired.begin(), kind.retired.end(), [&](auto &entry) {
+		if (!all && !scheduler.is_complete(entry.second)) {
+			return false;
+		}
+		destroy(entry.first);
+		return true;
+	});
+	kind.retired.erase(end, kind.retired.end());
+}
+
+void ResourceRegistry::destroy(VkPipeline pipeline) {
+	vkDestroyPipeline(device, pipeline, nullptr);
+}
+
+void ResourceRegistry::destroy(VkPipelineLayout layout) {
+	vkDestroyPipelineLayout(device, layout, nullptr);
+}
+
+void ResourceRegistry::destroy(VkShaderModule shader) {
+	vkDestroyShaderModule(device, shader, nullptr);
+}
@@ -0,0 +1,230 @@
+#include "include/plonk/scene_file.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/transforms.h"
+#include <bit>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+static_assert(std::endian::native == std::endian::little, "Scene files are little endian and read in place");
+
+static uint64_t align_section(uint64_t offset) {
+	return (offset + SceneFile::SECTION_ALIGNMENT - 1) & ~(SceneFile::SECTION_ALIGNMENT - 1);
+}
+
+SceneDescription SceneDescription::load(const std::string &filename) {
+	std::ifstream file(filename);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open scene: " + filename);
+	}
+	return parse(file);
+}
+
+SceneDescription SceneDescription::parse(std::istream &input) {
+	SceneDescription scene;
+	std::unordered_map<std::string, uint32_t> material_names;
+	std::unordered_map<std::string, uint32_t> transform_names;
+	TransformHierarchy hierarchy;
+	std::vector<TransformHandle> nodes;
+
+	std::string line;
+	int line_number = 0;
+	auto fail = [&](const std::string &message) {
+		throw std::runtime_error(message + " on line " + std::to_string(line_number));
+	};
+	auto find = [&](std::unordered_map<std::string, uint32_t> &names, const std::string &name, const char *kind) {
+		auto found = names.find(name);
+		if (found == names.end()) {
+			fail("Unknown " + std::string(kind) + " '" + name + "'");
+		}
+		return found->second;
+	};
+
+	while (std::getline(input, line)) {
+		line_number++;
+		auto start = line.find_first_not_of(" \t\r");
+		if (start == std::string::npos || line[start] == '#') {
+			continue;
+		}
+
+		std::istringstream fields(line);
+		std::string kind;
+		fields >> kind;
+		if (kind == "material") {
+			std::string name;
+			float r, g, b;
+			if (!(fields >> name >> r >> g >> b)) {
+				fail("Invalid material");
+			}
+			if (!material_names.emplace(name, scene.materials.size()).second) {
+				fail("Duplicate material '" + name + "'");
+			}
+			scene.materials.push_back({.color = {r, g, b, 1.0}});
+		}
+		else if (kind == "transform") {
+			std::string name, parent;
+			float tx, ty, tz, rx, ry, rz, sx, sy, sz;
+			if (!(fields >> name >> parent >> tx >> ty >> tz >> rx >> ry >> rz >> sx >> sy >> sz)) {
+				fail("Invalid transform");
+			}
+			auto parent_node = parent == "-" ? TransformHandle{} : nodes[find(transform_names, parent, "transform")];
+			if (!transform_names.emplace(name, nodes.size()).second) {
+				fail("Duplicate transform '" + name + "'");
+			}
+			nodes.push_back(hierarchy.add(
+				{
+					.translation = Vector3(tx, ty, tz),
+					.rotation = Vector3(rx, ry, rz),
+					.scale = Vector3(sx, sy, sz),
+				},
+				parent_node
+			));
+		}
+		else if (kind == "sphere" || kind == "box") {
+			std::string material, transform;
+			ScenePrimitive primitive{};
+			if (!(fields >> material >> transform >> primitive.blend)) {
+				fail("Invalid " + kind);
+			}
+			primitive.material = find(material_names, material, "material");
+			primitive.transform =
+				transform == "-" ? ScenePrimitive::NO_TRANSFORM : find(transform_names, transform, "transform");
+			if (kind == "sphere") {
+				primitive.type = PrimitiveType::SPHERE;
+				if (!(fields >> primitive.size[0])) {
+					fail("Invalid sphere");
+				}
+			}
+			else {
+				primitive.type = PrimitiveType::BOX;
+				if (!(fields >> primitive.size[0] >> primitive.size[1] >> primitive.size[2])) {
+					fail("Invalid box");
+				}
+			}
+			scene.primitives.push_back(primitive);
+		}
+		else {
+			fail("Unknown scene item '" + kind + "'");
+		}
+	}
+
+	if (scene.primitives.empty()) {
+		throw std::runtime_error("Scene has no primitives");
+	}
+
+	hierarchy.update();
+	for (auto node : nodes) {
+		auto inverse = hierarchy.get_world(node).inverse();
+		if (!inverse) {
+			throw std::runtime_error("Scene transform has zero scale");
+		}
+		SceneTransform transform;
+		for (int i = 0; i < 16; i++) {
+			transform.world_to_local[i] = (*inverse)[i];
+		}
+		scene.transforms.push_back(transform);
+	}
+	return scene;
+}
+
+/**
+ * Write the scene as a binary scene file, to be opened with SceneFile
+ */
+void SceneDescription::write(const std::string &filename) const {
+	SceneFileHeader header{.version = SceneFile::VERSION};
+	std::memcpy(header.magic, SceneFile::MAGIC, sizeof(header.magic));
+	uint64_t offset = sizeof(header);
+	auto place = [&](SceneSection &section, size_t count, size_t stride) {
+		if (count > UINT32_MAX) {
+			throw std::runtime_error("Too many items in scene section");
+		}
+		offset = align_section(offset);
+		section = {.offset = offset, .count = (uint32_t)count, .stride = (uint32_t)stride};
+		offset += count * stride;
+	};
+	place(header.primitives, primitives.size(), sizeof(ScenePrimitive));
+	place(header.materials, materials.size(), sizeof(SceneMaterial));
+	place(header.transforms, transforms.size(), sizeof(SceneTransform));
+	header.file_size = offset;
+
+	// Assembled in memory so the padding is zeroed and the file goes out in one write
+	std::vector<uint8_t> bytes(header.file_size, 0);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+	std::memcpy(bytes.data() + header.primitives.offset, primitives.data(), primitives.size() * sizeof(ScenePrimitive));
+	std::memcpy(bytes.data() + header.materials.offset, materials.data(), materials.size() * sizeof(SceneMaterial));
+	std::memcpy(bytes.data() + header.transforms.offset, transforms.data(), transforms.size() * sizeof(SceneTransform));
+
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open scene for writing: " + filename);
+	}
+	file.write((const char *)bytes.data(), bytes.size());
+	if (!file) {
+		throw std::runtime_error("Failed to write scene: " + filename);
+	}
+}
+
+SceneFile::SceneFile(const std::string &filename) {
+	TRACE_FUNCTION();
+	int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open scene: " + filename);
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(SceneFileHeader)) {
+		close(fd);
+		throw std::runtime_error("Not a scene file: " + filename);
+	}
+	length = info.st_size;
+	void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps the file open
+	close(fd);
+	if (address == MAP_FAILED) {
+		throw std::runtime_error("Failed to map scene: " + filename);
+	}
+	mapped = (const uint8_t *)address;
+
+	try {
+		validate(filename);
+	}
+	catch (...) {
+		munmap((void *)mapped, length);
+		throw;
+	}
+}
+
+SceneFile::~SceneFile() {
+	munmap((void *)mapped, length);
+}
+
+void SceneFile::validate(const std::string &filename) const {
+	auto &header = get_header();
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+		throw std::runtime_error("Not a scene file: " + filename);
+	}
+	if (header.version != VERSION) {
+		throw std::runtime_error(
+			"Unsupported scene file version " + std::to_string(header.version) + " (expected " +
+			std::to_string(VERSION) + "): " + filename
+		);
+	}
+	if (header.file_size != length) {
+		throw std::runtime_error("Scene file is the wrong size for its header: " + filename);
+	}
+
+	auto check = [&](const SceneSection &section, size_t stride, const char *name) {
+		bool fits = section.offset <= length && (uint64_t)section.count * stride <= length - section.offset;
+		if (section.offset % SECTION_ALIGNMENT != 0 || section.stride != stride || !fits) {
+			throw std::runtime_error("Corrupt " + std::string(name) + " section in scene: " + filename);
+		}
+	};
+	check(header.primitives, sizeof(ScenePrimitive), "primitive");
+	check(header.materials, sizeof(SceneMaterial), "material");
+	check(header.transforms, sizeof(SceneTransform), "transform");
+}
@@ -0,0 +1,238 @@
+#include "include/plonk/scene_sdf.h"
+
+static FloatV sdf_sphere(const Vector3V &p, float rad) {
+	return p.length() - rad;
+}
+
+static FloatV sdf_box(const Vector3V &p, float size) {
+	Vector3V q = p.abs() - Vector3V(Vector3(size, size, size));
+	Vector3V outside(max(q.x, splat(0.0)), max(q.y, splat(0.0)), max(q.z, splat(0.0)));
+	return outside.length() + min(max(q.x, max(q.y, q.z)), splat(0.0));
+}
+
+static FloatV op_smooth(FloatV d0, FloatV d1, float k) {
+	return clamp(0.5f + 0.5f * (d1 - d0) / k, 0.0, 1.0);
+}
+
+static FloatV op_smooth_union(FloatV d0, FloatV d1, float k) {
+	FloatV h = op_smooth(d0, d1, k);
+	return mix(d1, d0, h) - k * h * (1.0f - h);
+}
+
+static FloatV static_distance(const Vector3V &p) {
+	Vector3V box_pos(Vector3(0.0, 5.0, 12.0));
+	return sdf_box(p - box_pos, 4.0);
+}
+
+template <typename F>
+static void batch_distances(const float *x, const float *y, const float *z, float *out, size_t count, F distance) {
+	for (size_t i = 0; i < count; i += SIMD_LANES) {
+		size_t lanes = std::min(count - i, (size_t)SIMD_LANES);
+		Vector3V p;
+		for (size_t lane = 0; lane < lanes; lane++) {
+			p.x[lane] = x[i + lane];
+			p.y[lane] = y[i + lane];
+			p.z[lane] = z[i + lane];
+		}
+		FloatV d = distance(p);
+		for (size_t lane = 0; lane < lanes; lane++) {
+			out[i + lane] = d[lane];
+		}
+	}
+}
+
+DistanceResultV SceneSdf::get_distance(const Vector3V &p) const {
+	Vector3V ball_pos(Vector3(std::sin(time) * 15.0, 5.0, 12.0));
+	FloatV ball_dist = sdf_sphere(p - ball_pos, 5.0);
+	FloatV box_dist = static_distance(p);
+
+	FloatV d = op_smooth(ball_dist, box_dist, 5.0);
+	Vector3V box_color(Vector3(0.3, 0.9, 0.1));
+	Vector3V ball_color(Vector3(1.0, 0.1, 0.2));
+	return {
+		.d = op_smooth_union(ball_dist, box_dist, 5.0),
+		.color = mix(box_color, ball_color, d),
+	};
+}
+
+/**
+ * March every active lane until it hits a surface, escapes, or runs out of steps.
+ * Lanes finish independently, the packet keeps going until the last one is done.
+ */
+DistanceResultV SceneSdf::ray_march(const Vector3V &ro, const Vector3V &rd, MaskV active, MaskV &steps) const {
+	FloatV d = splat(0.0);
+	// Too many steps
+	Vector3V color(Vector3(1.0, 0.0, 1.0));
+	Vector3V sky_color(Vector3(0.1, 0.03, 0.2));
+	MaskV running = active;
+	steps = MaskV{} + MAX_STEPS;
+
+	for (int i = 0; i < MAX_STEPS && any(running); i++) {
+		Vector3V p = ro + rd * d;
+		DistanceResultV surface = get_distance(p);
+		d = select(running, d + surface.d, d);
+		steps = select(running, MaskV{} + (i + 1), steps);
+
+		MaskV hit = running & (surface.d < SURFACE_DIST);
+		color = select(hit, surface.color, color);
+		running &= ~hit;
+
+		MaskV escaped = running & (d > MAX_DIST);
+		color = select(escaped, sky_color, color);
+		running &= ~escaped;
+	}
+
+	return {d, color};
+}
+
+Vector3V SceneSdf::calc_normal(const Vector3V &p) const {
+	FloatV d = get_distance(p).d;
+
+	FloatV d0 = get_distance(p - Vector3V(Vector3(SURFACE_DIST, 0.0, 0.0))).d;
+	FloatV d1 = get_distance(p - Vector3V(Vector3(0.0, SURFACE_DIST, 0.0))).d;
+	FloatV d2 = get_distance(p - Vector3V(Vector3(0.0, 0.0, SURFACE_DIST))).d;
+
+	return Vector3V(d - d0, d - d1, d - d2).normalize();
+}
+
+FloatV SceneSdf::shadow_visibility(const Vector3V &p, const Vector3V &n, MaskV active) const {
+	Vector3V light_pos(light_position());
+	Vector3V to_light = light_pos - p;
+	Vector3V light_dir = to_light.normalize();
+
+	MaskV steps;
+	FloatV d = ray_march(p + n * (SURFACE_DIST * 2.0f), light_dir, active, steps).d;
+	return select(d < to_light.length(), splat(0.0), splat(1.0));
+}
+
+/**
+ * Linear colour of the primary rays, matching simple.frag.glsl with full resolution shadows
+ */
+Vector3V SceneSdf::shade(const Vector3V &ro, const Vector3V &rd, MaskV active) const {
+	MaskV steps;
+	DistanceResultV dist = ray_march(ro, rd, active, steps);
+	Vector3V p = ro + rd * dist.d;
+	Vector3V n = calc_normal(p);
+
+	Vector3V light_dir = (Vector3V(light_position()) - p).normalize();
+	FloatV diffusion = clamp(n.dot(light_dir), 0.1, 1.0);
+	FloatV light = mix(splat(0.1), diffusion, shadow_visibility(p, n, active));
+	return dist.color * light;
+}
+
+float SceneSdf::distance(const Point3 &p) const {
+	return get_distance(Vector3V(p)).d[0];
+}
+
+Vector3 SceneSdf::normal(const Point3 &p) const {
+	return calc_normal(Vector3V(p)).lane(0);
+}
+
+/**
+ * Distance to the scene for `count` points given as separate x, y and z arrays
+ */
+void SceneSdf::distances(const float *x, const float *y, const float *z, float *out, size_t count) const {
+	batch_distances(x, y, z, out, count, [this](const Vector3V &p) { return get_distance(p).d; });
+}
+
+/**
+ * Distance to just the scene's static geometry, the box, which the GPU samples from a baked BrickMap instead
+ */
+void SceneSdf::static_distances(const float *x, const float *y, const float *z, float *out, size_t count) {
+	batch_distances(x, y, z, out, count, static_distance);
+}
+
+std::pair<Point3, Point3> SceneSdf::static_bounds() {
+	return {Point3(-4.0, 1.0, 8.0), Point3(4.0, 9.0, 16.0)};
+}
+
+/**
+ * First surface along a ray, e.g. for picking what's under the cursor
+ */
+std::optional<RayHit> SceneSdf::raycast(const Point3 &origin, const Vector3 &direction, float max_distance) const {
+	Vector3 dir = direction.normalize();
+	float t = 0.0;
+	for (int i = 0; i < MAX_STEPS && t <= max_distance; i++) {
+		Point3 p = origin + dir * t;
+		float d = distance(p);
+		if (d < SURFACE_DIST) {
+			return RayHit{
+				.distance = t,
+				.position = p,
+				.normal = normal(p),
+			};
+		}
+		t += d;
+	}
+	return std::nullopt;
+}
+
+/**
+ * Move a sphere from `from` towards `to`, stopping at the first contact and sliding along the surface with whatever
+ * movement is left.
+ *
+ * The path is first sampled `SIMD_LANES` points at a time. Distance fields never change faster than the distance
+ * travelled, so a gap between two samples is clear when their combined distance leaves room for the sphere, and most
+ * moves are settled by that single batch. Otherwise the sphere is advanced conservatively from the last clear sample.
+ */
+Point3 SceneSdf::sweep_sphere(const Point3 &from, const Point3 &to, float radius) const {
+	const float skin = SURFACE_DIST * 2.0;
+	Point3 start = from;
+	Vector3 motion = to - from;
+
+	for (int slide = 0; slide < 3; slide++) {
+		float length = motion.magnitude();
+		if (length < 1e-6) {
+			return start;
+		}
+
+		float start_dist = distance(start);
+		if (start_dist < radius) {
+			// Already touching, only allow moves that don't push further in
+			return distance(start + motion) >= start_dist ? start + motion : start;
+		}
+
+		Vector3V p;
+		FloatV t;
+		for (int i = 0; i < SIMD_LANES; i++) {
+			t[i] = (float)i / (SIMD_LANES - 1);
+			p.set_lane(i, start + motion * t[i]);
+		}
+		FloatV d = get_distance(p).d;
+
+		float gap = length / (SIMD_LANES - 1);
+		float contact = 1.0;
+		bool blocked = false;
+		for (int i = 0; i < SIMD_LANES - 1; i++) {
+			if ((d[i] + d[i + 1] - gap) * 0.5f > radius) {
+				continue;
+			}
+			// Conservative advancement from the last sample known to be clear
+			float s = t[i];
+			for (int step = 0; step < 32 && s < 1.0f; step++) {
+				float clearance = distance(start + motion * s) - radius;
+				if (clearance < skin) {
+					blocked = true;
+					break;
+				}
+				s += clearance / length;
+			}
+			if (blocked) {
+				contact = s;
+				break;
+			}
+		}
+
+		if (!blocked) {
+			return start + motion;
+		}
+
+		// Back off to keep the sphere just out of the surface, then slide the rest of the way along it
+		Point3 hit = start + motion * std::max(0.0f, contact - skin / length);
+		Vector3 n = normal(hit);
+		Vector3 remaining = motion * (1.0f - contact);
+		motion = remaining - n * remaining.dot(n);
+		start = hit;
+	}
+	return start;
+}
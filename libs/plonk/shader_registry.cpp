@@ -0,0 +1,13 @@
+#include "include/plonk/shader_registry.h"
+
+/**
+ * The embedded SPIR-V for `name` (e.g. "simple.frag"), or null if it wasn't built in
+ */
+const EmbeddedShader *find_embedded_shader(const std::string &name) {
+	for (auto shader = EMBEDDED_SHADERS; shader->name; shader++) {
+		if (name == shader->name) {
+			return shader;
+		}
+	}
+	return nullptr;
+}
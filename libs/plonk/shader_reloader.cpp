@@ -0,0 +1,213 @@
+#include "include/plonk/shader_reloader.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <poll.h>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Editors often save with several writes or a rename, so changes this close together are handled as one
+static const int DEBOUNCE_MS = 50;
+
+ShaderReloader::ShaderReloader(ContextPtr ctx, const std::string &source_dir) : ctx(ctx), source_dir(source_dir) {
+	auto env_glslc = std::getenv("PLONK_GLSLC");
+	glslc = env_glslc ? env_glslc : "glslc";
+
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (inotify_fd < 0 || stop_fd < 0 ||
+		inotify_add_watch(inotify_fd, source_dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		close(inotify_fd);
+		close(stop_fd);
+		throw std::runtime_error("Failed to watch " + source_dir + " for shader changes");
+	}
+	watcher = std::thread(&ShaderReloader::run_watcher, this);
+	LOG_INFO("Watching %s for shader changes", source_dir.c_str());
+}
+
+ShaderReloader::~ShaderReloader() {
+	uint64_t stop = 1;
+	if (write(stop_fd, &stop, sizeof(stop)) != sizeof(stop)) {
+		LOG_ERROR("Failed to stop shader watcher");
+	}
+	watcher.join();
+	close(inotify_fd);
+	close(stop_fd);
+
+	// Never swapped in, so never used
+	for (auto &[target, pipeline] : ready) {
+		vkDestroyPipeline(ctx->device, pipeline, nullptr);
+	}
+}
+
+/**
+ * Rebuild `pipeline` with `build` whenever any of `shaders` (e.g. "simple.frag") or a shared include changes
+ */
+void ShaderReloader::watch(std::vector<std::string> shaders, PipelineBuilder build, PipelineHandle pipeline) {
+	std::lock_guard<std::mutex> lock(mutex);
+	watched.push_back({std::move(shaders), std::move(build), pipeline});
+}
+
+/**
+ * Swap in every pipeline rebuilt since the last call, returning how many. Call on the render thread between frames,
+ * before recording anything that binds the pipelines.
+ */
+uint32_t ShaderReloader::apply() {
+	TRACE_FUNCTION();
+	std::vector<std::pair<PipelineHandle, VkPipeline>> swaps;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		swaps.swap(ready);
+	}
+	// Any frame submitted so far may still be using the old pipelines
+	auto submitted = ctx->last_frame_point();
+	auto &resources = ctx->get_resources();
+	for (auto &[target, pipeline] : swaps) {
+		if (resources.is_valid(target)) {
+			resources.replace(target, pipeline, submitted);
+		}
+		else {
+			// Its owner has gone
+			vkDestroyPipeline(ctx->device, pipeline, nullptr);
+		}
+	}
+	return swaps.size();
+}
+
+void ShaderReloader::run_watcher() {
+	TRACE_THREAD_NAME("Shader reloader");
+	alignas(inotify_event) char buffer[4096];
+	pollfd fds[] = {
+		{.fd = inotify_fd, .events = POLLIN},
+		{.fd = stop_fd, .events = POLLIN},
+	};
+	while (true) {
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			LOG_ERROR("Shader watcher stopped: poll failed");
+			return;
+		}
+		if (fds[1].revents & POLLIN) {
+			return;
+		}
+
+		std::set<std::string> changed;
+		do {
+			ssize_t length;
+			while ((length = read(inotify_fd, buffer, sizeof(buffer))) > 0) {
+				for (char *p = buffer; p < buffer + length;) {
+					auto event = reinterpret_cast<inotify_event *>(p);
+					std::string file = event->len ? event->name : "";
+					if (file.size() > 5 && file.ends_with(".glsl")) {
+						changed.insert(file.substr(0, file.size() - 5));
+					}
+					p += sizeof(inotify_event) + event->len;
+				}
+			}
+		} while (poll(fds, 1, DEBOUNCE_MS) > 0);
+
+		std::vector<Watched> affected;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto &entry : watched) {
+				bool uses = std::any_of(changed.begin(), changed.end(), [&](auto &name) {
+					// Sources without a stage, like scene.glsl, are included by any shader
+					bool include = name.find('.') == std::string::npos;
+					return include || std::find(entry.shaders.begin(), entry.shaders.end(), name) != entry.shaders.end();
+				});
+				if (uses) {
+					affected.push_back(entry);
+				}
+			}
+		}
+		for (auto &entry : affected) {
+			rebuild(entry);
+		}
+	}
+}
+
+void ShaderReloader::rebuild(Watched &entry) {
+	TRACE_FUNCTION();
+	auto started_at = std::chrono::steady_clock::now();
+	std::vector<VkShaderModule> modules;
+	try {
+		for (auto &name : entry.shaders) {
+			auto code = compile(name);
+			modules.push_back(ctx->create_shader_module(code.data(), code.size() * sizeof(uint32_t)));
+		}
+		auto pipeline = entry.build(modules);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			ready.push_back({entry.pipeline, pipeline});
+		}
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started_at);
+		LOG_INFO("Reloaded %s in %.0fms", entry.shaders.back().c_str(), elapsed.count());
+	}
+	catch (const std::runtime_error &e) {
+		LOG_ERROR("Shader reload failed, keeping the old pipeline");
+		// Line by line, as each log message holds a limited amount of text
+		std::istringstream messages(e.what());
+		for (std::string line; std::getline(messages, line);) {
+			LOG_ERROR("  %s", line.c_str());
+		}
+	}
+	// Pipelines don't need their modules once they're built
+	for (auto module : modules) {
+		ctx->destroy_shader(module);
+	}
+}
+
+/**
+ * Run glslc on `<source_dir>/<name>.glsl`, with the same flags as the build, and return the SPIR-V
+ */
+std::vector<uint32_t> ShaderReloader::compile(const std::string &name) {
+	auto stage = name.substr(name.rfind('.') + 1);
+	// A file of its own, so other reloaders and running instances can't overwrite it
+	auto output = (std::filesystem::temp_directory_path() / ("plonk_" + name + "_XXXXXX")).string();
+	int fd = mkstemp(output.data());
+	if (fd < 0) {
+		throw std::runtime_error("Couldn't create a temporary file for " + name);
+	}
+	close(fd);
+	auto command = glslc + " --target-spv=spv1.6 --target-env=vulkan1.4 -fshader-stage=" + stage + " \"" +
+		source_dir + "/" + name + ".glsl\" -o \"" + output + "\" 2>&1";
+
+	auto pipe = popen(command.c_str(), "r");
+	if (!pipe) {
+		std::filesystem::remove(output);
+		throw std::runtime_error("Couldn't run " + glslc);
+	}
+	std::string messages;
+	char line[512];
+	while (fgets(line, sizeof(line), pipe)) {
+		messages += line;
+	}
+	if (pclose(pipe) != 0) {
+		std::filesystem::remove(output);
+		throw std::runtime_error(name + "\n" + messages);
+	}
+
+	std::ifstream file(output, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		std::filesystem::remove(output);
+		throw std::runtime_error("Missing compiled " + name);
+	}
+	size_t size = file.tellg();
+	std::vector<uint32_t> code(size / sizeof(uint32_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(code.data()), code.size() * sizeof(uint32_t));
+	std::filesystem::remove(output);
+	return code;
+}
@@ -0,0 +1,396 @@
+#include "include/plonk/shadow_pass.h"
+#include "include/plonk/log.h"
+#include <algorithm>
+#include <cmath>
+
+ShadowPass::ShadowPass(
+	ContextPtr ctx, VkDescriptorSetLayout step_set_layout, VkDescriptorSetLayout brick_map_set_layout,
+	StartupTasks *startup
+)
+	: ctx(ctx) {
+	LOG_DEBUG("Creating Shadow Pass");
+	create_render_pass();
+	create_descriptors();
+	auto compile = [this, step_set_layout, brick_map_set_layout]() {
+		auto vert = this->ctx->load_shader("simple.vert");
+		auto frag = this->ctx->load_shader("shadow.frag");
+		vert_shader = this->ctx->get_resources().add(vert);
+		frag_shader = this->ctx->get_resources().add(frag);
+		create_pipeline(vert, frag, step_set_layout, brick_map_set_layout);
+	};
+	if (startup) {
+		startup->run("Shadow pipeline", compile);
+	}
+	else {
+		compile();
+	}
+}
+
+bool ShadowPass::needs_resize(VkExtent2D target_size) {
+	auto width = std::max(1u, (uint32_t)std::ceil(target_size.width * scale));
+	auto height = std::max(1u, (uint32_t)std::ceil(target_size.height * scale));
+	return extent.width != width || extent.height != height;
+}
+
+void ShadowPass::resize(VkExtent2D target_size) {
+	vkDeviceWaitIdle(ctx->device);
+	destroy_images();
+	extent = {
+		.width = std::max(1u, (uint32_t)std::ceil(target_size.width * scale)),
+		.height = std::max(1u, (uint32_t)std::ceil(target_size.height * scale)),
+	};
+	LOG_DEBUG("Creating %dx%d shadow visibility buffers", extent.width, extent.height);
+	create_images();
+	history_valid = false;
+}
+
+void ShadowPass::record(
+	VkCommandBuffer command_buffer, SimplePushConstants constants, VkDescriptorSet step_set, VkDescriptorSet brick_map_set
+) {
+	uint32_t target = (current + 1) % HISTORY_COUNT;
+	bool use_history = temporal && history_valid;
+
+	constants.prev_position = use_history ? prev_position : constants.position;
+	constants.prev_direction = use_history ? prev_direction : constants.direction;
+	constants.history_weight = use_history ? history_weight : 0.0;
+	constants.frame = frame++;
+
+	RenderTarget render_target{
+		.image = images[target],
+		.view = image_views[target],
+		.extent = extent,
+		.final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.render_pass = render_pass,
+		.framebuffer = framebuffers[target],
+	};
+	ctx->begin_rendering(command_buffer, render_target);
+	auto &resources = ctx->get_resources();
+	auto layout = resources.get(pipeline_layout);
+	ctx->vk.CmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resources.get(pipeline));
+	VkDescriptorSet sets[] = {descriptor_sets[current], step_set, brick_map_set};
+	ctx->vk.CmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 3, sets, 0, nullptr);
+
+	VkViewport viewport{
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = (float)extent.width,
+		.height = (float)extent.height,
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f,
+	};
+	ctx->vk.CmdSetViewport(command_buffer, 0, 1, &viewport);
+
+	VkRect2D scissor{
+		.offset = {0, 0},
+		.extent = extent,
+	};
+	ctx->vk.CmdSetScissor(command_buffer, 0, 1, &scissor);
+
+	ctx->vk.CmdPushConstants(command_buffer, layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstants), &constants);
+	ctx->vk.CmdDraw(command_buffer, 6, 1, 0, 0);
+	ctx->end_rendering(command_buffer, render_target);
+
+	prev_position = constants.position;
+	prev_direction = constants.direction;
+	current = target;
+	history_valid = true;
+}
+
+void ShadowPass::create_render_pass() {
+	if (ctx->uses_dynamic_rendering()) {
+		return;
+	}
+	VkAttachmentDescription color_attachment{
+		.format = FORMAT,
+		.samples = VK_SAMPLE_COUNT_1_BIT,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+		.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+		.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+	};
+
+	VkAttachmentReference color_attachment_ref{
+		.attachment = 0,
+		.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+	};
+
+	VkSubpassDescription subpass{
+		.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &color_attachment_ref,
+	};
+
+	// The previous frame sampled this image as history, and the shading pass reads it and the step counts after
+	VkSubpassDependency dependencies[] = {
+		{
+			.srcSubpass = VK_SUBPASS_EXTERNAL,
+			.dstSubpass = 0,
+			.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			.srcAccessMask = 0,
+			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		},
+		{
+			.srcSubpass = 0,
+			.dstSubpass = VK_SUBPASS_EXTERNAL,
+			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		},
+	};
+
+	VkRenderPassCreateInfo render_pass_create_info{
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+		.attachmentCount = 1,
+		.pAttachments = &color_attachment,
+		.subpassCount = 1,
+		.pSubpasses = &subpass,
+		.dependencyCount = 2,
+		.pDependencies = dependencies,
+	};
+
+	if (VK_SUCCESS != vkCreateRenderPass(ctx->device, &render_pass_create_info, nullptr, &render_pass)) {
+		throw std::runtime_error("Failed to create shadow RenderPass");
+	}
+}
+
+void ShadowPass::create_descriptors() {
+	VkSamplerCreateInfo sampler_info{
+		.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter = VK_FILTER_LINEAR,
+		.minFilter = VK_FILTER_LINEAR,
+		.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.maxLod = 0.0f,
+	};
+	if (VK_SUCCESS != vkCreateSampler(ctx->device, &sampler_info, nullptr, &sampler)) {
+		throw std::runtime_error("Failed to create shadow sampler");
+	}
+
+	VkDescriptorSetLayoutBinding binding{
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+	};
+	VkDescriptorSetLayoutCreateInfo layout_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 1,
+		.pBindings = &binding,
+	};
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(ctx->device, &layout_info, nullptr, &descriptor_set_layout)) {
+		throw std::runtime_error("Failed to create shadow Descriptor Set Layout");
+	}
+
+	VkDescriptorPoolSize pool_size{
+		.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		.descriptorCount = HISTORY_COUNT,
+	};
+	VkDescriptorPoolCreateInfo pool_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = HISTORY_COUNT,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size,
+	};
+	if (VK_SUCCESS != vkCreateDescriptorPool(ctx->device, &pool_info, nullptr, &descriptor_pool)) {
+		throw std::runtime_error("Failed to create shadow Descriptor Pool");
+	}
+
+	std::array<VkDescriptorSetLayout, HISTORY_COUNT> layouts;
+	layouts.fill(descriptor_set_layout);
+	VkDescriptorSetAllocateInfo alloc_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = descriptor_pool,
+		.descriptorSetCount = HISTORY_COUNT,
+		.pSetLayouts = layouts.data(),
+	};
+	if (VK_SUCCESS != vkAllocateDescriptorSets(ctx->device, &alloc_info, descriptor_sets.data())) {
+		throw std::runtime_error("Failed to allocate shadow Descriptor Sets");
+	}
+}
+
+void ShadowPass::create_pipeline(
+	VkShaderModule vert, VkShaderModule frag, VkDescriptorSetLayout step_set_layout,
+	VkDescriptorSetLayout brick_map_set_layout
+) {
+	VkPushConstantRange push_constant_range{
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.offset = 0,
+		.size = sizeof(SimplePushConstants),
+	};
+
+	VkDescriptorSetLayout set_layouts[] = {descriptor_set_layout, step_set_layout, brick_map_set_layout};
+	VkPipelineLayoutCreateInfo pipeline_layout_info{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 3,
+		.pSetLayouts = set_layouts,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant_range,
+	};
+
+	VkPipelineLayout layout;
+	if (VK_SUCCESS != vkCreatePipelineLayout(ctx->device, &pipeline_layout_info, nullptr, &layout)) {
+		throw std::runtime_error("Failed to create shadow Pipeline Layout");
+	}
+	auto &resources = ctx->get_resources();
+	pipeline_layout = resources.add(layout);
+	pipeline = resources.add(ctx->create_fullscreen_pipeline(vert, frag, layout, render_pass, FORMAT));
+}
+
+void ShadowPass::watch_shaders(ShaderReloader &reloader) {
+	auto layout = ctx->get_resources().get(pipeline_layout);
+	reloader.watch({"simple.vert", "shadow.frag"}, [this, layout](const std::vector<VkShaderModule> &modules) {
+		return ctx->create_fullscreen_pipeline(modules[0], modules[1], layout, render_pass, FORMAT);
+	}, pipeline);
+}
+
+void ShadowPass::create_images() {
+	for (uint32_t i = 0; i < HISTORY_COUNT; i++) {
+		VkImageCreateInfo image_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = FORMAT,
+			.extent = {extent.width, extent.height, 1},
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		};
+		if (VK_SUCCESS != vkCreateImage(ctx->device, &image_info, nullptr, &images[i])) {
+			throw std::runtime_error("Failed to create shadow Image");
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(ctx->device, images[i], &requirements);
+		VkMemoryAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.allocationSize = requirements.size,
+			.memoryTypeIndex =
+				ctx->find_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+		};
+		if (VK_SUCCESS != vkAllocateMemory(ctx->device, &alloc_info, nullptr, &memory[i])) {
+			throw std::runtime_error("Failed to allocate shadow Image memory");
+		}
+		vkBindImageMemory(ctx->device, images[i], memory[i], 0);
+
+		VkImageViewCreateInfo view_info{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image = images[i],
+			.viewType = VK_IMAGE_VIEW_TYPE_2D,
+			.format = FORMAT,
+			.subresourceRange =
+				{
+					.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+					.baseMipLevel = 0,
+					.levelCount = 1,
+					.baseArrayLayer = 0,
+					.layerCount = 1,
+				},
+		};
+		if (VK_SUCCESS != vkCreateImageView(ctx->device, &view_info, nullptr, &image_views[i])) {
+			throw std::runtime_error("Failed to create shadow Image View");
+		}
+
+		if (render_pass) {
+			VkFramebufferCreateInfo framebuffer_info{
+				.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+				.renderPass = render_pass,
+				.attachmentCount = 1,
+				.pAttachments = &image_views[i],
+				.width = extent.width,
+				.height = extent.height,
+				.layers = 1,
+			};
+			if (VK_SUCCESS != vkCreateFramebuffer(ctx->device, &framebuffer_info, nullptr, &framebuffers[i])) {
+				throw std::runtime_error("Failed to create shadow Framebuffer");
+			}
+		}
+
+		VkDescriptorImageInfo descriptor_image{
+			.sampler = sampler,
+			.imageView = image_views[i],
+			.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		};
+		VkWriteDescriptorSet write{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = descriptor_sets[i],
+			.dstBinding = 0,
+			.dstArrayElement = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo = &descriptor_image,
+		};
+		vkUpdateDescriptorSets(ctx->device, 1, &write, 0, nullptr);
+	}
+
+	// Both images get sampled before they're first rendered to, so give them a defined layout
+	ctx->immediate_submit([&](VkCommandBuffer cmd) {
+		for (auto image : images) {
+			VkImageMemoryBarrier barrier{
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.srcAccessMask = 0,
+				.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = image,
+				.subresourceRange =
+					{
+						.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+						.baseMipLevel = 0,
+						.levelCount = 1,
+						.baseArrayLayer = 0,
+						.layerCount = 1,
+					},
+			};
+			ctx->vk.CmdPipelineBarrier(
+				cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0,
+				nullptr, 1, &barrier
+			);
+		}
+	});
+}
+
+void ShadowPass::destroy_images() {
+	for (uint32_t i = 0; i < HISTORY_COUNT; i++) {
+		if (framebuffers[i]) {
+			vkDestroyFramebuffer(ctx->device, framebuffers[i], nullptr);
+		}
+		if (image_views[i]) {
+			vkDestroyImageView(ctx->device, image_views[i], nullptr);
+		}
+		if (images[i]) {
+			vkDestroyImage(ctx->device, images[i], nullptr);
+		}
+		if (memory[i]) {
+			vkFreeMemory(ctx->device, memory[i], nullptr);
+		}
+		framebuffers[i] = VK_NULL_HANDLE;
+		image_views[i] = VK_NULL_HANDLE;
+		images[i] = VK_NULL_HANDLE;
+		memory[i] = VK_NULL_HANDLE;
+	}
+}
+
+ShadowPass::~ShadowPass() {
+	vkDeviceWaitIdle(ctx->device);
+	destroy_images();
+	auto &resources = ctx->get_resources();
+	resources.remove(pipeline);
+	resources.remove(pipeline_layout);
+	resources.remove(vert_shader);
+	resources.remove(frag_shader);
+	vkDestroyDescriptorPool(ctx->device, descriptor_pool, nullptr);
+	vkDestroyDescriptorSetLayout(ctx->device, descriptor_set_layout, nullptr);
+	vkDestroySampler(ctx->device, sampler, nullptr);
+	vkDestroyRenderPass(ctx->device, render_pass, nullptr);
+}
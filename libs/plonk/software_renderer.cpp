@@ -0,0 +1,76 @@
+#include "include/plonk/software_renderer.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
+#include <algorithm>
+#include <cmath>
+
+SoftwareRenderer::SoftwareRenderer(std::shared_ptr<JobSystem> jobs) : jobs(jobs) {
+	if (!this->jobs) {
+		this->jobs = std::make_shared<JobSystem>();
+	}
+	LOG_INFO("Software renderer using %u threads, %d lanes", thread_count(), SIMD_LANES);
+}
+
+void SoftwareRenderer::draw(Camera &camera, float time, Image &target) {
+	TRACE_FUNCTION();
+	uint32_t tiles_x = (target.width + TILE_SIZE - 1) / TILE_SIZE;
+	uint32_t tiles_y = (target.height + TILE_SIZE - 1) / TILE_SIZE;
+
+	state.scene.time = time;
+	state.camera = camera;
+	state.target = &target;
+	state.tiles_x = tiles_x;
+
+	jobs->parallel_for(0, tiles_x * tiles_y, 1, [this](size_t begin, size_t end) {
+		for (size_t tile = begin; tile < end; tile++) {
+			render_tile(tile);
+		}
+	});
+}
+
+static uint8_t linear_to_srgb(float c) {
+	c = std::clamp(c, 0.0f, 1.0f);
+	c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	return (uint8_t)(c * 255.0f + 0.5f);
+}
+
+void SoftwareRenderer::render_tile(uint32_t tile) {
+	auto &target = *state.target;
+	uint32_t x0 = (tile % state.tiles_x) * TILE_SIZE;
+	uint32_t y0 = (tile / state.tiles_x) * TILE_SIZE;
+	uint32_t x1 = std::min(x0 + TILE_SIZE, target.width);
+	uint32_t y1 = std::min(y0 + TILE_SIZE, target.height);
+
+	// Camera basis, as cameraRay in scene.glsl
+	Vector3 f = state.camera.direction;
+	Vector3 r = Vector3(0.0, 1.0, 0.0).cross(f).normalize();
+	Vector3 up = f.cross(r);
+	float aspect = (float)target.height / target.width;
+	Vector3V ro(state.camera.position);
+
+	FloatV lane_offsets;
+	for (int i = 0; i < SIMD_LANES; i++) {
+		lane_offsets[i] = i;
+	}
+
+	for (uint32_t y = y0; y < y1; y++) {
+		float v = ((y + 0.5f) / target.height) * 2.0f - 1.0f;
+		uint8_t *row = target.row(y);
+		for (uint32_t x = x0; x < x1; x += SIMD_LANES) {
+			FloatV px = lane_offsets + (float)x;
+			MaskV active = px < (float)x1;
+			FloatV u = ((px + 0.5f) / (float)target.width) * 2.0f - 1.0f;
+
+			Vector3V rd = (Vector3V(f) + Vector3V(r) * (u / aspect) + Vector3V(up) * v).normalize();
+			Vector3V color = state.scene.shade(ro, rd, active);
+
+			for (int i = 0; i < SIMD_LANES && x + i < x1; i++) {
+				uint8_t *pixel = row + (x + i) * 4;
+				pixel[0] = linear_to_srgb(color.x[i]);
+				pixel[1] = linear_to_srgb(color.y[i]);
+				pixel[2] = linear_to_srgb(color.z[i]);
+				pixel[3] = 255;
+			}
+		}
+	}
+}
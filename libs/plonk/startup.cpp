@@ -0,0 +1,118 @@
+#include "include/plonk/startup.h"
+#include "include/plonk/log.h"
+#include <algorithm>
+
+StartupTimer::StartupTimer() : created_at(Clock::now()), main_thread(std::this_thread::get_id()) {}
+
+void StartupTimer::record(const std::string &name, Clock::time_point start, Clock::time_point end) {
+	StartupPhase phase{
+		.name = name,
+		.start_ms = std::chrono::duration<double, std::milli>(start - created_at).count(),
+		.duration_ms = std::chrono::duration<double, std::milli>(end - start).count(),
+		.background = std::this_thread::get_id() != main_thread,
+	};
+	std::lock_guard<std::mutex> lock(mutex);
+	phases.push_back(phase);
+}
+
+void StartupTimer::time(const std::string &name, const std::function<void()> &fn) {
+	StartupScope scope(*this, name);
+	fn();
+}
+
+double StartupTimer::elapsed_ms() {
+	return std::chrono::duration<double, std::milli>(Clock::now() - created_at).count();
+}
+
+/**
+ * Every phase recorded so far, in the order they started
+ */
+std::vector<StartupPhase> StartupTimer::get_phases() {
+	std::vector<StartupPhase> sorted;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sorted = phases;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](auto &a, auto &b) { return a.start_ms < b.start_ms; });
+	return sorted;
+}
+
+void StartupTimer::report() {
+	auto sorted = get_phases();
+	double busy_ms = 0.0;
+	for (auto &phase : sorted) {
+		busy_ms += phase.duration_ms;
+	}
+	// Phases that overlapped add up to more than the time startup took
+	LOG_INFO("Startup took %.1fms (%.1fms of work)", elapsed_ms(), busy_ms);
+	for (auto &phase : sorted) {
+		LOG_INFO(
+			"  %-24s %8.1fms  at %8.1fms%s", phase.name.c_str(), phase.duration_ms, phase.start_ms,
+			phase.background ? "  (background)" : ""
+		);
+	}
+}
+
+StartupScope::StartupScope(StartupTimer &timer, const std::string &name)
+	: timer(timer), name(name), start(StartupTimer::Clock::now()) {}
+
+StartupScope::~StartupScope() {
+	end();
+}
+
+void StartupScope::end() {
+	if (!ended) {
+		timer.record(name, start, StartupTimer::Clock::now());
+		ended = true;
+	}
+}
+
+StartupTasks::StartupTasks(StartupTimer &timer, std::shared_ptr<JobSystem> jobs) : timer(timer), jobs(jobs) {}
+
+StartupTasks::~StartupTasks() {
+	drain();
+}
+
+void StartupTasks::run(const std::string &phase, std::function<void()> task) {
+	if (!jobs) {
+		timer.time(phase, task);
+		return;
+	}
+	jobs->run([this, phase, task = std::move(task)]() {
+		try {
+			timer.time(phase, task);
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+	}, &counter);
+}
+
+/**
+ * Wait for every task run so far, rethrowing the first failure
+ */
+void StartupTasks::wait() {
+	if (jobs) {
+		jobs->wait(counter);
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	if (error) {
+		auto failure = error;
+		error = nullptr;
+		std::rethrow_exception(failure);
+	}
+}
+
+/**
+ * Wait for every task without rethrowing, so nothing still runs against objects being unwound after another failure
+ */
+void StartupTasks::drain() {
+	if (jobs) {
+		jobs->wait(counter);
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	error = nullptr;
+}
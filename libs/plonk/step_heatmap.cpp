@@ -0,0 +1,301 @@
+#include "include/plonk/step_heatmap.h"
+#include "include/plonk/log.h"
+#include <cstddef>
+#include <cstring>
+
+struct HistogramPushConstants {
+	uint32_t primary_count;
+	uint32_t shadow_count;
+};
+
+StepHeatmap::StepHeatmap(ContextPtr ctx, StartupTasks *startup) : ctx(ctx) {
+	if (!ctx->get_enabled_features().fragmentStoresAndAtomics) {
+		LOG_WARNING("Device doesn't support fragment stores, step heatmap unavailable");
+		available = false;
+	}
+	// The passes' pipeline layouts include the counts set either way, it's just never written
+	create_descriptors();
+	if (!available) {
+		return;
+	}
+	auto compile = [this]() {
+		histogram_shader = this->ctx->load_shader("step_histogram.comp");
+		percentiles_shader = this->ctx->load_shader("step_percentiles.comp");
+		create_pipelines();
+	};
+	if (startup) {
+		startup->run("Step heatmap pipelines", compile);
+	}
+	else {
+		compile();
+	}
+}
+
+bool StepHeatmap::needs_resize(VkExtent2D size) {
+	return extent.width != size.width || extent.height != size.height;
+}
+
+void StepHeatmap::resize(VkExtent2D size) {
+	vkDeviceWaitIdle(ctx->device);
+	if (counts_buffer) {
+		vkDestroyBuffer(ctx->device, counts_buffer, nullptr);
+		vkFreeMemory(ctx->device, counts_memory, nullptr);
+	}
+	extent = size;
+
+	// Primary rays at full resolution, followed by the shadow buffer which is at most the same size
+	VkDeviceSize counts_size = 2 * (VkDeviceSize)extent.width * extent.height * sizeof(uint32_t);
+	ctx->create_buffer(
+		counts_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, counts_buffer,
+		counts_memory
+	);
+
+	VkDescriptorBufferInfo counts_info{
+		.buffer = counts_buffer,
+		.offset = 0,
+		.range = VK_WHOLE_SIZE,
+	};
+	std::vector<VkWriteDescriptorSet> writes;
+	writes.push_back({
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = graphics_set,
+		.dstBinding = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.pBufferInfo = &counts_info,
+	});
+	for (auto &slot : slots) {
+		writes.push_back({
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = slot.descriptor_set,
+			.dstBinding = 0,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &counts_info,
+		});
+		slot.pending = false;
+	}
+	vkUpdateDescriptorSets(ctx->device, writes.size(), writes.data(), 0, nullptr);
+}
+
+/**
+ * Collect the stats recorded into this frame slot last time round, and clear its histogram for reuse.
+ * Must be called outside of a render pass.
+ */
+void StepHeatmap::begin_frame(VkCommandBuffer command_buffer) {
+	frame++;
+	auto &slot = current_slot();
+	if (slot.pending) {
+		collect(slot);
+		slot.pending = false;
+	}
+	if (!is_enabled()) {
+		return;
+	}
+
+	ctx->vk.CmdFillBuffer(command_buffer, slot.buffer, offsetof(GpuStats, histograms), sizeof(GpuStats::histograms), 0);
+}
+
+/**
+ * Build the step histograms and percentiles. Must be called after both passes, outside of a render pass.
+ */
+void StepHeatmap::record_stats(VkCommandBuffer command_buffer, VkExtent2D shadow_size) {
+	if (!is_enabled()) {
+		return;
+	}
+	auto &slot = current_slot();
+
+	VkMemoryBarrier counts_barrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+	};
+	ctx->vk.CmdPipelineBarrier(
+		command_buffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &counts_barrier, 0, nullptr, 0, nullptr
+	);
+
+	HistogramPushConstants constants{
+		.primary_count = extent.width * extent.height,
+		.shadow_count = shadow_size.width * shadow_size.height,
+	};
+	ctx->vk.CmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, histogram_pipeline);
+	ctx->vk.CmdBindDescriptorSets(
+		command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, compute_layout, 0, 1, &slot.descriptor_set, 0, nullptr
+	);
+	ctx->vk.CmdPushConstants(command_buffer, compute_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	ctx->vk.CmdDispatch(command_buffer, (constants.primary_count + constants.shadow_count + 255) / 256, 1, 1);
+
+	VkMemoryBarrier histogram_barrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+	};
+	ctx->vk.CmdPipelineBarrier(
+		command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+		&histogram_barrier, 0, nullptr, 0, nullptr
+	);
+
+	ctx->vk.CmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, percentiles_pipeline);
+	ctx->vk.CmdDispatch(command_buffer, 1, 1, 1);
+
+	VkMemoryBarrier host_barrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+	};
+	ctx->vk.CmdPipelineBarrier(
+		command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0,
+		nullptr, 0, nullptr
+	);
+
+	slot.pending = true;
+}
+
+void StepHeatmap::collect(FrameSlot &slot) {
+	auto gpu = slot.mapped;
+	stats.primary = gpu->summaries[0];
+	stats.shadow = gpu->summaries[1];
+	stats.primary_histogram.assign(gpu->histograms[0], gpu->histograms[0] + BINS);
+	stats.shadow_histogram.assign(gpu->histograms[1], gpu->histograms[1] + BINS);
+}
+
+void StepHeatmap::create_descriptors() {
+	VkDescriptorSetLayoutBinding graphics_binding{
+		.binding = 0,
+		.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 1,
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+	};
+	VkDescriptorSetLayoutCreateInfo graphics_layout_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 1,
+		.pBindings = &graphics_binding,
+	};
+	if (VK_SUCCESS !=
+		vkCreateDescriptorSetLayout(ctx->device, &graphics_layout_info, nullptr, &graphics_set_layout)) {
+		throw std::runtime_error("Failed to create step count Descriptor Set Layout");
+	}
+
+	VkDescriptorSetLayoutBinding compute_bindings[] = {
+		{
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		},
+		{
+			.binding = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		},
+	};
+	VkDescriptorSetLayoutCreateInfo compute_layout_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = 2,
+		.pBindings = compute_bindings,
+	};
+	if (VK_SUCCESS != vkCreateDescriptorSetLayout(ctx->device, &compute_layout_info, nullptr, &compute_set_layout)) {
+		throw std::runtime_error("Failed to create step stats Descriptor Set Layout");
+	}
+
+	VkDescriptorPoolSize pool_size{
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = 1 + 2 * FRAME_COUNT,
+	};
+	VkDescriptorPoolCreateInfo pool_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = 1 + FRAME_COUNT,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size,
+	};
+	if (VK_SUCCESS != vkCreateDescriptorPool(ctx->device, &pool_info, nullptr, &descriptor_pool)) {
+		throw std::runtime_error("Failed to create step count Descriptor Pool");
+	}
+
+	VkDescriptorSetAllocateInfo graphics_alloc_info{
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts = &graphics_set_layout,
+	};
+	if (VK_SUCCESS != vkAllocateDescriptorSets(ctx->device, &graphics_alloc_info, &graphics_set)) {
+		throw std::runtime_error("Failed to allocate step count Descriptor Set");
+	}
+
+	for (auto &slot : slots) {
+		VkDescriptorSetAllocateInfo alloc_info{
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = descriptor_pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &compute_set_layout,
+		};
+		if (VK_SUCCESS != vkAllocateDescriptorSets(ctx->device, &alloc_info, &slot.descriptor_set)) {
+			throw std::runtime_error("Failed to allocate step stats Descriptor Set");
+		}
+
+		ctx->create_buffer(
+			sizeof(GpuStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot.buffer, slot.memory
+		);
+		vkMapMemory(ctx->device, slot.memory, 0, sizeof(GpuStats), 0, (void **)&slot.mapped);
+		std::memset(slot.mapped, 0, sizeof(GpuStats));
+
+		VkDescriptorBufferInfo stats_info{
+			.buffer = slot.buffer,
+			.offset = 0,
+			.range = sizeof(GpuStats),
+		};
+		VkWriteDescriptorSet write{
+			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet = slot.descriptor_set,
+			.dstBinding = 1,
+			.descriptorCount = 1,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo = &stats_info,
+		};
+		vkUpdateDescriptorSets(ctx->device, 1, &write, 0, nullptr);
+	}
+}
+
+void StepHeatmap::create_pipelines() {
+	VkPushConstantRange push_constant_range{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(HistogramPushConstants),
+	};
+	VkPipelineLayoutCreateInfo layout_info{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &compute_set_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant_range,
+	};
+	if (VK_SUCCESS != vkCreatePipelineLayout(ctx->device, &layout_info, nullptr, &compute_layout)) {
+		throw std::runtime_error("Failed to create step stats Pipeline Layout");
+	}
+
+	histogram_pipeline = ctx->create_compute_pipeline(histogram_shader, compute_layout);
+	percentiles_pipeline = ctx->create_compute_pipeline(percentiles_shader, compute_layout);
+}
+
+StepHeatmap::~StepHeatmap() {
+	vkDeviceWaitIdle(ctx->device);
+	vkDestroyPipeline(ctx->device, histogram_pipeline, nullptr);
+	vkDestroyPipeline(ctx->device, percentiles_pipeline, nullptr);
+	vkDestroyPipelineLayout(ctx->device, compute_layout, nullptr);
+	for (auto &slot : slots) {
+		vkDestroyBuffer(ctx->device, slot.buffer, nullptr);
+		vkFreeMemory(ctx->device, slot.memory, nullptr);
+	}
+	if (counts_buffer) {
+		vkDestroyBuffer(ctx->device, counts_buffer, nullptr);
+		vkFreeMemory(ctx->device, counts_memory, nullptr);
+	}
+	vkDestroyDescriptorPool(ctx->device, descriptor_pool, nullptr);
+	vkDestroyDescriptorSetLayout(ctx->device, graphics_set_layout, nullptr);
+	vkDestroyDescriptorSetLayout(ctx->device, compute_set_layout, nullptr);
+	ctx->destroy_shader(histogram_shader);
+	ctx->destroy_shader(percentiles_shader);
+}
@@ -0,0 +1,193 @@
+#include "include/plonk/submit_scheduler.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
+#include <stdexcept>
+
+// Completed values only ever grow, and caching them saves asking the driver about points already known to be done
+static void raise_completed(std::atomic<uint64_t> &completed, uint64_t value) {
+	uint64_t known = completed.load(std::memory_order_relaxed);
+	while (value > known && !completed.compare_exchange_weak(known, value, std::memory_order_relaxed)) {
+	}
+}
+
+SubmitScheduler::SubmitScheduler(VkDevice device, const DeviceDispatch &vk) : device(device), vk(vk) {
+}
+
+SubmitScheduler::~SubmitScheduler() {
+	for (auto &lane : lanes) {
+		vkDestroySemaphore(device, lane->semaphore, nullptr);
+	}
+}
+
+/**
+ * Start scheduling submissions to `queue`. Adding a queue that's already known returns its existing lane, so callers
+ * can ask for separate compute or transfer lanes without caring whether the device has separate queues.
+ */
+QueueLane SubmitScheduler::add_queue(VkQueue queue, const std::string &name) {
+	for (QueueLane i = 0; i < lanes.size(); i++) {
+		if (lanes[i]->queue == queue) {
+			LOG_DEBUG("Queue %s shares the %s timeline", name.c_str(), lanes[i]->name.c_str());
+			return i;
+		}
+	}
+
+	VkSemaphoreTypeCreateInfo type_info{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0,
+	};
+	VkSemaphoreCreateInfo semaphore_info{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &type_info,
+	};
+	auto lane = std::make_unique<Lane>();
+	lane->name = name;
+	lane->queue = queue;
+	if (VK_SUCCESS != vkCreateSemaphore(device, &semaphore_info, nullptr, &lane->semaphore)) {
+		throw std::runtime_error("Failed to create timeline semaphore");
+	}
+	lanes.push_back(std::move(lane));
+	return lanes.size() - 1;
+}
+
+/**
+ * Submit to `lane`'s queue, returning the timeline point that's reached when the work finishes
+ */
+TimelinePoint SubmitScheduler::submit(QueueLane lane, const Submission &submission) {
+	TRACE_FUNCTION();
+	std::vector<VkSemaphoreSubmitInfo> waits;
+	waits.reserve(submission.waits.size() + submission.binary_waits.size());
+	for (auto &[point, stages] : submission.waits) {
+		waits.push_back({
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore = lanes[point.lane]->semaphore,
+			.value = point.value,
+			.stageMask = stages,
+		});
+	}
+	for (auto &[semaphore, stages] : submission.binary_waits) {
+		waits.push_back({
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore = semaphore,
+			.stageMask = stages,
+		});
+	}
+
+	std::vector<VkCommandBufferSubmitInfo> command_buffers;
+	command_buffers.reserve(submission.command_buffers.size());
+	for (auto command_buffer : submission.command_buffers) {
+		command_buffers.push_back({
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+			.commandBuffer = command_buffer,
+		});
+	}
+
+	auto &target = *lanes[lane];
+	std::lock_guard<std::mutex> lock(target.mutex);
+	uint64_t value = target.submitted + 1;
+	std::vector<VkSemaphoreSubmitInfo> signals{{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+		.semaphore = target.semaphore,
+		.value = value,
+		.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+	}};
+	for (auto semaphore : submission.binary_signals) {
+		signals.push_back({
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore = semaphore,
+			.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+		});
+	}
+
+	VkSubmitInfo2 submit_info{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+		.waitSemaphoreInfoCount = static_cast<uint32_t>(waits.size()),
+		.pWaitSemaphoreInfos = waits.data(),
+		.commandBufferInfoCount = static_cast<uint32_t>(command_buffers.size()),
+		.pCommandBufferInfos = command_buffers.data(),
+		.signalSemaphoreInfoCount = static_cast<uint32_t>(signals.size()),
+		.pSignalSemaphoreInfos = signals.data(),
+	};
+	if (VK_SUCCESS != vk.QueueSubmit2(target.queue, 1, &submit_info, VK_NULL_HANDLE)) {
+		throw std::runtime_error("Failed to submit to " + target.name + " queue");
+	}
+	target.submitted = value;
+	return {lane, value};
+}
+
+TimelinePoint SubmitScheduler::last_submitted(QueueLane lane) {
+	auto &target = *lanes[lane];
+	std::lock_guard<std::mutex> lock(target.mutex);
+	return {lane, target.submitted};
+}
+
+/**
+ * Latest value the device has reached on `lane`'s timeline, without blocking
+ */
+uint64_t SubmitScheduler::completed_value(QueueLane lane) {
+	auto &target = *lanes[lane];
+	uint64_t value;
+	if (VK_SUCCESS != vk.GetSemaphoreCounterValue(device, target.semaphore, &value)) {
+		throw std::runtime_error("Failed to read timeline semaphore");
+	}
+	raise_completed(target.completed, value);
+	return value;
+}
+
+bool SubmitScheduler::is_complete(TimelinePoint point) {
+	if (point.value <= lanes[point.lane]->completed.load(std::memory_order_relaxed)) {
+		return true;
+	}
+	return point.value <= completed_value(point.lane);
+}
+
+/**
+ * Block until `point` is reached or `timeout` nanoseconds pass, returning whether it was reached
+ */
+bool SubmitScheduler::wait(TimelinePoint point, uint64_t timeout) {
+	return wait_all({point}, timeout);
+}
+
+bool SubmitScheduler::wait_all(const std::vector<TimelinePoint> &points, uint64_t timeout) {
+	TRACE_FUNCTION();
+	std::vector<VkSemaphore> semaphores;
+	std::vector<uint64_t> values;
+	for (auto &point : points) {
+		if (point.value > lanes[point.lane]->completed.load(std::memory_order_relaxed)) {
+			semaphores.push_back(lanes[point.lane]->semaphore);
+			values.push_back(point.value);
+		}
+	}
+	if (semaphores.empty()) {
+		return true;
+	}
+
+	VkSemaphoreWaitInfo wait_info{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = static_cast<uint32_t>(semaphores.size()),
+		.pSemaphores = semaphores.data(),
+		.pValues = values.data(),
+	};
+	VkResult result = vk.WaitSemaphores(device, &wait_info, timeout);
+	if (result == VK_TIMEOUT) {
+		return false;
+	}
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to wait for timeline semaphore");
+	}
+	for (auto &point : points) {
+		raise_completed(lanes[point.lane]->completed, point.value);
+	}
+	return true;
+}
+
+/**
+ * Block until everything submitted so far, on every queue, has finished
+ */
+void SubmitScheduler::wait_idle() {
+	std::vector<TimelinePoint> points;
+	for (QueueLane i = 0; i < lanes.size(); i++) {
+		points.push_back(last_submitted(i));
+	}
+	wait_all(points);
+}
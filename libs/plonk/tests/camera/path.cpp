@@ -0,0 +1,47 @@
+#include "../helpers.h"
+#include <plonk/camera_path.h>
+#include <sstream>
+
+describe(camera_path, {
+	std::istringstream input(
+		"# time position direction\n"
+		"1.0  0 0 0   0 0 1\n"
+		"\n"
+		"3.0  10 0 -4  1 0 0\n"
+	);
+	auto path = CameraPath::parse(input);
+
+	it("parses keyframes and skips comments", {
+		assert(path.keyframes.size() == 2);
+		assert_approx(path.duration(), 2.0);
+	});
+
+	it("interpolates between keyframes", {
+		Camera camera;
+		path.apply(1.0, camera);
+		assert_approx(camera.position.x(), 5.0);
+		assert_approx(camera.position.z(), -2.0);
+		assert_approx(camera.direction.x(), camera.direction.z());
+		assert_approx(camera.direction.magnitude(), 1.0);
+	});
+
+	it("clamps to the ends of the path", {
+		Camera camera;
+		path.apply(10.0, camera);
+		assert_approx(camera.position.x(), 10.0);
+		path.apply(-1.0, camera);
+		assert_approx(camera.position.x(), 0.0);
+	});
+
+	it("rejects malformed keyframes", {
+		std::istringstream bad("0.0 1 2 3\n");
+		bool threw = false;
+		try {
+			CameraPath::parse(bad);
+		}
+		catch (const std::runtime_error &) {
+			threw = true;
+		}
+		assert(threw);
+	});
+});
@@ -27,6 +27,9 @@ public:
 		__test_failed = true; \
 	} \
 
+#define skip(name, reason) \
+	std::cerr << "\x1b[48;5;226m\x1b[38;5;0m SKIP \x1b[0m " << name << " -- " << reason << "\n";
+
 #define assert_with_message(condition, message) \
 	if (!(condition)) throw AssertionFailure(message);
 
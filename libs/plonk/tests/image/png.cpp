@@ -0,0 +1,36 @@
+#include "../helpers.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <plonk/image.h>
+
+describe(image_png, {
+	it("calculates the CRC32 of a chunk", {
+		const char *data = "IEND";
+		assert(Image::crc32((const uint8_t *)data, 4) == 0xae426082);
+	});
+
+	it("calculates the Adler-32 checksum", {
+		const char *data = "Wikipedia";
+		assert(Image::adler32((const uint8_t *)data, strlen(data)) == 0x11e60398);
+	});
+
+	it("writes a PNG header and stored image data", {
+		Image image(3, 2);
+		image.row(1)[0] = 255;
+		auto path = (std::filesystem::temp_directory_path() / "plonk_test_image.png").string();
+		image.save_png(path);
+
+		std::ifstream file(path, std::ios::binary);
+		std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		file.close();
+		std::filesystem::remove(path);
+		const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+		assert(bytes.size() > 8 && memcmp(bytes.data(), signature, 8) == 0);
+		// IHDR width and height
+		assert(bytes[19] == 3);
+		assert(bytes[23] == 2);
+		// Signature, IHDR, IDAT with a 2 byte zlib header, 5 byte stored block header, 2 rows and adler, then IEND
+		assert(bytes.size() == 8 + 25 + 12 + 2 + 5 + 2 * 13 + 4 + 12);
+	});
+});
@@ -0,0 +1,89 @@
+#include "../helpers.h"
+#include <plonk/job_system.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+describe(jobs_job_system, {
+	JobSystem jobs(4);
+
+	it("covers every index exactly once with parallel_for", {
+		std::vector<std::atomic<int>> hits(1000);
+		jobs.parallel_for(0, hits.size(), 7, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				hits[i]++;
+			}
+		});
+		for (auto &hit : hits) {
+			assert(hit.load() == 1);
+		}
+	});
+
+	it("waits for jobs spawned by other jobs", {
+		std::atomic<int> count{0};
+		JobCounter counter;
+		for (int i = 0; i < 16; i++) {
+			jobs.run([&]() {
+				for (int j = 0; j < 16; j++) {
+					jobs.run([&]() { count++; }, &counter);
+				}
+			}, &counter);
+		}
+		jobs.wait(counter);
+		assert(counter.done());
+		assert(count.load() == 256);
+	});
+
+	it("runs main thread jobs only on the main thread", {
+		std::atomic<bool> on_main{false};
+		JobCounter counter;
+		jobs.run([&]() {
+			jobs.run_on_main([&]() { on_main = jobs.is_main_thread(); }, &counter);
+		}, &counter);
+		jobs.wait(counter);
+		assert(on_main.load());
+	});
+
+	it("runs everything on the calling thread when single threaded", {
+		JobSystem single(1);
+		int count = 0;
+		single.parallel_for(0, 4, 1, [&](size_t, size_t) { count += single.is_main_thread(); });
+		assert(count == 4);
+		assert(single.thread_count() == 1);
+	});
+
+	it("tells its own threads from outside ones", {
+		std::atomic<int> owned{0};
+		jobs.parallel_for(0, 64, 1, [&](size_t, size_t) { owned += jobs.owns_current_thread(); });
+		assert(owned.load() == 64);
+
+		bool outside = true;
+		std::thread([&]() { outside = jobs.owns_current_thread(); }).join();
+		assert(!outside);
+	});
+
+	it("waits from threads outside the system", {
+		std::atomic<int> count{0};
+		bool threw = false;
+		std::thread([&]() {
+			try {
+				JobCounter counter;
+				for (int i = 0; i < 32; i++) {
+					// Slow enough that workers still hold some when the waiting thread's queue runs dry
+					jobs.run([&]() {
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+						count++;
+					}, &counter);
+				}
+				jobs.wait(counter);
+				jobs.parallel_for(0, 32, 1, [&](size_t, size_t) { count++; });
+			}
+			catch (const std::exception &) {
+				threw = true;
+			}
+		}).join();
+		assert(!threw);
+		assert(count.load() == 64);
+	});
+});
@@ -0,0 +1,64 @@
+#include "../helpers.h"
+#include <plonk/startup.h>
+#include <atomic>
+#include <stdexcept>
+
+describe(jobs_startup, {
+	auto jobs = std::make_shared<JobSystem>(4);
+
+	it("runs tasks immediately without a job system", {
+		StartupTimer timer;
+		StartupTasks tasks(timer);
+		bool ran = false;
+		tasks.run("Inline", [&]() { ran = true; });
+		assert(ran);
+		auto phases = timer.get_phases();
+		assert(phases.size() == 1);
+		assert(phases[0].name == "Inline");
+		assert(!phases[0].background);
+	});
+
+	it("records a phase for every task", {
+		StartupTimer timer;
+		StartupTasks tasks(timer, jobs);
+		std::atomic<int> count{0};
+		for (int i = 0; i < 8; i++) {
+			tasks.run("Task", [&]() { count++; });
+		}
+		tasks.wait();
+		assert(count.load() == 8);
+		assert(timer.get_phases().size() == 8);
+	});
+
+	it("rethrows a failed task once the others have finished", {
+		StartupTimer timer;
+		StartupTasks tasks(timer, jobs);
+		std::atomic<int> count{0};
+		tasks.run("Fails", []() { throw std::runtime_error("no swapchain"); });
+		for (int i = 0; i < 4; i++) {
+			tasks.run("Succeeds", [&]() { count++; });
+		}
+		bool threw = false;
+		try {
+			tasks.wait();
+		}
+		catch (const std::runtime_error &e) {
+			threw = std::string(e.what()) == "no swapchain";
+		}
+		assert(threw);
+		assert(count.load() == 4);
+		// The failure was reported, so waiting again succeeds
+		tasks.wait();
+	});
+
+	it("orders phases by when they started", {
+		StartupTimer timer;
+		auto now = StartupTimer::Clock::now();
+		timer.record("Second", now + std::chrono::milliseconds(5), now + std::chrono::milliseconds(6));
+		timer.record("First", now, now + std::chrono::milliseconds(10));
+		auto phases = timer.get_phases();
+		assert(phases[0].name == "First");
+		assert(phases[1].name == "Second");
+		assert(phases[0].duration_ms > 9.0);
+	});
+});
@@ -0,0 +1,64 @@
+#include "../helpers.h"
+#include <plonk/frame_arena.h>
+#include <cstdint>
+#include <vector>
+
+describe(memory_frame_arena, {
+	it("aligns allocations", {
+		FrameArena arena(1024);
+		arena.allocate(1, 1);
+		auto wide = arena.allocate(16, 64);
+		assert((uintptr_t)wide % 64 == 0);
+		auto value = arena.make<double>(1.5);
+		assert((uintptr_t)value % alignof(double) == 0);
+		assert(*value == 1.5);
+	});
+
+	it("value initialises arrays", {
+		FrameArena arena(1024);
+		auto values = arena.make_array<uint32_t>(32);
+		for (int i = 0; i < 32; i++) {
+			assert(values[i] == 0);
+		}
+	});
+
+	it("reuses its memory after a reset", {
+		FrameArena arena(1024);
+		auto first = arena.allocate(100);
+		arena.reset();
+		assert(arena.bytes_used() == 0);
+		assert(arena.allocate(100) == first);
+	});
+
+	it("grows from the heap then stops allocating", {
+		FrameArena arena(256);
+		for (int i = 0; i < 4; i++) {
+			arena.allocate(200);
+		}
+		assert(arena.overflow_blocks() == 3);
+		arena.reset();
+
+		for (int i = 0; i < 4; i++) {
+			arena.allocate(200);
+		}
+		assert(arena.overflow_blocks() == 0, "Frame of the same size shouldn't need the heap");
+		arena.reset();
+		auto stats = arena.get_stats();
+		assert(stats.overflow_blocks == 3);
+		assert(stats.frames == 2);
+		assert(stats.peak_bytes >= 800);
+		assert(stats.capacity >= 800);
+	});
+
+	it("backs standard containers", {
+		FrameArena arena(4096);
+		std::vector<int, ArenaAllocator<int>> values{ArenaAllocator<int>(arena)};
+		values.reserve(100);
+		for (int i = 0; i < 100; i++) {
+			values.push_back(i);
+		}
+		assert(values[99] == 99);
+		assert(arena.bytes_used() >= 100 * sizeof(int));
+		assert(arena.overflow_blocks() == 0);
+	});
+});
@@ -0,0 +1,65 @@
+#include "../helpers.h"
+#include <plonk/handle.h>
+#include <string>
+
+struct Thing {};
+
+describe(memory_handles, {
+	it("looks up inserted values", {
+		SlotArray<std::string, Thing> values;
+		auto a = values.insert("a");
+		auto b = values.insert("b");
+		assert(*values.get(a) == "a");
+		assert(*values.get(b) == "b");
+		assert(values.size() == 2);
+	});
+
+	it("never treats the default handle as valid", {
+		SlotArray<int> values;
+		values.insert(1);
+		Handle<int> none;
+		assert(!none);
+		assert(!values.contains(none));
+		assert(values.get(none) == nullptr);
+	});
+
+	it("detects stale handles when a slot is reused", {
+		SlotArray<int> values;
+		auto first = values.insert(1);
+		assert(values.remove(first).value() == 1);
+		auto second = values.insert(2);
+		assert(first.index() == second.index(), "Slot should be reused");
+		assert(!values.contains(first));
+		assert(values.get(first) == nullptr);
+		assert(!values.remove(first).has_value());
+		assert(*values.get(second) == 2);
+	});
+
+	it("keeps values packed as they're removed", {
+		SlotArray<int> values;
+		auto a = values.insert(1);
+		auto b = values.insert(2);
+		auto c = values.insert(3);
+		values.remove(a);
+		assert(values.size() == 2);
+		int sum = 0;
+		for (auto value : values) {
+			sum += value;
+		}
+		assert(sum == 5);
+		assert(*values.get(b) == 2);
+		assert(*values.get(c) == 3);
+	});
+
+	it("invalidates everything on clear", {
+		SlotArray<int> values;
+		auto a = values.insert(1);
+		auto b = values.insert(2);
+		values.clear();
+		assert(values.empty());
+		assert(!values.contains(a));
+		assert(!values.contains(b));
+		auto c = values.insert(3);
+		assert(*values.get(c) == 3);
+	});
+});
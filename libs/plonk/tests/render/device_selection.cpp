@@ -0,0 +1,68 @@
+#include "../helpers.h"
+#include <plonk/device_selection.h>
+
+static DeviceInfo usable_device(const std::string &name, VkPhysicalDeviceType type) {
+	return {
+		.name = name,
+		.type = type,
+		.api_version = VK_API_VERSION_1_3,
+		.graphics_queue = true,
+		.synchronization2 = true,
+		.timeline_semaphore = true,
+	};
+}
+
+describe(render_device_selection, {
+	auto discrete = usable_device("NVIDIA GeForce RTX 4070", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU);
+	auto integrated = usable_device("AMD Radeon Graphics", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU);
+	auto software = usable_device("llvmpipe (LLVM 17.0.6, 256 bits)", VK_PHYSICAL_DEVICE_TYPE_CPU);
+
+	it("prefers a discrete GPU over a software device listed first", {
+		auto chosen = select_device({software, integrated, discrete});
+		assert(chosen.has_value() && chosen.value() == 2);
+	});
+
+	it("rejects devices missing required features", {
+		auto old = discrete;
+		old.timeline_semaphore = false;
+		assert(score_device(old) < 0);
+		auto chosen = select_device({old, software});
+		assert(chosen.has_value() && chosen.value() == 1);
+		assert(!select_device({old}).has_value());
+	});
+
+	it("breaks ties with async queues before memory", {
+		auto queues = integrated;
+		queues.dedicated_compute_queue = true;
+		auto memory = integrated;
+		memory.device_local_memory = 16ull << 30;
+		assert(score_device(queues) > score_device(memory));
+		assert(score_device(memory) > score_device(integrated));
+	});
+
+	it("honours a preference by index or name", {
+		std::vector<DeviceInfo> devices{discrete, software};
+		assert(select_device(devices, "1").value() == 1);
+		assert(select_device(devices, "LLVMpipe").value() == 1);
+		assert(select_device(devices, "no such device").value() == 0);
+		assert(select_device(devices, "7").value() == 0);
+	});
+
+	it("rejects indices too large to parse", {
+		bool threw = false;
+		try {
+			select_device({discrete}, "99999999999999999999999");
+		}
+		catch (const std::runtime_error &) {
+			threw = true;
+		}
+		assert(threw);
+	});
+
+	it("rejects devices that can't present to the surface", {
+		auto headless_only = discrete;
+		headless_only.present_queue = false;
+		assert(score_device(headless_only) < 0);
+		assert(select_device({headless_only, integrated}).value() == 1);
+	});
+});
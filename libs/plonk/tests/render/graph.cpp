@@ -0,0 +1,128 @@
+#include "../helpers.h"
+#include <plonk/render_graph.h>
+
+describe(render_graph, {
+	auto noop = [](VkCommandBuffer) {};
+	TransientImageDesc desc{VK_FORMAT_R16G16B16A16_SFLOAT, {64, 64}, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
+
+	it("culls passes whose output is never read", {
+		RenderGraph graph(nullptr);
+		auto output = graph.import_image("output", VK_NULL_HANDLE, {}, true);
+		auto unused = graph.create_image("unused", desc);
+		graph.add_pass("dead", {{unused, ImageAccess::color_attachment(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)}}, noop);
+		graph.add_pass("main", {{output, ImageAccess::color_attachment(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)}}, noop);
+		graph.compile();
+		assert(!graph.is_pass_live("dead"));
+		assert(graph.is_pass_live("main"));
+		assert(graph.transient_memory_size() == 0);
+	});
+
+	it("keeps passes with side effects", {
+		RenderGraph graph(nullptr);
+		auto image = graph.import_image("image", VK_NULL_HANDLE, {});
+		graph.add_pass("readback", {{image, ImageAccess::transfer_read()}}, noop, true);
+		graph.compile();
+		assert(graph.is_pass_live("readback"));
+	});
+
+	it("waits for attachment writes before sampling", {
+		RenderGraph graph(nullptr);
+		auto output = graph.import_image("output", VK_NULL_HANDLE, {}, true);
+		auto shadow = graph.create_image("shadow", desc);
+		graph.add_pass("shadow", {{shadow, ImageAccess::color_attachment(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)}}, noop);
+		graph.add_pass("main", {
+			{shadow, ImageAccess::sampled()},
+			{output, ImageAccess::color_attachment(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)},
+		}, noop);
+		graph.compile();
+
+		auto barriers = graph.get_barriers("main");
+		assert(barriers.size() == 1);
+		assert(barriers[0].resource == shadow);
+		assert(barriers[0].src.stages == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+		assert(barriers[0].src.access == VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT);
+		assert(barriers[0].dst.stages == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+		assert(barriers[0].src.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		assert(barriers[0].dst.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		assert(graph.get_final_state(output).layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	});
+
+	it("transitions layouts and skips barriers between reads", {
+		RenderGraph graph(nullptr);
+		auto image = graph.import_image(
+			"image", VK_NULL_HANDLE,
+			{VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT}
+		);
+		graph.add_pass("first", {{image, ImageAccess::sampled()}}, noop, true);
+		graph.add_pass("second", {{image, ImageAccess::sampled()}}, noop, true);
+		graph.compile();
+
+		auto first = graph.get_barriers("first");
+		assert(first.size() == 1);
+		assert(first[0].src.layout == VK_IMAGE_LAYOUT_GENERAL);
+		assert(first[0].dst.layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		assert(first[0].src.stages == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+		assert(graph.get_barriers("second").empty());
+	});
+
+	it("makes storage buffer writes visible to later passes", {
+		RenderGraph graph(nullptr);
+		auto output = graph.import_image("output", VK_NULL_HANDLE, {}, true);
+		auto counts = graph.import_buffer(
+			"counts", VK_NULL_HANDLE, {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE}
+		);
+		graph.add_pass("write", {}, {{counts, BufferAccess::storage_write()}}, noop);
+		graph.add_pass(
+			"read", {{output, ImageAccess::color_attachment(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)}},
+			{{counts, BufferAccess::storage_read()}}, noop
+		);
+		graph.compile();
+
+		assert(graph.is_pass_live("write"));
+		// Last frame's compute reads finish before the write
+		auto write = graph.get_barriers("write");
+		assert(write.size() == 1);
+		assert(write[0].src.stages == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+		auto read = graph.get_barriers("read");
+		assert(read.size() == 1);
+		assert(read[0].resource == counts);
+		assert(read[0].src.stages == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+		assert(read[0].src.access == VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+		assert(read[0].dst.access == VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+		assert(read[0].dst.layout == VK_IMAGE_LAYOUT_UNDEFINED);
+	});
+
+	it("aliases transient images whose lifetimes don't overlap", {
+		RenderGraph graph(nullptr);
+		auto output = graph.import_image("output", VK_NULL_HANDLE, {}, true);
+		auto a = graph.create_image("a", desc);
+		auto b = graph.create_image("b", desc);
+		auto c = graph.create_image("c", desc);
+		auto write = ImageAccess::color_attachment(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		graph.add_pass("write a", {{a, write}}, noop);
+		graph.add_pass("a to b", {{a, ImageAccess::sampled()}, {b, write}}, noop);
+		graph.add_pass("b to c", {{b, ImageAccess::sampled()}, {c, write}}, noop);
+		graph.add_pass("c to output", {
+			{c, ImageAccess::sampled()},
+			{output, ImageAccess::color_attachment(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)},
+		}, noop);
+		graph.compile();
+
+		// a and b overlap in "a to b", b and c in "b to c", but a is dead by the time c is written
+		assert(graph.get_alias_slot(a) != graph.get_alias_slot(b));
+		assert(graph.get_alias_slot(b) != graph.get_alias_slot(c));
+		assert(graph.get_alias_slot(a) == graph.get_alias_slot(c));
+		assert(graph.transient_memory_size() == 2 * 64 * 64 * 4);
+	});
+
+	it("keeps memory types compatible when aliasing", {
+		std::vector<VkMemoryRequirements> slots;
+		auto assigned = RenderGraph::assign_aliases(
+			{{0, 0}, {1, 1}, {2, 2}}, {{256, 16, 0b01}, {128, 64, 0b10}, {64, 16, 0b11}}, slots
+		);
+		assert(assigned[0] != assigned[1]);
+		assert(slots.size() == 2);
+		assert(slots[assigned[0]].size == 256);
+		assert(slots[assigned[1]].alignment == 64);
+	});
+});
@@ -0,0 +1,25 @@
+#include "../helpers.h"
+#include <plonk/shader_registry.h>
+
+describe(render_shaders, {
+	if (!EMBEDDED_SHADERS->name) {
+		// Built without glslc, so there's nothing to check; CMake also marks this test disabled
+		skip("embedded shaders", "glslc wasn't found, nothing is embedded");
+		return;
+	}
+
+	it("embeds whole SPIR-V words in native order", {
+		for (auto shader = EMBEDDED_SHADERS; shader->name; shader++) {
+			assert(shader->size > 0 && shader->size % 4 == 0, shader->name);
+			assert(shader->code[0] == 0x07230203, shader->name);
+			assert((uintptr_t)shader->code % 16 == 0, shader->name);
+		}
+	});
+
+	it("finds embedded shaders by name", {
+		for (auto shader = EMBEDDED_SHADERS; shader->name; shader++) {
+			assert(find_embedded_shader(shader->name) == shader);
+		}
+		assert(find_embedded_shader("missing.frag") == nullptr);
+	});
+});
@@ -0,0 +1,120 @@
+#include "../helpers.h"
+#include <plonk/brick_map.h>
+#include <plonk/job_system.h>
+#include <cmath>
+#include <cstring>
+
+// Two spheres of radius 1, the second at `second_x` so tests can move it
+static float second_x = 4.0;
+
+static float sphere_distance(float x, float y, float z) {
+	float a = std::sqrt(x * x + y * y + z * z) - 1.0f;
+	float b = std::sqrt((x - second_x) * (x - second_x) + y * y + z * z) - 1.0f;
+	return std::min(a, b);
+}
+
+static void spheres(const float *x, const float *y, const float *z, float *out, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		out[i] = sphere_distance(x[i], y[i], z[i]);
+	}
+}
+
+static BrickMap make_map() {
+	second_x = 4.0;
+	return BrickMap(Point3(-1.0, -1.0, -1.0), Point3(5.0, 1.0, 1.0), 0.125, spheres);
+}
+
+describe(scene_brick_map, {
+	it("only gives cells near the surface a brick", {
+		auto map = make_map();
+		map.bake();
+		auto stats = map.get_stats();
+		assert(stats.bricks > 0);
+		assert(stats.bricks < stats.cells / 2);
+		assert(stats.allocated_bricks == stats.bricks);
+
+		for (size_t i = 0; i < map.get_cells().size(); i++) {
+			auto &cell = map.get_cells()[i];
+			float reach = map.get_cell_size() * 0.8660254f + 0.125f;
+			assert((cell.brick != BrickMap::EMPTY) == (std::abs(cell.distance) <= reach));
+		}
+	});
+
+	it("matches the field near the surface and never overestimates", {
+		auto map = make_map();
+		map.bake();
+		for (int i = 0; i < 200; i++) {
+			// Points on a spiral through and around both spheres, and some outside the map
+			float t = i * 0.1f;
+			Point3 p(t * 0.4f - 2.0f, std::sin(t) * (1.0f + t * 0.1f), std::cos(t) * 1.5f);
+			float exact = sphere_distance(p.coords[0], p.coords[1], p.coords[2]);
+			float baked = map.distance(p);
+			if (std::abs(exact) < 0.5f) {
+				assert(std::abs(baked - exact) < 0.02f);
+			}
+			else {
+				assert(baked <= exact + 0.02f);
+			}
+		}
+		// Far outside the map its bounds stand in for the field
+		assert(map.distance(Point3(50.0, 0.0, 0.0)) > 40.0f);
+		assert(map.distance(Point3(50.0, 0.0, 0.0)) <= sphere_distance(50.0, 0.0, 0.0));
+	});
+
+	it("bakes the same on any number of threads", {
+		auto serial = make_map();
+		serial.bake();
+		auto parallel = make_map();
+		JobSystem jobs(2);
+		parallel.bake(&jobs);
+
+		assert(serial.brick_capacity() == parallel.brick_capacity());
+		for (size_t i = 0; i < serial.get_cells().size(); i++) {
+			assert(serial.get_cells()[i].brick == parallel.get_cells()[i].brick);
+		}
+		size_t bytes = serial.brick_capacity() * BrickMap::BRICK_VOXELS * sizeof(float);
+		assert(std::memcmp(serial.brick_data(0), parallel.brick_data(0), bytes) == 0);
+	});
+
+	it("rebakes only the cells around an edit", {
+		auto map = make_map();
+		map.bake();
+		auto baked = map.take_changes();
+		assert(baked.bricks.size() == map.get_stats().bricks);
+		assert(baked.cell_end == map.get_dimensions());
+		assert(map.take_changes().bricks.empty());
+
+		// Nudge the second sphere, well away from the first sphere's cells
+		second_x = 4.25;
+		auto first_cells = map.get_cells();
+		map.rebake(Point3(3.0, -1.0, -1.0), Point3(5.25, 1.0, 1.0));
+		auto changes = map.take_changes();
+		assert(changes.has_cells());
+		assert(changes.cell_begin[0] > 0);
+		assert(changes.bricks.size() < baked.bricks.size());
+		for (size_t i = 0; i < first_cells.size(); i++) {
+			auto min_x = map.get_origin().coords[0] + (i % map.get_dimensions()[0]) * map.get_cell_size();
+			if (min_x < 1.5f) {
+				assert(first_cells[i].brick == map.get_cells()[i].brick);
+			}
+		}
+		assert(std::abs(map.distance(Point3(5.25, 0.0, 0.0))) < 0.02f);
+	});
+
+	it("reuses the bricks it frees", {
+		auto map = make_map();
+		map.bake();
+		auto capacity = map.brick_capacity();
+
+		// Move the second sphere half a unit, freeing bricks on one side and needing them on the other
+		second_x = 3.5;
+		map.rebake(Point3(2.5, -1.0, -1.0), Point3(5.0, 1.0, 1.0));
+		assert(map.brick_capacity() <= capacity + capacity / 10);
+		assert(std::abs(map.distance(Point3(4.5, 0.0, 0.0))) < 0.02f);
+		assert(std::abs(map.distance(Point3(3.5, 0.0, 1.0))) < 0.02f);
+
+		second_x = 4.0;
+		map.rebake(Point3(2.5, -1.0, -1.0), Point3(5.0, 1.0, 1.0));
+		assert(map.get_stats().bricks <= capacity);
+	});
+});
@@ -0,0 +1,126 @@
+#include "../helpers.h"
+#include <plonk/scene_file.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+static const char *SCENE_TEXT = R"(
+# Two materials, a transform under another, and one primitive without a transform
+material  red   1.0 0.1 0.2
+material  green 0.3 0.9 0.1
+transform base  -    0 5 12  0 0 0  1 1 1
+transform arm   base 2 0 0   0 0 0  2 2 2
+sphere    red   base 0   5
+box       green arm  2.5 1 2 3
+sphere    green -    0   1
+)";
+
+static std::string temp_path(const char *name) {
+	return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static bool throws(std::function<void()> fn) {
+	try {
+		fn();
+	}
+	catch (const std::runtime_error &) {
+		return true;
+	}
+	return false;
+}
+
+describe(scene_file_format, {
+	it("parses text scenes", {
+		std::istringstream text(SCENE_TEXT);
+		auto scene = SceneDescription::parse(text);
+		assert(scene.primitives.size() == 3);
+		assert(scene.materials.size() == 2);
+		assert(scene.transforms.size() == 2);
+
+		auto &box = scene.primitives[1];
+		assert(box.type == PrimitiveType::BOX);
+		assert(box.material == 1);
+		assert(box.transform == 1);
+		assert_approx(box.blend, 2.5);
+		assert_approx(box.size[2], 3.0);
+		assert(scene.primitives[2].transform == ScenePrimitive::NO_TRANSFORM);
+		assert_approx(scene.materials[0].color[1], 0.1);
+	});
+
+	it("stores world to local transforms, nested", {
+		std::istringstream text(SCENE_TEXT);
+		auto scene = SceneDescription::parse(text);
+		// `arm` is at (2, 5, 12) scaled by 2, so that point maps to its origin and one further along x to 0.5
+		auto &m = scene.transforms[1].world_to_local;
+		auto x = [&](float px, float py, float pz) { return m[0] * px + m[4] * py + m[8] * pz + m[12]; };
+		assert_approx(x(2.0, 5.0, 12.0), 0.0);
+		assert_approx(x(3.0, 5.0, 12.0), 0.5);
+	});
+
+	it("reads back what it writes, in place", {
+		std::istringstream text(SCENE_TEXT);
+		auto scene = SceneDescription::parse(text);
+		auto path = temp_path("plonk_test_scene.plsc");
+		scene.write(path);
+
+		SceneFile file(path);
+		auto &header = file.get_header();
+		assert(header.version == SceneFile::VERSION);
+		assert(file.size() == header.file_size);
+		assert(header.primitives.offset % SceneFile::SECTION_ALIGNMENT == 0);
+		assert(header.materials.offset % SceneFile::SECTION_ALIGNMENT == 0);
+		assert(header.transforms.offset % SceneFile::SECTION_ALIGNMENT == 0);
+		assert(file.primitives().size() == 3);
+		assert(std::memcmp(file.primitives().data(), scene.primitives.data(), 3 * sizeof(ScenePrimitive)) == 0);
+		assert(std::memcmp(file.materials().data(), scene.materials.data(), 2 * sizeof(SceneMaterial)) == 0);
+		assert(std::memcmp(file.transforms().data(), scene.transforms.data(), 2 * sizeof(SceneTransform)) == 0);
+		// Sections are read straight from the mapping
+		assert((const uint8_t *)file.primitives().data() == file.data() + header.primitives.offset);
+		std::filesystem::remove(path);
+	});
+
+	it("rejects malformed text", {
+		auto parse = [](const char *text) {
+			return [=]() {
+				std::istringstream input(text);
+				SceneDescription::parse(input);
+			};
+		};
+		assert(throws(parse("material red 1 0\nsphere red - 0 1\n")));
+		assert(throws(parse("sphere missing - 0 1\n")));
+		assert(throws(parse("material red 1 0 0\nsphere red nowhere 0 1\n")));
+		assert(throws(parse("material red 1 0 0\ncone red - 0 1\n")));
+		assert(throws(parse("material red 1 0 0\n")));
+	});
+
+	it("rejects files that aren't valid scenes", {
+		std::istringstream text(SCENE_TEXT);
+		auto scene = SceneDescription::parse(text);
+		auto path = temp_path("plonk_test_bad_scene.plsc");
+
+		auto corrupt = [&](size_t offset, uint8_t value) {
+			scene.write(path);
+			std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+			file.seekp(offset);
+			file.put((char)value);
+		};
+		// Magic, version, then the primitive section's stride
+		corrupt(0, 'X');
+		assert(throws([&]() { SceneFile file(path); }));
+		corrupt(4, 2);
+		assert(throws([&]() { SceneFile file(path); }));
+		corrupt(offsetof(SceneFileHeader, primitives) + offsetof(SceneSection, stride), 16);
+		assert(throws([&]() { SceneFile file(path); }));
+
+		// Truncated
+		scene.write(path);
+		std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+		assert(throws([&]() { SceneFile file(path); }));
+		std::filesystem::resize_file(path, 10);
+		assert(throws([&]() { SceneFile file(path); }));
+
+		std::filesystem::remove(path);
+		assert(throws([&]() { SceneFile file(path); }));
+	});
+});
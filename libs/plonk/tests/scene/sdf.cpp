@@ -0,0 +1,74 @@
+#include "../helpers.h"
+#include <plonk/scene_sdf.h>
+
+describe(scene_sdf, {
+	SceneSdf scene;
+
+	it("blends the ball and box distances", {
+		// Ball is 10 away and box 11 away, smoothly unioned with k = 5
+		Vector3V p(Point3(0.0, -10.0, 12.0));
+		auto result = scene.get_distance(p);
+		assert_approx(result.d[0], 9.2f);
+		assert_approx(result.d[0], result.d[SIMD_LANES - 1]);
+	});
+
+	it("marches rays to the surface", {
+		Vector3V ro(Point3(0.0, -10.0, 12.0));
+		Vector3V rd(Vector3(0.0, 1.0, 0.0));
+		MaskV steps;
+		auto result = scene.ray_march(ro, rd, splat_mask(true), steps);
+		auto p = ro + rd * result.d;
+		assert(scene.get_distance(p).d[0] < SceneSdf::SURFACE_DIST);
+		assert(steps[0] > 0 && steps[0] < SceneSdf::MAX_STEPS);
+	});
+
+	it("leaves inactive lanes untouched", {
+		Vector3V ro(Point3(0.0, -10.0, 12.0));
+		Vector3V rd(Vector3(0.0, 1.0, 0.0));
+		MaskV active = splat_mask(false);
+		active[0] = -1;
+		MaskV steps;
+		auto result = scene.ray_march(ro, rd, active, steps);
+		assert(result.d[0] > 0.0f);
+		assert_approx(result.d[1], 0.0f);
+	});
+
+	it("escapes to the sky", {
+		Vector3V ro(Point3(0.0, 0.0, 0.0));
+		Vector3V rd(Vector3(0.0, 0.0, -1.0));
+		MaskV steps;
+		auto result = scene.ray_march(ro, rd, splat_mask(true), steps);
+		assert(result.d[0] > SceneSdf::MAX_DIST);
+		assert_approx(result.color.x[0], 0.1f);
+	});
+
+	it("evaluates batches of points", {
+		float x[] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+		float y[] = {-10.0, -10.0, -10.0, -10.0, -10.0, -10.0, -10.0, -10.0, -10.0, -10.0, 5.0};
+		float z[] = {12.0, 12.0, 12.0, 12.0, 12.0, 12.0, 12.0, 12.0, 12.0, 12.0, 12.0};
+		float out[11];
+		scene.distances(x, y, z, out, 11);
+		assert_approx(out[9], 9.2f);
+		assert(out[10] < 0.0f);
+	});
+
+	it("raycasts to the nearest surface", {
+		auto hit = scene.raycast(Point3(0.0, -10.0, 12.0), Vector3(0.0, 1.0, 0.0));
+		assert(hit.has_value());
+		assert(hit->normal.y() < -0.9f);
+		assert(!scene.raycast(Point3(0.0, 0.0, 0.0), Vector3(0.0, 0.0, -1.0)).has_value());
+	});
+
+	it("stops a sphere at the surface and slides along it", {
+		Point3 from(0.0, -10.0, 12.0);
+		Point3 blocked = scene.sweep_sphere(from, Point3(0.0, 10.0, 12.0), 1.0);
+		assert(scene.distance(blocked) >= 1.0f - SceneSdf::SURFACE_DIST * 2.0f);
+		assert(blocked.y() < 0.0f);
+
+		Point3 slid = scene.sweep_sphere(from, Point3(3.0, 10.0, 12.0), 1.0);
+		assert(slid.x() > 0.0f);
+
+		Point3 free = scene.sweep_sphere(from, Point3(0.0, -20.0, 12.0), 1.0);
+		assert_approx(free.y(), -20.0f);
+	});
+});
@@ -0,0 +1,120 @@
+#include "../helpers.h"
+#include <plonk/transforms.h>
+#include <cmath>
+#include <vector>
+
+static bool matrices_match(const Matrix4 &a, const Matrix4 &b) {
+	for (int i = 0; i < 16; i++) {
+		if (std::abs(a[i] - b[i]) > 0.0001f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static Transform moved(float x, float y, float z) {
+	Transform transform;
+	transform.translation = Vector3(x, y, z);
+	return transform;
+}
+
+describe(scene_transforms, {
+	it("composes translation, rotation and scale like Matrix4", {
+		Transform transform{
+			.translation = Vector3(1.0, 2.0, 3.0),
+			.rotation = Vector3(0.3, -0.7, 1.1),
+			.scale = Vector3(2.0, 0.5, 1.5),
+		};
+		auto expected = Matrix4::from_translation(1.0, 2.0, 3.0) * Matrix4::from_rotation(0.3, -0.7, 1.1) *
+			Matrix4::from_scaling(2.0, 0.5, 1.5);
+		assert(matrices_match(transform.to_matrix(), expected));
+	});
+
+	it("multiplies world matrices down the hierarchy", {
+		TransformHierarchy transforms;
+		Transform spun;
+		spun.rotation = Vector3(0.0, 0.5, 0.0);
+		auto root = transforms.add(spun);
+		auto child = transforms.add(moved(1.0, 0.0, 0.0), root);
+		auto grandchild = transforms.add(moved(0.0, 2.0, 0.0), child);
+		transforms.update();
+
+		auto expected = spun.to_matrix() * moved(1.0, 0.0, 0.0).to_matrix() * moved(0.0, 2.0, 0.0).to_matrix();
+		assert(matrices_match(transforms.get_world(grandchild), expected));
+		assert(transforms.depth_count() == 3);
+	});
+
+	it("propagates changes to children only", {
+		TransformHierarchy transforms;
+		auto a = transforms.add(moved(1.0, 0.0, 0.0));
+		auto b = transforms.add(moved(0.0, 1.0, 0.0));
+		auto a_child = transforms.add(moved(0.0, 0.0, 1.0), a);
+		transforms.update();
+		std::vector<Matrix4> packed(transforms.size());
+		auto packed_version = transforms.pack(packed.data(), 0);
+
+		transforms.set_local(a, moved(5.0, 0.0, 0.0));
+		transforms.update();
+		assert(transforms.get_world(a_child)[12] == 5.0f);
+		assert(transforms.get_world(a_child)[14] == 1.0f);
+
+		// Only a and its child changed, so b's stale copy should be left alone
+		packed[transforms.get_index(b)][13] = -1.0f;
+		transforms.pack(packed.data(), packed_version);
+		assert(packed[transforms.get_index(a_child)][12] == 5.0f);
+		assert(packed[transforms.get_index(b)][13] == -1.0f);
+	});
+
+	it("keeps depths sorted when nodes are added out of order", {
+		TransformHierarchy transforms;
+		auto root = transforms.add(moved(1.0, 0.0, 0.0));
+		auto child = transforms.add(moved(1.0, 0.0, 0.0), root);
+		auto grandchild = transforms.add(moved(1.0, 0.0, 0.0), child);
+		auto late_root = transforms.add(moved(0.0, 3.0, 0.0));
+		auto late_child = transforms.add(moved(0.0, 3.0, 0.0), late_root);
+		transforms.update();
+
+		assert(transforms.get_index(late_root) < transforms.get_index(child));
+		assert(transforms.get_index(late_child) < transforms.get_index(grandchild));
+		assert(transforms.get_world(late_child)[13] == 6.0f);
+	});
+
+	it("removes whole subtrees", {
+		TransformHierarchy transforms;
+		auto root = transforms.add({});
+		auto removed = transforms.add(moved(1.0, 0.0, 0.0), root);
+		auto removed_child = transforms.add({}, removed);
+		auto kept = transforms.add(moved(0.0, 1.0, 0.0), root);
+		transforms.update();
+
+		transforms.remove(removed);
+		assert(transforms.size() == 2);
+		assert(!transforms.contains(removed));
+		assert(!transforms.contains(removed_child));
+		assert(transforms.contains(kept));
+
+		transforms.set_local(root, moved(0.0, 0.0, 2.0));
+		transforms.update();
+		assert(transforms.get_world(kept)[13] == 1.0f);
+		assert(transforms.get_world(kept)[14] == 2.0f);
+	});
+
+	it("gives the same results in parallel", {
+		auto jobs = std::make_shared<JobSystem>(4);
+		TransformHierarchy serial, parallel;
+		std::vector<TransformHandle> serial_nodes, parallel_nodes;
+		for (int i = 0; i < 20000; i++) {
+			Transform local;
+			local.translation = Vector3(i % 7, i % 5, i % 3);
+			local.rotation = Vector3(i * 0.01f, 0.0, 0.0);
+			auto parent = i == 0 ? 0 : (i - 1) / 4;
+			serial_nodes.push_back(serial.add(local, i == 0 ? TransformHandle{} : serial_nodes[parent]));
+			parallel_nodes.push_back(parallel.add(local, i == 0 ? TransformHandle{} : parallel_nodes[parent]));
+		}
+		serial.update();
+		parallel.update(jobs.get());
+		for (int i = 0; i < 20000; i += 97) {
+			assert(matrices_match(serial.get_world(serial_nodes[i]), parallel.get_world(parallel_nodes[i])));
+		}
+	});
+});
@@ -0,0 +1,158 @@
+#include "include/plonk/trace.h"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent {
+	const char *name;
+	uint64_t start_ns;
+	uint64_t duration_ns;
+};
+
+// Single producer, single consumer ring. The owning thread writes events and publishes them with `write_index`,
+// `Trace::flush` reads published events under the registry lock and hands their slots back with `read_index`. A slot
+// is never written until it's been read, so the writer drops events while the ring is full.
+struct TraceBuffer {
+	static const uint64_t CAPACITY = 1 << 16;
+
+	uint32_t thread_id = 0;
+	std::string name;
+	std::atomic<uint64_t> write_index = 0;
+	std::atomic<uint64_t> read_index = 0;
+	std::atomic<uint64_t> dropped = 0;
+	TraceEvent events[CAPACITY];
+};
+
+struct FlushedEvent {
+	std::string name;
+	uint64_t start_ns;
+	uint64_t duration_ns;
+	uint32_t thread_id;
+};
+
+static const uint32_t GPU_THREAD_ID = 0;
+
+static std::mutex registry_mutex;
+// Buffers outlive their threads so events from finished threads can still be flushed
+static std::vector<std::unique_ptr<TraceBuffer>> buffers;
+static std::vector<FlushedEvent> flushed;
+static auto epoch = std::chrono::steady_clock::now();
+
+static TraceBuffer &thread_buffer() {
+	thread_local TraceBuffer *buffer = nullptr;
+	if (!buffer) {
+		auto owned = std::make_unique<TraceBuffer>();
+		buffer = owned.get();
+		std::lock_guard lock(registry_mutex);
+		buffer->thread_id = buffers.size() + 1;
+		buffer->name = "Thread " + std::to_string(buffer->thread_id);
+		buffers.push_back(std::move(owned));
+	}
+	return *buffer;
+}
+
+static void write_escaped(std::ofstream &file, const std::string &text) {
+	for (auto c : text) {
+		if (c == '"' || c == '\\') {
+			file << '\\';
+		}
+		file << c;
+	}
+}
+
+uint64_t Trace::now_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const char *name, uint64_t start_ns, uint64_t duration_ns) {
+	auto &buffer = thread_buffer();
+	auto index = buffer.write_index.load(std::memory_order_relaxed);
+	if (index - buffer.read_index.load(std::memory_order_acquire) >= TraceBuffer::CAPACITY) {
+		buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	buffer.events[index % TraceBuffer::CAPACITY] = {
+		.name = name,
+		.start_ns = start_ns,
+		.duration_ns = duration_ns,
+	};
+	buffer.write_index.store(index + 1, std::memory_order_release);
+}
+
+/**
+ * Add a GPU event to the trace, already converted to the CPU trace clock
+ */
+void Trace::record_gpu(const std::string &name, uint64_t start_ns, uint64_t duration_ns) {
+	std::lock_guard lock(registry_mutex);
+	flushed.push_back({
+		.name = name,
+		.start_ns = start_ns,
+		.duration_ns = duration_ns,
+		.thread_id = GPU_THREAD_ID,
+	});
+}
+
+void Trace::set_thread_name(const std::string &name) {
+	auto &buffer = thread_buffer();
+	std::lock_guard lock(registry_mutex);
+	buffer.name = name;
+}
+
+/**
+ * Drain every thread's ring into the trace. Call this periodically; events recorded while a ring is full are dropped.
+ */
+void Trace::flush() {
+	std::lock_guard lock(registry_mutex);
+	for (auto &buffer : buffers) {
+		auto start = buffer->read_index.load(std::memory_order_relaxed);
+		auto end = buffer->write_index.load(std::memory_order_acquire);
+		for (auto i = start; i < end; i++) {
+			auto &event = buffer->events[i % TraceBuffer::CAPACITY];
+			flushed.push_back({
+				.name = event.name,
+				.start_ns = event.start_ns,
+				.duration_ns = event.duration_ns,
+				.thread_id = buffer->thread_id,
+			});
+		}
+		// Only now can the writer reuse these slots
+		buffer->read_index.store(end, std::memory_order_release);
+	}
+}
+
+void Trace::write(const std::string &filename) {
+	flush();
+
+	std::ofstream file(filename);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open trace output");
+	}
+
+	std::lock_guard lock(registry_mutex);
+	uint64_t dropped = 0;
+	for (auto &buffer : buffers) {
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	file << "{\"otherData\":{\"dropped_events\":" << dropped << "},\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << GPU_THREAD_ID
+		 << ",\"args\":{\"name\":\"GPU\"}}";
+	for (auto &buffer : buffers) {
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+			 << ",\"args\":{\"name\":\"";
+		write_escaped(file, buffer->name);
+		file << "\"}}";
+	}
+
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	for (auto &event : flushed) {
+		file << ",\n{\"name\":\"";
+		write_escaped(file, event.name);
+		file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread_id << ",\"ts\":" << event.start_ns / 1000.0
+			 << ",\"dur\":" << event.duration_ns / 1000.0 << "}";
+	}
+	file << "\n]}\n";
+}
@@ -0,0 +1,315 @@
+#include "include/plonk/transforms.h"
+#include "include/plonk/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static void compose(const Vector3 &translation, const Vector3 &rotation, const Vector3 &scale, Matrix4 &out) {
+	float cx = std::cos(rotation.coords[0]), sx = std::sin(rotation.coords[0]);
+	float cy = std::cos(rotation.coords[1]), sy = std::sin(rotation.coords[1]);
+	float cz = std::cos(rotation.coords[2]), sz = std::sin(rotation.coords[2]);
+	// Columns of rotz * roty * rotx, each scaled
+	out[0] = cz * cy * scale.coords[0];
+	out[1] = sz * cy * scale.coords[0];
+	out[2] = -sy * scale.coords[0];
+	out[3] = 0.0f;
+	out[4] = (cz * sy * sx - sz * cx) * scale.coords[1];
+	out[5] = (sz * sy * sx + cz * cx) * scale.coords[1];
+	out[6] = cy * sx * scale.coords[1];
+	out[7] = 0.0f;
+	out[8] = (cz * sy * cx + sz * sx) * scale.coords[2];
+	out[9] = (sz * sy * cx - cz * sx) * scale.coords[2];
+	out[10] = cy * cx * scale.coords[2];
+	out[11] = 0.0f;
+	out[12] = translation.coords[0];
+	out[13] = translation.coords[1];
+	out[14] = translation.coords[2];
+	out[15] = 1.0f;
+}
+
+// parent * local, for matrices whose bottom row is 0 0 0 1 as every composed transform's is
+static void multiply_affine(const Matrix4 &parent, const Matrix4 &local, Matrix4 &out) {
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 3; row++) {
+			out[column * 4 + row] = parent[row] * local[column * 4] + parent[4 + row] * local[column * 4 + 1] +
+				parent[8 + row] * local[column * 4 + 2] + (column == 3 ? parent[12 + row] : 0.0f);
+		}
+		out[column * 4 + 3] = column == 3 ? 1.0f : 0.0f;
+	}
+}
+
+Matrix4 Transform::to_matrix() const {
+	Matrix4 matrix;
+	compose(translation, rotation, scale, matrix);
+	return matrix;
+}
+
+/**
+ * Add a node under `parent`, or as a root without one. Its world matrix is ready after the next update.
+ */
+TransformHandle TransformHierarchy::add(const Transform &local, TransformHandle parent) {
+	uint32_t parent_index = parent ? index_of(parent) : NO_PARENT;
+	uint32_t depth = parent ? depths[parent_index] + 1 : 0;
+	if (!depths.empty() && depth < depths.back()) {
+		needs_sort = true;
+	}
+	auto node = indices.insert(handles.size());
+	handles.push_back(node);
+	parents.push_back(parent_index);
+	depths.push_back(depth);
+	translations.push_back(local.translation);
+	rotations.push_back(local.rotation);
+	scales.push_back(local.scale);
+	worlds.push_back(Matrix4::identity());
+	dirty.push_back(1);
+	changed.push_back(0);
+	shape_changed = true;
+	return node;
+}
+
+/**
+ * Remove `node` and everything below it
+ */
+void TransformHierarchy::remove(TransformHandle node) {
+	if (needs_sort) {
+		sort_by_depth();
+	}
+	auto first = index_of(node);
+	// Parents come before their children, so one pass from the node finds its whole subtree
+	std::vector<uint8_t> removed(handles.size(), 0);
+	removed[first] = 1;
+	for (uint32_t i = first + 1; i < handles.size(); i++) {
+		removed[i] = parents[i] != NO_PARENT && removed[parents[i]];
+	}
+
+	std::vector<uint32_t> order;
+	order.reserve(handles.size());
+	for (uint32_t i = 0; i < handles.size(); i++) {
+		if (removed[i]) {
+			indices.remove(handles[i]);
+		}
+		else {
+			order.push_back(i);
+		}
+	}
+	reorder(order);
+}
+
+void TransformHierarchy::set_local(TransformHandle node, const Transform &local) {
+	auto index = index_of(node);
+	translations[index] = local.translation;
+	rotations[index] = local.rotation;
+	scales[index] = local.scale;
+	dirty[index] = 1;
+}
+
+Transform TransformHierarchy::get_local(TransformHandle node) {
+	auto index = index_of(node);
+	return {
+		.translation = translations[index],
+		.rotation = rotations[index],
+		.scale = scales[index],
+	};
+}
+
+/**
+ * The node's world matrix as of the last update
+ */
+const Matrix4 &TransformHierarchy::get_world(TransformHandle node) {
+	return worlds[index_of(node)];
+}
+
+/**
+ * Where the node's matrix is in `world_matrices` and packed buffers, until the next add or remove
+ */
+uint32_t TransformHierarchy::get_index(TransformHandle node) {
+	if (needs_sort) {
+		sort_by_depth();
+	}
+	return index_of(node);
+}
+
+/**
+ * Recompute the world matrix of every node that's changed, or is below one that has, a depth at a time
+ */
+void TransformHierarchy::update(JobSystem *jobs) {
+	TRACE_FUNCTION();
+	if (needs_sort) {
+		sort_by_depth();
+	}
+	if (shape_changed) {
+		rebuild_levels();
+	}
+	version++;
+
+	auto update_range = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			auto parent = parents[i];
+			bool parent_dirty = parent != NO_PARENT && dirty[parent];
+			if (!dirty[i] && !parent_dirty) {
+				continue;
+			}
+			if (parent == NO_PARENT) {
+				compose(translations[i], rotations[i], scales[i], worlds[i]);
+			}
+			else {
+				Matrix4 local;
+				compose(translations[i], rotations[i], scales[i], local);
+				multiply_affine(worlds[parent], local, worlds[i]);
+			}
+			// Passes the change down to this node's children at the next depth
+			dirty[i] = 1;
+			changed[i] = version;
+		}
+	};
+	for (uint32_t depth = 0; depth < depth_count(); depth++) {
+		auto begin = level_starts[depth];
+		auto end = level_starts[depth + 1];
+		if (jobs && end - begin > GRAIN) {
+			jobs->parallel_for(begin, end, GRAIN, update_range);
+		}
+		else {
+			update_range(begin, end);
+		}
+	}
+
+	std::fill(dirty.begin(), dirty.end(), 0);
+	if (shape_changed) {
+		// Indices have moved, so every packed copy is out of date
+		std::fill(changed.begin(), changed.end(), version);
+		shape_changed = false;
+	}
+}
+
+/**
+ * Copy world matrices that changed after `packed_version` to `destination`, at their nodes' indices, returning the
+ * version to pass next time. Pass 0 to copy them all.
+ */
+uint64_t TransformHierarchy::pack(Matrix4 *destination, uint64_t packed_version, JobSystem *jobs) {
+	TRACE_FUNCTION();
+	auto copy_range = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			if (changed[i] > packed_version) {
+				destination[i] = worlds[i];
+			}
+		}
+	};
+	if (jobs && worlds.size() > GRAIN) {
+		jobs->parallel_for(0, worlds.size(), GRAIN * 4, copy_range);
+	}
+	else {
+		copy_range(0, worlds.size());
+	}
+	return version;
+}
+
+uint32_t TransformHierarchy::index_of(TransformHandle node) {
+	auto index = indices.get(node);
+	if (!index) {
+		throw std::runtime_error("Stale transform handle");
+	}
+	return *index;
+}
+
+/**
+ * Keep only the nodes in `order`, in that order. Parents must come before their children.
+ */
+void TransformHierarchy::reorder(const std::vector<uint32_t> &order) {
+	std::vector<uint32_t> new_index(handles.size(), NO_PARENT);
+	for (uint32_t i = 0; i < order.size(); i++) {
+		new_index[order[i]] = i;
+	}
+	auto permute = [&](auto &values) {
+		std::remove_reference_t<decltype(values)> sorted;
+		sorted.reserve(order.size());
+		for (auto i : order) {
+			sorted.push_back(values[i]);
+		}
+		values.swap(sorted);
+	};
+	permute(handles);
+	permute(parents);
+	permute(depths);
+	permute(translations);
+	permute(rotations);
+	permute(scales);
+	permute(worlds);
+	permute(dirty);
+	permute(changed);
+	for (uint32_t i = 0; i < order.size(); i++) {
+		if (parents[i] != NO_PARENT) {
+			parents[i] = new_index[parents[i]];
+		}
+		*indices.get(handles[i]) = i;
+	}
+	shape_changed = true;
+}
+
+void TransformHierarchy::sort_by_depth() {
+	std::vector<uint32_t> order(handles.size());
+	for (uint32_t i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+	// Stable, so nodes keep their relative order within a depth
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+	reorder(order);
+	needs_sort = false;
+}
+
+void TransformHierarchy::rebuild_levels() {
+	level_starts.clear();
+	for (uint32_t i = 0; i < depths.size(); i++) {
+		while (level_starts.size() <= depths[i]) {
+			level_starts.push_back(i);
+		}
+	}
+	level_starts.push_back(depths.size());
+}
+
+TransformBuffer::TransformBuffer(ContextPtr ctx) : ctx(ctx) {}
+
+TransformBuffer::~TransformBuffer() {
+	vkDeviceWaitIdle(ctx->device);
+	for (auto &slot : slots) {
+		release(slot);
+	}
+}
+
+/**
+ * Bring the current frame slot's buffer up to date with `transforms`' last update, and return it. Call after
+ * acquiring the frame, so the GPU has finished reading the slot's buffer.
+ */
+VkBuffer TransformBuffer::upload(TransformHierarchy &transforms, JobSystem *jobs) {
+	TRACE_FUNCTION();
+	auto &slot = slots[ctx->frame_slot()];
+	auto count = std::max(transforms.size(), (size_t)1);
+	if (slot.capacity < count) {
+		// Nothing reads the old buffer any more, as this slot's last frame has finished
+		release(slot);
+		// Grow ahead, so a scene that streams nodes in doesn't reallocate every frame
+		slot.capacity = std::max(count + count / 2, (size_t)256);
+		ctx->create_buffer(
+			slot.capacity * sizeof(Matrix4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot.buffer, slot.memory
+		);
+		if (VK_SUCCESS != vkMapMemory(ctx->device, slot.memory, 0, VK_WHOLE_SIZE, 0, (void **)&slot.mapped)) {
+			vkDestroyBuffer(ctx->device, slot.buffer, nullptr);
+			vkFreeMemory(ctx->device, slot.memory, nullptr);
+			slot = Slot{};
+			throw std::runtime_error("Failed to map Transform Buffer");
+		}
+		slot.version = 0;
+	}
+	slot.version = transforms.pack(slot.mapped, slot.version, jobs);
+	return slot.buffer;
+}
+
+void TransformBuffer::release(Slot &slot) {
+	if (!slot.buffer) {
+		return;
+	}
+	vkUnmapMemory(ctx->device, slot.memory);
+	vkDestroyBuffer(ctx->device, slot.buffer, nullptr);
+	vkFreeMemory(ctx->device, slot.memory, nullptr);
+	slot = Slot{};
+}
@@ -1,7 +1,9 @@
 #include "include/plonk/window.h"
+#include "include/plonk/trace.h"
+#include "include/plonk/log.h"
 #include <chrono>
-#include <iostream>
 #include <thread>
+#include "x11_blit.h"
 
 void Window::glfw_key_callback(GLFWwindow* inner, int key, int scancode, int action, int mods) {
 	Window *window = static_cast<Window*>(glfwGetWindowUserPointer(inner));
@@ -25,7 +27,7 @@ void Window::glfw_mouse_callback(GLFWwindow* inner, double x, double y) {
 
 Window::Window(int width, int height) {
 	if (!glfwInit()) {
-		std::cout << "Error initialising glfw\n";
+		LOG_ERROR("Error initialising glfw");
 		return;
 	}
 
@@ -36,7 +38,7 @@ Window::Window(int width, int height) {
 	glfwSetWindowUserPointer(inner, this);
 
 	if (!inner) {
-		std::cout << "Error creating window\n";
+		LOG_ERROR("Error creating window");
 		glfwTerminate();
 		return;
 	}
@@ -45,7 +47,7 @@ Window::Window(int width, int height) {
 	glfwSetKeyCallback(inner, glfw_key_callback);
 	glfwSetCursorPosCallback(inner, glfw_mouse_callback);
 
-	std::cout << "Finished Plonk\n";
+	LOG_DEBUG("Finished Plonk");
 }
 
 int Window::width() {
@@ -83,6 +85,7 @@ bool Window::is_open() {
 }
 
 bool Window::poll() {
+	TRACE_FUNCTION();
 	glfwPollEvents();
 	return is_open();
 }
@@ -126,12 +129,12 @@ Point2 Window::mouse_position() {
 }
 
 void Window::grab_mouse() {
-	printf("Grabbing mouse\n");
+	LOG_DEBUG("Grabbing mouse");
 	glfwSetInputMode(inner, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 }
 
 void Window::release_mouse() {
-	printf("Releasing mouse\n");
+	LOG_DEBUG("Releasing mouse");
 	glfwSetInputMode(inner, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 }
 
@@ -140,7 +143,31 @@ bool Window::is_mouse_grabbed() {
 	return mode == GLFW_CURSOR_DISABLED;
 }
 
+/**
+ * Like all GLFW window calls this must happen on the main thread; use `JobSystem::run_on_main` from jobs
+ */
+void Window::set_title(const std::string &title) {
+	glfwSetWindowTitle(inner, title.c_str());
+}
+
+/**
+ * Blit a CPU rendered image straight to the window, for when there's no Vulkan device to present with
+ */
+void Window::present(const Image &image) {
+	TRACE_FUNCTION();
+	// X wants BGRX in native byte order
+	present_buffer.resize(image.pixels.size());
+	for (size_t i = 0; i < image.pixels.size(); i += 4) {
+		present_buffer[i + 0] = image.pixels[i + 2];
+		present_buffer[i + 1] = image.pixels[i + 1];
+		present_buffer[i + 2] = image.pixels[i + 0];
+		present_buffer[i + 3] = 255;
+	}
+
+	x11_blit(inner, present_buffer.data(), image.width, image.height);
+}
+
 Window::~Window() {
-	std::cout << "Terminating GLFW window\n";
+	LOG_DEBUG("Terminating GLFW window");
 	glfwTerminate();
 }
@@ -0,0 +1,18 @@
+#include "x11_blit.h"
+#define GLFW_EXPOSE_NATIVE_X11
+#include <GLFW/glfw3.h>
+#include <GLFW/glfw3native.h>
+
+void x11_blit(GLFWwindow *window, const uint8_t *bgrx, uint32_t width, uint32_t height) {
+	Display *display = glfwGetX11Display();
+	int screen = DefaultScreen(display);
+	XImage *image = XCreateImage(
+		display, DefaultVisual(display, screen), DefaultDepth(display, screen), ZPixmap, 0, (char *)bgrx, width,
+		height, 32, 0
+	);
+	XPutImage(display, glfwGetX11Window(window), DefaultGC(display, screen), image, 0, 0, 0, 0, width, height);
+	// The pixels belong to the caller, don't let X free them
+	image->data = nullptr;
+	XDestroyImage(image);
+	XFlush(display);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+
+struct GLFWwindow;
+
+// Kept apart from window.h, as Xlib's `Window` typedef clashes with our Window class
+void x11_blit(GLFWwindow *window, const uint8_t *bgrx, uint32_t width, uint32_t height);
@@ -0,0 +1,185 @@
+#define MAX_STEPS 256
+#define MAX_DIST 1024.0
+#define SURFACE_DIST 0.01
+
+layout(push_constant)
+	uniform _ {
+		vec2 screenSize;
+		vec3 position;
+		vec3 direction;
+		float time;
+		vec3 prevPosition;
+		float historyWeight;
+		vec3 prevDirection;
+		uint frame;
+		uint debugMode;
+	} u;
+
+#define DEBUG_OFF 0u
+#define DEBUG_PRIMARY_STEPS 1u
+#define DEBUG_SHADOW_STEPS 2u
+
+// Per-pixel march step counts: full resolution primary rays, then the shadow buffer's texels
+layout(set = 1, binding = 0) buffer StepCounts {
+	uint stepCounts[];
+};
+
+struct DistanceResult {
+	float d;
+	vec3 color;
+};
+
+float sdfSphere(vec3 p, float rad) {
+	return length(p) - rad;
+}
+
+float sdfBox(vec3 p, vec3 size) {
+	vec3 q = abs(p) - size;
+	return length(max(q, 0.0)) + min(max(q.x, max(q.y, q.z)), 0.0);
+}
+
+// Static geometry baked into a sparse grid of bricks, see brick_map.h
+#define BRICK_SIZE 8u
+#define BRICK_EMPTY 0xffffffffu
+#define ATLAS_WIDTH_BRICKS 32u
+#define HALF_DIAGONAL 0.8660254
+
+layout(set = 2, binding = 0) uniform usampler3D brickCells;
+layout(set = 2, binding = 1) uniform sampler3D brickAtlas;
+layout(set = 2, binding = 2) uniform BrickMapInfo {
+	vec4 origin;
+	float cellSize;
+} brickMap;
+
+// `local` is relative to the map's origin and inside it
+float brickMapSample(vec3 local) {
+	vec3 coord = local / brickMap.cellSize;
+	ivec3 cell = min(ivec3(coord), textureSize(brickCells, 0) - 1);
+	uvec2 entry = texelFetch(brickCells, cell, 0).xy;
+	if (entry.x == BRICK_EMPTY) {
+		// No surface in the cell, so nowhere in it is nearer than the distance at its centre less half its diagonal
+		float centre = uintBitsToFloat(entry.y);
+		return sign(centre) * (abs(centre) - brickMap.cellSize * HALF_DIAGONAL);
+	}
+
+	uvec3 brick = uvec3(
+		entry.x % ATLAS_WIDTH_BRICKS,
+		entry.x / ATLAS_WIDTH_BRICKS % ATLAS_WIDTH_BRICKS,
+		entry.x / (ATLAS_WIDTH_BRICKS * ATLAS_WIDTH_BRICKS)
+	);
+	// The brick's outer texels sit on the cell's corners, so filtering never reaches into the next brick
+	vec3 f = clamp(coord - vec3(cell), 0.0, 1.0);
+	vec3 texel = vec3(brick * BRICK_SIZE) + 0.5 + f * float(BRICK_SIZE - 1u);
+	// Explicit LOD, as this runs in the march loop's non-uniform control flow where derivatives are undefined
+	return textureLod(brickAtlas, texel / vec3(textureSize(brickAtlas, 0)), 0.0).r;
+}
+
+float brickMapDistance(vec3 p) {
+	vec3 extent = vec3(textureSize(brickCells, 0)) * brickMap.cellSize;
+	vec3 local = p - brickMap.origin.xyz;
+	// All the geometry is inside the map, so nothing's nearer than its bounds
+	float outside = sdfBox(local - extent * 0.5, extent * 0.5);
+	if (outside > brickMap.cellSize) {
+		return outside;
+	}
+	float d = brickMapSample(clamp(local, vec3(0.0), extent));
+	return outside > 0.0 ? max(outside, d - outside) : d;
+}
+
+float opSmooth(float d0, float d1, float k) {
+	return clamp(0.5 + 0.5 * (d1 - d0) / k, 0.0, 1.0);
+}
+
+float opSmoothUnion(float d0, float d1, float k) {
+	float h = opSmooth(d0, d1, k);
+	return mix(d1, d0, h) - k * h * (1.0 - h);
+}
+
+DistanceResult getDistance(vec3 p) {
+	DistanceResult result;
+	result.d = MAX_DIST + 1.0;
+	float t = u.time;
+	vec3 ballPos = vec3(sin(t) * 15.0, 5.0, 12.0);
+	float ballDist = sdfSphere(p - ballPos, 5.0);
+	// The box doesn't move, so it's baked
+	float boxDist = brickMapDistance(p);
+
+	float d = opSmooth(ballDist, boxDist, 5.0);
+	result.d = opSmoothUnion(ballDist, boxDist, 5.0);
+
+	vec3 boxColor = vec3(0.3, 0.9, 0.1);
+	vec3 ballColor = vec3(1.0, 0.1, 0.2);
+	result.color = mix(boxColor, ballColor, d);
+
+	return result;
+}
+
+DistanceResult rayMarch(vec3 ro, vec3 rd, out uint steps) {
+	float d = 0.0;
+
+	for (int i = 0; i < MAX_STEPS; i++) {
+		vec3 p = ro + rd * d;
+		DistanceResult surfaceDist = getDistance(p);
+		d += surfaceDist.d;
+		steps = i + 1;
+		if (surfaceDist.d < SURFACE_DIST) {
+			return DistanceResult(d, surfaceDist.color);
+		}
+		if (d > MAX_DIST) {
+			// Sky colour
+			return DistanceResult(d, vec3(0.1, 0.03, 0.2));
+		}
+	}
+
+	// Too many steps
+	steps = MAX_STEPS;
+	return DistanceResult(d, vec3(1.0, 0.0, 1.0));
+}
+
+DistanceResult rayMarch(vec3 ro, vec3 rd) {
+	uint steps;
+	return rayMarch(ro, rd, steps);
+}
+
+vec3 calcNormal(vec3 p) {
+	float d = getDistance(p).d;
+
+	float d0 = getDistance(p - vec3(SURFACE_DIST, 0.0, 0.0)).d;
+	float d1 = getDistance(p - vec3(0.0, SURFACE_DIST, 0.0)).d;
+	float d2 = getDistance(p - vec3(0.0, 0.0, SURFACE_DIST)).d;
+
+	vec3 n = d - vec3(d0, d1, d2);
+	return normalize(n);
+}
+
+vec3 lightPosition() {
+	vec3 lightPos = vec3(10.0, -15.0, 2.0);
+	//lightPos.xz += vec2(sin(u.time * 1.7), cos(u.time * 1.3)) * 13.0;
+	return lightPos;
+}
+
+// Blue (cheap) through green and yellow to red (MAX_STEPS)
+vec3 heatmap(uint steps) {
+	float t = clamp(float(steps) / float(MAX_STEPS), 0.0, 1.0);
+	return clamp(vec3(t * 4.0 - 2.0, 2.0 - abs(t * 4.0 - 2.0), 2.0 - t * 4.0), 0.0, 1.0);
+}
+
+// Direction of the primary ray through `uv` (-1..1 across the screen)
+vec3 cameraRay(vec2 uv, vec3 f) {
+	float zoom = 1.0;
+	vec3 r = normalize(cross(vec3(0.0, 1.0, 0.0), f));
+	vec3 up = cross(f, r);
+	float aspect = u.screenSize.y / u.screenSize.x;
+	return normalize(f * zoom + (uv.x / aspect) * r + uv.y * up);
+}
+
+// Inverse of cameraRay: find where `p` landed on screen for a camera at `ro` looking along `f`
+vec2 cameraProject(vec3 p, vec3 ro, vec3 f) {
+	float zoom = 1.0;
+	vec3 r = normalize(cross(vec3(0.0, 1.0, 0.0), f));
+	vec3 up = cross(f, r);
+	float aspect = u.screenSize.y / u.screenSize.x;
+	vec3 v = p - ro;
+	float t = zoom / max(dot(v, f), 0.0001);
+	return vec2(dot(v, r) * t * aspect, dot(v, up) * t);
+}
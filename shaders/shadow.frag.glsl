@@ -0,0 +1,70 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#include "scene.glsl"
+
+layout(set = 0, binding = 0) uniform sampler2D historyMap;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 uv;
+
+// x = light visibility (0..1), y = distance along the primary ray
+layout(location = 0) out vec2 outVisibility;
+
+uint shadowSteps = 0;
+
+float shadowVisibility(vec3 p) {
+	vec3 lightPos = lightPosition();
+	vec3 lightDir = normalize(lightPos - p);
+	vec3 n = calcNormal(p);
+
+	float d = rayMarch(p + n * SURFACE_DIST * 2.0, lightDir, shadowSteps).d;
+	return d < length(lightPos - p) ? 0.0 : 1.0;
+}
+
+void writeShadowSteps() {
+	if (u.debugMode == DEBUG_OFF) {
+		return;
+	}
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	ivec2 size = textureSize(historyMap, 0);
+	uint offset = uint(u.screenSize.x) * uint(u.screenSize.y);
+	stepCounts[offset + texel.y * size.x + texel.x] = shadowSteps;
+}
+
+void main() {
+	vec3 ro = u.position;
+	vec3 rd = cameraRay(uv, u.direction);
+	float depth = rayMarch(ro, rd).d;
+	vec3 p = ro + rd * depth;
+
+	if (depth > MAX_DIST) {
+		// Sky, there's no surface to shadow
+		outVisibility = vec2(1.0, depth);
+		writeShadowSteps();
+		return;
+	}
+
+	if (u.historyWeight > 0.0) {
+		vec2 prevUv = cameraProject(p, u.prevPosition, u.prevDirection);
+		if (all(lessThan(abs(prevUv), vec2(1.0)))) {
+			vec2 history = texture(historyMap, prevUv * 0.5 + 0.5).xy;
+			float expected = length(p - u.prevPosition);
+			if (abs(history.y - expected) < expected * 0.05) {
+				// Checkerboard: only half the texels march a shadow ray each frame
+				ivec2 texel = ivec2(gl_FragCoord.xy);
+				if (((uint(texel.x + texel.y) + u.frame) & 1u) == 1u) {
+					outVisibility = vec2(history.x, depth);
+					writeShadowSteps();
+					return;
+				}
+				float visibility = mix(shadowVisibility(p), history.x, u.historyWeight);
+				outVisibility = vec2(visibility, depth);
+				writeShadowSteps();
+				return;
+			}
+		}
+	}
+
+	outVisibility = vec2(shadowVisibility(p), depth);
+	writeShadowSteps();
+}
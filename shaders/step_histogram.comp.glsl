@@ -0,0 +1,55 @@
+#version 450
+#define MAX_STEPS 256
+#define BINS (MAX_STEPS + 1)
+
+layout(local_size_x = 256) in;
+
+layout(push_constant)
+	uniform _ {
+		uint primaryCount;
+		uint shadowCount;
+	} u;
+
+layout(set = 0, binding = 0) readonly buffer StepCounts {
+	uint stepCounts[];
+};
+
+struct StepSummary {
+	uint count;
+	uint maxSteps;
+	uint p50;
+	uint p90;
+	uint p99;
+	float mean;
+};
+
+layout(set = 0, binding = 1) buffer StepStats {
+	StepSummary summaries[2];
+	uint histograms[2][BINS];
+};
+
+shared uint localHistograms[2][BINS];
+
+void main() {
+	for (uint i = gl_LocalInvocationIndex; i < BINS; i += gl_WorkGroupSize.x) {
+		localHistograms[0][i] = 0;
+		localHistograms[1][i] = 0;
+	}
+	barrier();
+
+	uint index = gl_GlobalInvocationID.x;
+	if (index < u.primaryCount + u.shadowCount) {
+		uint target = index < u.primaryCount ? 0 : 1;
+		atomicAdd(localHistograms[target][min(stepCounts[index], uint(MAX_STEPS))], 1u);
+	}
+	barrier();
+
+	for (uint i = gl_LocalInvocationIndex; i < BINS; i += gl_WorkGroupSize.x) {
+		if (localHistograms[0][i] > 0) {
+			atomicAdd(histograms[0][i], localHistograms[0][i]);
+		}
+		if (localHistograms[1][i] > 0) {
+			atomicAdd(histograms[1][i], localHistograms[1][i]);
+		}
+	}
+}
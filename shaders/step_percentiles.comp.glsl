@@ -0,0 +1,55 @@
+#version 450
+#define MAX_STEPS 256
+#define BINS (MAX_STEPS + 1)
+
+// One invocation per histogram: primary rays, then shadow rays
+layout(local_size_x = 2) in;
+
+struct StepSummary {
+	uint count;
+	uint maxSteps;
+	uint p50;
+	uint p90;
+	uint p99;
+	float mean;
+};
+
+layout(set = 0, binding = 1) buffer StepStats {
+	StepSummary summaries[2];
+	uint histograms[2][BINS];
+};
+
+uint percentile(uint target, uint count, float p) {
+	uint threshold = uint(ceil(float(count) * p));
+	uint total = 0;
+	for (uint i = 0; i < BINS; i++) {
+		total += histograms[target][i];
+		if (total >= threshold) {
+			return i;
+		}
+	}
+	return MAX_STEPS;
+}
+
+void main() {
+	uint target = gl_LocalInvocationIndex;
+
+	uint count = 0;
+	uint maxSteps = 0;
+	float sum = 0.0;
+	for (uint i = 0; i < BINS; i++) {
+		uint n = histograms[target][i];
+		count += n;
+		sum += float(n) * float(i);
+		if (n > 0) {
+			maxSteps = i;
+		}
+	}
+
+	summaries[target].count = count;
+	summaries[target].maxSteps = maxSteps;
+	summaries[target].p50 = percentile(target, count, 0.5);
+	summaries[target].p90 = percentile(target, count, 0.9);
+	summaries[target].p99 = percentile(target, count, 0.99);
+	summaries[target].mean = count > 0 ? sum / float(count) : 0.0;
+}